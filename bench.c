@@ -0,0 +1,214 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+/* every measured frame has to fit, otherwise the oldest ones would be dropped from the percentiles */
+#define RAFGL_PROFILE_HISTORY 4096
+
+#define RAFGL_IMPLEMENTATION
+#include <rafgl.h>
+
+#include <game_constants.h>
+#include <main_state.h>
+
+#ifndef RAFGL_BENCH_COMMIT
+#define RAFGL_BENCH_COMMIT "unknown"
+#endif // RAFGL_BENCH_COMMIT
+
+#define BENCH_FIXED_DELTA (1.0f / 60.0f)
+
+static int bench_width = 1280, bench_height = 720;
+static int bench_frames = 600, bench_warmup = 60;
+static const char *bench_out = "logs/bench.json";
+static stress_scene_params_t bench_stress;
+static int bench_ssao_resolution = 1;
+static int bench_temporal_ssao = 0;
+static int bench_deinterleaved_ssao = 0;
+static int bench_ao_method = MAIN_STATE_AO_KERNEL;
+static int bench_compute_ssao = 0;
+
+static float frame_ms[RAFGL_PROFILE_HISTORY];
+static int rendered = 0;
+static double last_render = 0.0;
+
+static int compare_floats(const void *a, const void *b)
+{
+    float fa = *(const float*)a, fb = *(const float*)b;
+    return (fa > fb) - (fa < fb);
+}
+
+static float percentile(const float *sorted, int count, float p)
+{
+    return sorted[rafgl_clampi((int)(p * (count - 1) + 0.5f), 0, count - 1)];
+}
+
+static void write_summary(FILE *f, float min, float avg, float p50, float p90, float p99, float max)
+{
+    fprintf(f, "{\"min\": %.4f, \"avg\": %.4f, \"p50\": %.4f, \"p90\": %.4f, \"p99\": %.4f, \"max\": %.4f}", min, avg, p50, p90, p99, max);
+}
+
+static int write_results(const char *path)
+{
+    float sorted[RAFGL_PROFILE_HISTORY];
+    double sum = 0.0;
+    int i;
+
+    FILE *f = fopen(path, "w");
+    if(f == NULL)
+    {
+        rafgl_log(RAFGL_ERROR, "Failed to open [%s] for the benchmark results!\n", path);
+        return -1;
+    }
+
+    memcpy(sorted, frame_ms, bench_frames * sizeof(float));
+    qsort(sorted, bench_frames, sizeof(float), compare_floats);
+    for(i = 0; i < bench_frames; i++)
+    {
+        sum += sorted[i];
+    }
+
+    fprintf(f, "{\n");
+    fprintf(f, "  \"commit\": \"%s\",\n", RAFGL_BENCH_COMMIT);
+    fprintf(f, "  \"renderer\": \"%s\",\n", glGetString(GL_RENDERER));
+    fprintf(f, "  \"gl_version\": \"%s\",\n", glGetString(GL_VERSION));
+    fprintf(f, "  \"width\": %d,\n  \"height\": %d,\n", bench_width, bench_height);
+    fprintf(f, "  \"stress_instances\": %d,\n  \"stress_seed\": %u,\n", bench_stress.instance_count, bench_stress.seed);
+    fprintf(f, "  \"frames\": %d,\n  \"warmup\": %d,\n  \"fixed_delta\": %.6f,\n", bench_frames, bench_warmup, BENCH_FIXED_DELTA);
+
+    fprintf(f, "  \"frame_ms\": ");
+    write_summary(f, sorted[0], sum / bench_frames, percentile(sorted, bench_frames, 0.5f), percentile(sorted, bench_frames, 0.9f),
+                  percentile(sorted, bench_frames, 0.99f), sorted[bench_frames - 1]);
+
+    rafgl_render_counters_stats_t counters = rafgl_counters_get_stats();
+    fprintf(f, ",\n  \"counters_avg\": {\"draw_calls\": %d, \"triangles\": %lld, \"state_changes\": %d, \"uniform_uploads\": %d, \"bytes_uploaded\": %lld}",
+            counters.avg.draw_calls, counters.avg.triangles, counters.avg.state_changes, counters.avg.uniform_uploads, counters.avg.bytes_uploaded);
+    fprintf(f, ",\n  \"passes\": {\n");
+
+    for(i = 0; i < rafgl_profile_zone_count(); i++)
+    {
+        rafgl_profile_stats_t st = rafgl_profile_get_stats(i);
+        fprintf(f, "    \"%s\": {\"cpu_samples\": %d, \"gpu_samples\": %d,\n      \"cpu_ms\": ", st.name, st.cpu_samples, st.gpu_samples);
+        write_summary(f, st.cpu_ms_min, st.cpu_ms_avg, st.cpu_ms_p50, st.cpu_ms_p90, st.cpu_ms_p99, st.cpu_ms_max);
+        fprintf(f, ",\n      \"gpu_ms\": ");
+        write_summary(f, st.gpu_ms_min, st.gpu_ms_avg, st.gpu_ms_p50, st.gpu_ms_p90, st.gpu_ms_p99, st.gpu_ms_max);
+        fprintf(f, "}%s\n", i + 1 < rafgl_profile_zone_count() ? "," : "");
+    }
+
+    fprintf(f, "  }\n}\n");
+    fclose(f);
+
+    rafgl_log(RAFGL_INFO, "Benchmark results written to [%s], frame p50 %.2f ms p99 %.2f ms\n", path,
+              percentile(sorted, bench_frames, 0.5f), percentile(sorted, bench_frames, 0.99f));
+    return 0;
+}
+
+void bench_init(GLFWwindow *window, void *args, int width, int height)
+{
+    main_state_init(window, args, width, height);
+    main_state_set_scripted_path(RAFGL_TRUE);
+    main_state_set_ssao_resolution(bench_ssao_resolution);
+    main_state_set_temporal_ssao(bench_temporal_ssao);
+    main_state_set_deinterleaved_ssao(bench_deinterleaved_ssao);
+    main_state_set_ao_method(bench_ao_method);
+    main_state_set_compute_ssao(bench_compute_ssao);
+}
+
+void bench_update(GLFWwindow *window, float delta_time, rafgl_game_data_t *game_data, void *args)
+{
+    main_state_update(window, delta_time, game_data, args);
+}
+
+/* a frame is measured from the start of its render to the start of the next one, swap included */
+void bench_render(GLFWwindow *window, void *args)
+{
+    double now = rafgl_time();
+
+    if(rendered == bench_warmup)
+    {
+        rafgl_profile_reset();
+        rafgl_counters_reset();
+    }
+    else if(rendered > bench_warmup)
+    {
+        frame_ms[rendered - bench_warmup - 1] = (now - last_render) * 1000.0;
+    }
+    last_render = now;
+
+    if(rendered == bench_warmup + bench_frames)
+    {
+        write_results(bench_out);
+        rafgl_window_request_close();
+        return;
+    }
+
+    main_state_render(window, args);
+    /* keeps the GPU work of a frame from being counted towards the next one */
+    glFinish();
+    rendered++;
+}
+
+void bench_cleanup(GLFWwindow *window, void *args)
+{
+    main_state_cleanup(window, args);
+}
+
+int main(int argc, char *argv[])
+{
+
+    rafgl_game_t game;
+    int i;
+
+    stress_scene_default_params(&bench_stress);
+
+    for(i = 1; i < argc; i++)
+    {
+        if(stress_scene_parse_arg(&bench_stress, argc, argv, &i))
+            continue;
+
+        if(!strcmp(argv[i], "--size") && i + 1 < argc)
+            sscanf(argv[++i], "%dx%d", &bench_width, &bench_height);
+        else if(!strcmp(argv[i], "--frames") && i + 1 < argc)
+            bench_frames = atoi(argv[++i]);
+        else if(!strcmp(argv[i], "--warmup") && i + 1 < argc)
+            bench_warmup = atoi(argv[++i]);
+        else if(!strcmp(argv[i], "--out") && i + 1 < argc)
+            bench_out = argv[++i];
+        else if(!strcmp(argv[i], "--ssao-resolution") && i + 1 < argc)
+            bench_ssao_resolution = atoi(argv[++i]);
+        else if(!strcmp(argv[i], "--temporal-ssao"))
+            bench_temporal_ssao = 1;
+        else if(!strcmp(argv[i], "--deinterleaved-ssao"))
+            bench_deinterleaved_ssao = 1;
+        else if(!strcmp(argv[i], "--compute-ssao"))
+            bench_compute_ssao = 1;
+        else if(!strcmp(argv[i], "--horizon-ao") && i + 1 < argc)
+        {
+            i++;
+            if(!strcmp(argv[i], "low")) bench_ao_method = MAIN_STATE_AO_HORIZON_LOW;
+            else if(!strcmp(argv[i], "medium")) bench_ao_method = MAIN_STATE_AO_HORIZON_MEDIUM;
+            else if(!strcmp(argv[i], "high")) bench_ao_method = MAIN_STATE_AO_HORIZON_HIGH;
+            else if(!strcmp(argv[i], "ultra")) bench_ao_method = MAIN_STATE_AO_HORIZON_ULTRA;
+        }
+    }
+
+    bench_frames = rafgl_clampi(bench_frames, 1, RAFGL_PROFILE_HISTORY);
+    bench_warmup = rafgl_max_m(bench_warmup, 0);
+
+    /* everything that could make two runs differ is pinned down */
+    rafgl_game_set_swap_interval(RAFGL_VSYNC_OFF);
+    rafgl_game_set_fixed_delta(BENCH_FIXED_DELTA);
+    rafgl_profile_enable(RAFGL_TRUE);
+
+    if(rafgl_game_init(&game, "bench", bench_width, bench_height, 0))
+    {
+        return 1;
+    }
+    main_state_set_stress_scene(&bench_stress);
+    rafgl_game_add_named_game_state(&game, bench);
+    rafgl_game_start(&game, NULL);
+
+    return 0;
+}
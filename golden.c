@@ -0,0 +1,210 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/stat.h>
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#define RAFGL_IMPLEMENTATION
+#include <rafgl.h>
+
+#include <game_constants.h>
+#include <main_state.h>
+#include <image_diff.h>
+
+#define GOLDEN_FIXED_DELTA (1.0f / 60.0f)
+/* the scripted path shows the next mesh every 2 s, so these land half a second into each of them */
+#define GOLDEN_VIEWS 6
+#define GOLDEN_FIRST_FRAME 30
+#define GOLDEN_FRAME_STEP 120
+
+typedef struct _golden_buffer_t
+{
+    const char *name;
+    int index;
+    /* AO in red with the distance next to it, only the AO is compared */
+    int ao_only;
+} golden_buffer_t;
+
+static const golden_buffer_t golden_buffers[] =
+{
+    {"final", MAIN_STATE_BUFFER_FINAL, 0},
+    {"ssao", MAIN_STATE_BUFFER_SSAO, 1},
+    {"ssao_blur", MAIN_STATE_BUFFER_SSAO_BLUR, 1}
+};
+#define GOLDEN_BUFFER_COUNT ((int)(sizeof(golden_buffers) / sizeof(golden_buffers[0])))
+
+static int golden_width = 640, golden_height = 360;
+static const char *golden_dir = "golden";
+static const char *golden_out_dir = "logs/golden";
+static int golden_update_mode = 0;
+/* an image passes when both hold, the defaults let driver rounding through but not a visibly different AO;
+   most of every view is empty background, which keeps SSIM close to 1 even for clear changes */
+static double min_psnr = 40.0, min_ssim = 0.995;
+static float heatmap_gain = 8.0f;
+
+static int frame = 0, view = 0;
+static int failures = 0, missing = 0;
+
+/* alpha is whatever the pass wrote, which the PNGs shouldn't depend on */
+static void read_buffer(rafgl_raster_t *raster, const golden_buffer_t *buffer)
+{
+    int i;
+
+    rafgl_raster_load_from_texture(raster, main_state_buffer_texture(buffer->index));
+    for(i = 0; i < raster->width * raster->height; i++)
+    {
+        if(buffer->ao_only)
+            raster->data[i].g = raster->data[i].b = raster->data[i].r;
+        raster->data[i].a = 255;
+    }
+}
+
+static void check_buffer(const golden_buffer_t *buffer)
+{
+    char golden_path[256], out_path[256];
+    rafgl_raster_t actual, expected, heatmap;
+    image_diff_t diff;
+
+    read_buffer(&actual, buffer);
+    snprintf(golden_path, sizeof(golden_path), "%s/view%d-%s.png", golden_dir, view, buffer->name);
+
+    if(golden_update_mode)
+    {
+        if(!rafgl_raster_save_to_png(&actual, golden_path))
+        {
+            rafgl_log(RAFGL_ERROR, "Failed to write [%s]!\n", golden_path);
+            failures++;
+        }
+        rafgl_raster_cleanup(&actual);
+        return;
+    }
+
+    if(rafgl_raster_load_from_image(&expected, golden_path))
+    {
+        rafgl_log(RAFGL_ERROR, "Missing golden image [%s], run with --update to record it\n", golden_path);
+        missing++;
+        rafgl_raster_cleanup(&actual);
+        return;
+    }
+
+    if(image_diff_compare(&actual, &expected, &diff))
+    {
+        rafgl_log(RAFGL_ERROR, "[%s] is %dx%d, rendered at %dx%d\n", golden_path, expected.width, expected.height, actual.width, actual.height);
+        failures++;
+    }
+    else
+    {
+        int passed = diff.psnr >= min_psnr && diff.ssim >= min_ssim;
+
+        printf("%s view%d %-9s rmse %7.3f  psnr %7.2f dB  ssim %.5f  %7d px differ\n", passed ? "ok  " : "FAIL", view, buffer->name,
+               diff.rmse, diff.psnr, diff.ssim, diff.differing_pixels);
+
+        if(!passed)
+        {
+            failures++;
+
+            snprintf(out_path, sizeof(out_path), "%s/view%d-%s-actual.png", golden_out_dir, view, buffer->name);
+            rafgl_raster_save_to_png(&actual, out_path);
+
+            image_diff_heatmap(&heatmap, &actual, &expected, heatmap_gain);
+            snprintf(out_path, sizeof(out_path), "%s/view%d-%s-diff.png", golden_out_dir, view, buffer->name);
+            rafgl_raster_save_to_png(&heatmap, out_path);
+            rafgl_raster_cleanup(&heatmap);
+        }
+    }
+
+    rafgl_raster_cleanup(&expected);
+    rafgl_raster_cleanup(&actual);
+}
+
+void golden_init(GLFWwindow *window, void *args, int width, int height)
+{
+    /* the SSAO kernel and noise come from rand() */
+    srand(1);
+    main_state_init(window, args, width, height);
+    main_state_set_scripted_path(RAFGL_TRUE);
+    /* the comparison reads the buffers back and loads the goldens from render */
+    rafgl_alloc_check_render(RAFGL_FALSE);
+}
+
+void golden_update(GLFWwindow *window, float delta_time, rafgl_game_data_t *game_data, void *args)
+{
+    main_state_update(window, delta_time, game_data, args);
+}
+
+/* only the frames that get compared are rendered, update still runs for every one so time advances the same */
+void golden_render(GLFWwindow *window, void *args)
+{
+    int i;
+
+    if(frame++ != GOLDEN_FIRST_FRAME + view * GOLDEN_FRAME_STEP)
+        return;
+
+    main_state_render(window, args);
+    glFinish();
+
+    for(i = 0; i < GOLDEN_BUFFER_COUNT; i++)
+    {
+        check_buffer(&golden_buffers[i]);
+    }
+
+    if(++view == GOLDEN_VIEWS)
+        rafgl_window_request_close();
+}
+
+void golden_cleanup(GLFWwindow *window, void *args)
+{
+    main_state_cleanup(window, args);
+}
+
+int main(int argc, char *argv[])
+{
+
+    rafgl_game_t game;
+    int i;
+
+    for(i = 1; i < argc; i++)
+    {
+        if(!strcmp(argv[i], "--update"))
+            golden_update_mode = 1;
+        else if(!strcmp(argv[i], "--size") && i + 1 < argc)
+            sscanf(argv[++i], "%dx%d", &golden_width, &golden_height);
+        else if(!strcmp(argv[i], "--dir") && i + 1 < argc)
+            golden_dir = argv[++i];
+        else if(!strcmp(argv[i], "--out-dir") && i + 1 < argc)
+            golden_out_dir = argv[++i];
+        else if(!strcmp(argv[i], "--psnr") && i + 1 < argc)
+            min_psnr = atof(argv[++i]);
+        else if(!strcmp(argv[i], "--ssim") && i + 1 < argc)
+            min_ssim = atof(argv[++i]);
+        else if(!strcmp(argv[i], "--gain") && i + 1 < argc)
+            heatmap_gain = atof(argv[++i]);
+    }
+
+    mkdir(golden_update_mode ? golden_dir : golden_out_dir, 0755);
+
+    rafgl_game_set_swap_interval(RAFGL_VSYNC_OFF);
+    rafgl_game_set_fixed_delta(GOLDEN_FIXED_DELTA);
+
+    if(rafgl_game_init(&game, "golden", golden_width, golden_height, 0))
+    {
+        return 1;
+    }
+    rafgl_game_add_named_game_state(&game, golden);
+    rafgl_game_start(&game, NULL);
+
+    if(golden_update_mode)
+    {
+        printf("%d golden image(s) written to %s/\n", GOLDEN_VIEWS * GOLDEN_BUFFER_COUNT - failures, golden_dir);
+        return failures ? 1 : 0;
+    }
+
+    printf("%d of %d image(s) outside tolerance (psnr >= %.1f dB, ssim >= %.3f), %d missing\n", failures,
+           GOLDEN_VIEWS * GOLDEN_BUFFER_COUNT, min_psnr, min_ssim, missing);
+    if(failures) printf("actual images and heatmaps are in %s/\n", golden_out_dir);
+
+    return failures || missing ? 1 : 0;
+}
@@ -0,0 +1,24 @@
+#ifndef IMAGE_DIFF_H_INCLUDED
+#define IMAGE_DIFF_H_INCLUDED
+
+#include <rafgl.h>
+
+typedef struct _image_diff_t
+{
+    /* over the r, g and b channels, alpha is ignored */
+    double rmse;
+    /* in dB, INFINITY for identical images */
+    double psnr;
+    /* mean over 8x8 windows of the luminance, stepped by 4 pixels; 1 for identical images */
+    double ssim;
+    /* pixels where any channel differs at all */
+    int differing_pixels;
+} image_diff_t;
+
+/* rasters have to be the same size, returns -1 when they aren't */
+int image_diff_compare(const rafgl_raster_t *a, const rafgl_raster_t *b, image_diff_t *diff);
+/* inits heatmap to the size of a: black where the images match, through blue and red to yellow as
+   the largest channel difference grows, gain scales the differences before they saturate */
+int image_diff_heatmap(rafgl_raster_t *heatmap, const rafgl_raster_t *a, const rafgl_raster_t *b, float gain);
+
+#endif // IMAGE_DIFF_H_INCLUDED
@@ -3,10 +3,81 @@
 
 #include <GLFW/glfw3.h>
 #include <rafgl.h>
+#include <stress_scene.h>
+
+/* the buffers the 0-4 keys show */
+#define MAIN_STATE_BUFFER_FINAL 0
+#define MAIN_STATE_BUFFER_DEPTH 1
+/* world space, octahedral encoded */
+#define MAIN_STATE_BUFFER_NORMAL 2
+#define MAIN_STATE_BUFFER_SSAO 3
+#define MAIN_STATE_BUFFER_SSAO_BLUR 4
+
+/* how AO is computed, the hemisphere kernel or horizon-based AO with 2, 3, 4 or 8 directions of 4, 6, 8 or 12 steps
+   each way */
+#define MAIN_STATE_AO_KERNEL 0
+#define MAIN_STATE_AO_HORIZON_LOW 1
+#define MAIN_STATE_AO_HORIZON_MEDIUM 2
+#define MAIN_STATE_AO_HORIZON_HIGH 3
+#define MAIN_STATE_AO_HORIZON_ULTRA 4
+
+#define MAIN_STATE_MAX_KERNEL_SAMPLES 128
+#define MAIN_STATE_MAX_NOISE_SIZE 16
+#define MAIN_STATE_MAX_BLUR_RADIUS 8
+
+typedef struct _main_state_ssao_params_t
+{
+    /* hemisphere samples per pixel */
+    int kernel_samples;
+    /* view space, the sampled hemisphere's radius and how much deeper a sample has to be to occlude */
+    float radius, bias;
+    /* side of the tiled random rotation texture */
+    int noise_size;
+    /* taps on each side of the pixel in each of the two blur passes, 0 leaves the AO as it is */
+    int blur_radius;
+    /* hemisphere samples per pixel and frame with temporal SSAO, every frame takes the next ones from the kernel */
+    int temporal_samples;
+} main_state_ssao_params_t;
 
 void main_state_init(GLFWwindow *window, void *args, int width, int height);
 void main_state_update(GLFWwindow *window, float delta_time, rafgl_game_data_t *game_data, void *args);
 void main_state_render(GLFWwindow *window, void *args);
 void main_state_cleanup(GLFWwindow *window, void *args);
 
+/* drives the camera, model and displayed mesh from elapsed time instead of input, for benchmark runs */
+void main_state_set_scripted_path(int b);
+/* SSAO reconstructs normals from the depth alone and the G-buffer skips writing g_normal, the N key toggles it */
+void main_state_set_depth_normals(int b);
+/* renders AO at 1/divisor of the window on each axis, 1, 2 or 4, and upsamples it guided by depth and normals
+   in the lighting pass, the H key cycles through them */
+void main_state_set_ssao_resolution(int divisor);
+/* spreads the kernel over several frames and blends them into a history reprojected with the G-buffer velocity,
+   history from another surface is thrown away; the velocity and history targets only exist while it is on. it saves
+   time where the SSAO pass is bound by its samples, as on a GPU; on llvmpipe per-pixel setup dominates and the extra
+   velocity and temporal passes cost more than the samples saved. the J key toggles it */
+void main_state_set_temporal_ssao(int b);
+/* renders AO one 4x4 block phase at a time from a quarter size layer of the depth, so neighbouring pixels share
+   their rotation and sample neighbouring texels, then puts the pixels back in place before the blur; the K key toggles it */
+void main_state_set_deinterleaved_ssao(int b);
+/* one of MAIN_STATE_AO_*, horizon-based AO uses the radius of the SSAO parameters and none of the kernel's,
+   and ignores deinterleaving; the O key cycles through them */
+void main_state_set_ao_method(int method);
+/* computes the kernel SSAO and both blur passes in one compute dispatch that keeps the AO in shared memory between
+   them, needs a GL 4.3 context and only applies while temporal SSAO, deinterleaving and horizon-based AO are off;
+   the SSAO buffer then shows the blurred AO; the G key toggles it and logs what keeps it from applying */
+void main_state_set_compute_ssao(int b);
+/* replaces the single mesh with a generated scene, call before init; the aspect is taken from the window */
+void main_state_set_stress_scene(const stress_scene_params_t *params);
+/* texture of one of the MAIN_STATE_BUFFER_* buffers, all of them are the size of the window
+   except the SSAO ones, which are at the resolution set with main_state_set_ssao_resolution */
+GLuint main_state_buffer_texture(int index);
+
+/* 64 samples, 0.5 radius, 0.025 bias, 4x4 noise, a blur radius of 2 and 8 samples a frame with temporal SSAO */
+void main_state_default_ssao_params(main_state_ssao_params_t *params);
+/* after init, the kernel and noise are drawn from rand() again, so call srand() first for a reproducible kernel */
+void main_state_set_ssao_params(const main_state_ssao_params_t *params);
+void main_state_get_ssao_params(main_state_ssao_params_t *params);
+/* runs only the SSAO and blur passes again on the G-buffer of the last rendered frame */
+void main_state_render_ssao(void);
+
 #endif // MAIN_STATE_H_INCLUDED
@@ -3,6 +3,8 @@
 
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
 #include <math.h>
 
 #include <glad/glad.h>
@@ -77,6 +79,10 @@
 #define RAFGL_TRUE 1
 #define RAFGL_FALSE 0
 
+#define RAFGL_VSYNC_ADAPTIVE   -1
+#define RAFGL_VSYNC_OFF         0
+#define RAFGL_VSYNC_ON          1
+
 
 typedef union _rafgl_pixel_rgb_t
 {
@@ -111,6 +117,15 @@ typedef struct _rafgl_texture_t
     GLuint tex_type;
 } rafgl_texture_t;
 
+/* a texture read by a fullscreen pass, bound to the unit of its index with the sampler at sampler_location set to that unit;
+   target is GL_TEXTURE_2D when left 0 */
+typedef struct _rafgl_pass_input_t
+{
+    GLint sampler_location;
+    GLuint tex_id;
+    GLenum target;
+} rafgl_pass_input_t;
+
 typedef struct _rafgl_list_t
 {
     void *head;
@@ -164,7 +179,7 @@ typedef struct _rafgl_vertexPUN_t
 
 typedef struct _rafgl_meshPUN_t
 {
-    GLuint vao_id;
+    GLuint vao_id, vbo_id;
     unsigned int vertex_count;
     unsigned int triangle_count;
     int loaded;
@@ -174,30 +189,103 @@ typedef struct _rafgl_meshPUN_t
 typedef struct _rafgl_framebuffer_simple_t
 {
     GLuint fbo_id, tex_id;
+    /* depth and stencil */
+    GLuint rbo_id;
 } rafgl_framebuffer_simple_t;
 
 typedef struct  _rafgl_framebuffer_multitarget_t
 {
     GLuint fbo_id;
     GLuint tex_ids[16];
+    /* one of these holds the depth, the texture when it was asked to be sampleable */
+    GLuint rbo_id, depth_tex_id;
     int num_textures;
     int width, height;
 } rafgl_framebuffer_multitarget_t;
 
+typedef struct _rafgl_frame_stats_t
+{
+    float fps;
+    float frame_ms_avg, frame_ms_min, frame_ms_max;
+    /* standard deviation of the frame time */
+    float jitter_ms;
+} rafgl_frame_stats_t;
+
+typedef struct _rafgl_profile_stats_t
+{
+    const char *name;
+    /* rolling over the last RAFGL_PROFILE_HISTORY samples */
+    float cpu_ms_min, cpu_ms_avg, cpu_ms_p50, cpu_ms_p90, cpu_ms_p99, cpu_ms_max;
+    float gpu_ms_min, gpu_ms_avg, gpu_ms_p50, gpu_ms_p90, gpu_ms_p99, gpu_ms_max;
+    int cpu_samples, gpu_samples;
+} rafgl_profile_stats_t;
+
+typedef struct _rafgl_render_counters_t
+{
+    int draw_calls;
+    /* program, vertex array, framebuffer, texture and capability changes */
+    int state_changes;
+    int uniform_uploads;
+    int clears, mipmap_generations;
+    long long triangles;
+    /* vertex and pixel data handed to the driver, allocations without data don't count */
+    long long bytes_uploaded;
+} rafgl_render_counters_t;
+
+#define RAFGL_GPU_TEXTURE           0
+#define RAFGL_GPU_BUFFER            1
+#define RAFGL_GPU_RENDERBUFFER      2
+#define RAFGL_GPU_FRAMEBUFFER       3
+#define RAFGL_GPU_CATEGORIES        4
+
+typedef struct _rafgl_gpu_memory_t
+{
+    int objects[RAFGL_GPU_CATEGORIES];
+    long long bytes[RAFGL_GPU_CATEGORIES];
+    long long total_bytes, peak_bytes;
+} rafgl_gpu_memory_t;
+
+typedef struct _rafgl_alloc_stats_t
+{
+    /* since the start */
+    long long calls, bytes;
+    /* allocated right now, and the most that ever was */
+    long long live_blocks, live_bytes, peak_bytes;
+    /* during the last finished frame */
+    long long frame_calls, frame_bytes;
+} rafgl_alloc_stats_t;
+
+typedef struct _rafgl_render_counters_stats_t
+{
+    /* the average is rounded to whole counts */
+    rafgl_render_counters_t min, avg, max;
+    int frames;
+} rafgl_render_counters_stats_t;
+
+typedef struct _rafgl_snapshot_t
+{
+    void *data[2];
+    int size;
+    int front;
+} rafgl_snapshot_t;
+
 
 
-/* initializes the GLFW library, GLEW and the window. If full-screen mode is selected, width and hight are unused and the monitor resolution is used instead */
+/* initializes the GLFW library, GLEW and the window. If full-screen mode is selected, width and hight are unused and the monitor resolution is used instead.
+   Built with RAFGL_HEADLESS it creates an offscreen EGL pbuffer of the given size instead (surfaceless platform when available, so it runs without a display or GPU) */
 int rafgl_game_init(rafgl_game_t *game, const char *title, int window_width, int window_height, int fullscreen);
 /* creates a new game state based on the appropriate function pointers */
 void rafgl_game_add_game_state(rafgl_game_t *game, void (*init)(GLFWwindow *window, void *args), void (*update)(GLFWwindow *window, float delta_time, rafgl_game_data_t *game_data, void *args), void (*render)(GLFWwindow *window, void *args), void (*cleanup)(GLFWwindow *window, void *args));
 
 void rafgl_window_set_title(const char *name);
+/* stops the game loop once the current frame is done, safe to call from update */
+void rafgl_window_request_close(void);
 
 /* allocates and NULLs the needed memory for the raster */
 int rafgl_raster_init(rafgl_raster_t *raster, int width, int height);
 /* copies the raster (resizes destination raster to fit the source raster) */
 int rafgl_raster_copy(rafgl_raster_t *raster_to, rafgl_raster_t *raster_from);
-/* reads an image from the disk and loads it into the raster (raster should NOT BE "inited" beforehand */
+/* reads an image from the disk and loads it into the raster (raster should NOT BE "inited" beforehand), returns -1 when it can't be read */
 int rafgl_raster_load_from_image(rafgl_raster_t *raster, const char *image_path);
 /* */
 int rafgl_raster_save_to_png(rafgl_raster_t *raster, const char *image_path);
@@ -207,7 +295,61 @@ int rafgl_raster_cleanup(rafgl_raster_t *raster);
 void rafgl_spritesheet_init(rafgl_spritesheet_t *spritesheet, const char *sheet_path, int sheet_width, int sheet_height);
 void rafgl_raster_draw_spritesheet(rafgl_raster_t *raster, rafgl_spritesheet_t *spritesheet, int sheet_x, int sheet_y, int x, int y);
 
+/* after rafgl_game_init only queues the message, a writer thread formats it and writes it out */
 void rafgl_log(int level, const char *format, ...);
+/* drops messages less severe than the given level (RAFGL_ERROR, RAFGL_WARNING or RAFGL_INFO, the default) */
+void rafgl_log_set_level(int level);
+/* messages of a level past this many per second are counted instead of written, 0 is unlimited (warnings and info default to 200) */
+void rafgl_log_set_rate_limit(int level, int per_second);
+/* RAFGL_FALSE before rafgl_game_init keeps logging on the caller's thread */
+void rafgl_log_set_async(int b);
+/* returns once everything logged so far is written and flushed */
+void rafgl_log_flush(void);
+
+/* what rafgl's own heap allocations are counted under */
+#define RAFGL_ALLOC_OTHER           0
+#define RAFGL_ALLOC_OBJ             1
+#define RAFGL_ALLOC_MESH            2
+#define RAFGL_ALLOC_RASTER          3
+#define RAFGL_ALLOC_LIST            4
+/* stb_image decoding and encoding, for textures and rasters loaded from files */
+#define RAFGL_ALLOC_IMAGE           5
+#define RAFGL_ALLOC_FILE            6
+#define RAFGL_ALLOC_TAGS            7
+
+/* built with RAFGL_TRACK_ALLOCATIONS (in every translation unit) these go through the tracker, which keeps a small
+   header in front of every block, otherwise they are plain malloc and friends. either way a block has to be freed
+   with rafgl_free, that includes what rafgl_file_read_content, rafgl_meshPUN_parse_OBJ and stb_image return */
+#ifdef RAFGL_TRACK_ALLOCATIONS
+#define rafgl_malloc(tag, size) rafgl_alloc_malloc(tag, size)
+#define rafgl_calloc(tag, count, size) rafgl_alloc_calloc(tag, count, size)
+#define rafgl_realloc(tag, ptr, size) rafgl_alloc_realloc(tag, ptr, size)
+#define rafgl_free(ptr) rafgl_alloc_free(ptr)
+#else
+#define rafgl_malloc(tag, size) malloc(size)
+#define rafgl_calloc(tag, count, size) calloc(count, size)
+#define rafgl_realloc(tag, ptr, size) realloc(ptr, size)
+#define rafgl_free(ptr) free(ptr)
+#endif // RAFGL_TRACK_ALLOCATIONS
+
+/* frames after the first one of a state whose render allocates fail an assert, on by default when tracking */
+#ifndef RAFGL_ALLOC_CHECK_RENDER
+#define RAFGL_ALLOC_CHECK_RENDER    1
+#endif // RAFGL_ALLOC_CHECK_RENDER
+
+void* rafgl_alloc_malloc(int tag, size_t size);
+void* rafgl_alloc_calloc(int tag, size_t count, size_t size);
+void* rafgl_alloc_realloc(int tag, void *ptr, size_t size);
+void rafgl_alloc_free(void *ptr);
+
+/* RAFGL_ALLOC_TAGS for the totals, all zero without RAFGL_TRACK_ALLOCATIONS */
+rafgl_alloc_stats_t rafgl_alloc_get_stats(int tag);
+/* closes the per frame counts, the game loop calls this after every swap */
+void rafgl_alloc_frame_end(void);
+/* logs the totals and every tag that was ever used */
+void rafgl_alloc_log(void);
+/* turns the check that render doesn't allocate on or off, for states that read back or load in render on purpose */
+void rafgl_alloc_check_render(int b);
 
 
 /* helpers function declarations start */
@@ -218,6 +360,8 @@ void rafgl_texture_init(rafgl_texture_t *tex);
 int rafgl_texture_load_basic(const char *texture_path, rafgl_texture_t *res);
 /* loads a texture from a raster in memory */
 void rafgl_texture_load_from_raster(rafgl_texture_t *texture, rafgl_raster_t *raster);
+/* reads a 2D texture back into a raster (raster should NOT BE "inited" beforehand), flipped so the first row is the top one like in image files */
+void rafgl_raster_load_from_texture(rafgl_raster_t *raster, GLuint tex_id);
 /* shows the texture applied to a (-1, -1) (1, 1) NDC space quad */
 void rafgl_texture_show(const rafgl_texture_t *texture, int flip);
 /* free */
@@ -226,7 +370,7 @@ void rafgl_texture_cleanup(rafgl_texture_t *texture);
 void rafgl_texture_load_cubemap_named(rafgl_texture_t *tex, const char *cubemap_name, const char *file_ext);
 void rafgl_texture_load_cubemap(rafgl_texture_t *tex, const char *cubemap_paths[]);
 
-/* allocates memory and reads the file content into it (requires free on the returned pointer later) */
+/* allocates memory and reads the file content into it (release it with rafgl_free later) */
 char* rafgl_file_read_content(const char *filepath);
 /* checks the file size */
 int rafgl_file_size(const char *filepath);
@@ -237,6 +381,30 @@ GLuint rafgl_program_create(const char *vertex_source_filepath, const char *frag
 GLuint rafgl_program_create_from_source(const char *vertex_source, const char *fragment_source);
 /* creates a shader program from vertex and fragment files with standardized names and locations */
 GLuint rafgl_program_create_from_name(const char *program_name);
+/* creates a program for rafgl_pass_fullscreen from just the fragment file, the vertex shader is built in and passes pass_uv */
+GLuint rafgl_program_create_fullscreen_from_name(const char *program_name);
+
+/* draws one attribute-less triangle over the whole target (0 for the default framebuffer) with program, so the cost only
+   depends on the resolution; uniforms other than the input samplers are set beforehand, a program keeps them between uses */
+void rafgl_pass_fullscreen(GLuint program, GLuint target_fbo, const rafgl_pass_input_t *inputs, int input_count);
+
+/* the window asks for a 4.3 context and settles for 3.3, compute shaders only exist in the former;
+   glad is generated for 3.3, so the few 4.3 names used here are defined by hand */
+#ifndef GL_COMPUTE_SHADER
+#define GL_COMPUTE_SHADER                   0x91B9
+#define GL_TEXTURE_FETCH_BARRIER_BIT        0x00000008
+#define GL_SHADER_IMAGE_ACCESS_BARRIER_BIT  0x00000020
+#define GL_TEXTURE_UPDATE_BARRIER_BIT       0x00000100
+#define GL_FRAMEBUFFER_BARRIER_BIT          0x00000400
+#endif // GL_COMPUTE_SHADER
+
+/* whether the context is 4.3 or later and the compute entry points were found */
+int rafgl_compute_supported(void);
+/* creates a compute program from comp.glsl in the standardized location, 0 without compute support */
+GLuint rafgl_program_create_compute_from_name(const char *program_name);
+/* binds the inputs like rafgl_pass_fullscreen and dispatches groups_x by groups_y workgroups of program; images
+   it writes are bound beforehand with rafgl_gl_bind_image_texture, and a barrier has to come before they are read */
+void rafgl_pass_compute(GLuint program, const rafgl_pass_input_t *inputs, int input_count, int groups_x, int groups_y);
 
 /* generic linked list */
 int rafgl_list_init(rafgl_list_t *list, int element_size);
@@ -297,17 +465,190 @@ void rafgl_raster_draw_rectangle(rafgl_raster_t *raster, int x0, int y0, int w,
 void rafgl_raster_bilinear_upsample(rafgl_raster_t *to, rafgl_raster_t *from);
 
 int rafgl_raster_draw_string(rafgl_raster_t *raster, const char *s, int x, int y, uint32_t colour, int font_size);
+/* loads the font sheets rafgl_raster_draw_string uses, rafgl_game_init does this already */
+void rafgl_font_init(void);
 
 void rafgl_log_fps(int b);
 
+/* RAFGL_VSYNC_ON, RAFGL_VSYNC_OFF or RAFGL_VSYNC_ADAPTIVE (falls back to RAFGL_VSYNC_ON when the driver lacks swap_control_tear) */
+void rafgl_game_set_swap_interval(int interval);
+/* caps the frame rate by sleeping and then spinning until the next frame is due, 0 turns the limiter off */
+void rafgl_game_set_frame_limit(float fps);
+/* exponentially smooths the delta_time passed to update, 0 passes the measured time through and values closer to 1 average over more frames */
+void rafgl_game_set_delta_smoothing(float smoothing);
+/* passes a constant delta_time to update regardless of how long frames take, so runs can be reproduced. 0 uses the measured time */
+void rafgl_game_set_fixed_delta(float seconds);
+/* frame time statistics over the last two second window */
+rafgl_frame_stats_t rafgl_game_get_frame_stats(void);
+
+/* with render on demand, update still runs at least this often so time based logic keeps ticking */
+#define RAFGL_IDLE_TIMEOUT 0.1
+
+/* only renders and swaps frames for which a redraw was requested, otherwise waits for events (up to the idle timeout) */
+void rafgl_game_set_render_on_demand(int b);
+/* marks the frame produced by the current update as changed, only meaningful with render on demand */
+void rafgl_game_request_redraw(void);
+
+/* runs update for the next frame on a simulation thread while the GL thread renders the current one */
+void rafgl_game_set_pipelined(int b);
+/* registers the snapshot the game loop publishes once update for a frame is done */
+void rafgl_game_set_snapshot(rafgl_snapshot_t *snapshot);
+
+/* allocates and NULLs both copies of a double-buffered frame snapshot */
+int rafgl_snapshot_init(rafgl_snapshot_t *snapshot, int size);
+/* copy written by update */
+void* rafgl_snapshot_back(rafgl_snapshot_t *snapshot);
+/* copy read by render */
+void* rafgl_snapshot_front(rafgl_snapshot_t *snapshot);
+/* makes the back copy the front one and carries it over as the start of the next back copy */
+void rafgl_snapshot_swap(rafgl_snapshot_t *snapshot);
+/* free */
+void rafgl_snapshot_cleanup(rafgl_snapshot_t *snapshot);
+
+/* timestamps input events, camera uniform upload and swap completion, input-to-present latency percentiles are logged with the FPS */
+void rafgl_latency_tracking(int b);
+/* samples the cursor on the GL thread right before rendering, a frame that latches input counts it as its input time */
+void rafgl_input_latch_cursor(double *x, double *y);
+/* marks the moment the camera uniforms of the frame being rendered were uploaded */
+void rafgl_latency_mark_upload(void);
+
+/* input callbacks only queue events, the game loop drains them once per frame before update */
+#define RAFGL_INPUT_EVENTS 256
+
+/* writes every frame's delta_time, cursor, mouse buttons and key events to a compact binary file */
+int rafgl_input_record(const char *path);
+/* feeds a recorded session back frame by frame in place of live input and delta_time, the game closes once it runs out */
+int rafgl_input_replay(const char *path);
+
+#define RAFGL_PROFILE_MAX_ZONES     32
+#ifndef RAFGL_PROFILE_HISTORY
+#define RAFGL_PROFILE_HISTORY       256
+#endif // RAFGL_PROFILE_HISTORY
+/* frames a timer query gets to deliver its result before its slot is skipped instead of waited on */
+#define RAFGL_PROFILE_QUERY_FRAMES  4
+#define RAFGL_PROFILE_TRACE_EVENTS  8192
+
+/* profiles the block that follows on both the CPU and the GPU, don't return or break out of it */
+#define RAFGL_PROFILE_SCOPE(name) for(int __rafgl_zone = rafgl_profile_begin_named(name), __rafgl_once = 1; __rafgl_once; __rafgl_once = 0, rafgl_profile_end(__rafgl_zone))
+
+/* the profiler is not thread safe, zones may only be used on the GL thread */
+void rafgl_profile_enable(int b);
+int rafgl_profile_is_enabled(void);
+/* registers a zone (or finds an existing one by name) and returns its index */
+int rafgl_profile_zone(const char *name);
+void rafgl_profile_begin(int zone);
+int rafgl_profile_begin_named(const char *name);
+/* GPU time is measured with GL_TIME_ELAPSED queries, which can't nest, so nested zones are only timed on the CPU */
+void rafgl_profile_end(int zone);
+/* collects finished timer queries without ever waiting on them, the game loop calls this after every swap */
+void rafgl_profile_frame_end(void);
+int rafgl_profile_zone_count(void);
+rafgl_profile_stats_t rafgl_profile_get_stats(int zone);
+/* drops all collected samples and trace events, zones stay registered */
+void rafgl_profile_reset(void);
+void rafgl_profile_log(void);
+/* chrome://tracing / Perfetto trace-event JSON, GPU events are laid out in submission order with their measured durations */
+int rafgl_profile_export_trace(const char *path);
+int rafgl_profile_export_csv(const char *path);
+/* exports <basename>.json and <basename>.csv at the end of the next rendered frame; call it from update, in pipelined
+   mode the request only reaches the render thread when the frame is published */
+void rafgl_profile_request_export(const char *basename);
+
+#ifndef RAFGL_COUNTERS_HISTORY
+#define RAFGL_COUNTERS_HISTORY      240
+#endif // RAFGL_COUNTERS_HISTORY
+
+/* GL calls that also count what they do, only work done through these shows up in the render counters.
+   the counters are not thread safe, like the profiler they belong to the GL thread */
+void rafgl_gl_draw_arrays(GLenum mode, GLint first, GLsizei count);
+void rafgl_gl_clear(GLbitfield mask);
+void rafgl_gl_use_program(GLuint program);
+void rafgl_gl_bind_vertex_array(GLuint vao);
+void rafgl_gl_bind_framebuffer(GLenum target, GLuint framebuffer);
+void rafgl_gl_active_texture(GLenum unit);
+void rafgl_gl_bind_texture(GLenum target, GLuint texture);
+void rafgl_gl_enable(GLenum capability);
+void rafgl_gl_disable(GLenum capability);
+void rafgl_gl_depth_mask(GLboolean flag);
+void rafgl_gl_generate_mipmap(GLenum target);
+void rafgl_gl_uniform1i(GLint location, GLint v);
+void rafgl_gl_uniform1f(GLint location, GLfloat v);
+void rafgl_gl_uniform3f(GLint location, GLfloat x, GLfloat y, GLfloat z);
+void rafgl_gl_uniform3fv(GLint location, GLsizei count, const GLfloat *v);
+void rafgl_gl_uniform_matrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat *m);
+void rafgl_gl_buffer_data(GLenum target, GLsizeiptr size, const void *data, GLenum usage);
+void rafgl_gl_tex_image_2d(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLenum format, GLenum type, const void *data);
+/* GL_TEXTURE_2D_ARRAY storage, depth is the number of layers */
+void rafgl_gl_tex_image_3d(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, const void *data);
+/* only with rafgl_compute_supported() */
+void rafgl_gl_bind_image_texture(GLuint unit, GLuint texture, GLint level, GLboolean layered, GLint layer, GLenum access, GLenum format);
+void rafgl_gl_memory_barrier(GLbitfield barriers);
+
+/* counters of the last rendered frame, the game loop closes a frame after every swap */
+rafgl_render_counters_t rafgl_counters_get_frame(void);
+/* everything counted since the program started */
+rafgl_render_counters_t rafgl_counters_get_total(void);
+/* min, average and max over the last RAFGL_COUNTERS_HISTORY rendered frames */
+rafgl_render_counters_stats_t rafgl_counters_get_stats(void);
+/* ends the frame being counted, the game loop calls this after every swap */
+void rafgl_counters_frame_end(void);
+/* forgets the rolling history, so loading and warmup frames don't skew it; the totals are kept */
+void rafgl_counters_reset(void);
+/* a few lines of text with the last frame and the rolling averages, returns how many lines were drawn */
+int rafgl_counters_draw(rafgl_raster_t *raster, int x, int y, uint32_t colour, int font_size);
+/* one row per frame in the history, oldest first */
+int rafgl_counters_export_csv(const char *path);
+/* exports at the end of the next rendered frame; call it from update, in pipelined mode the request only reaches the
+   render thread when the frame is published */
+void rafgl_counters_request_export(const char *path);
+
+/* GL objects made through rafgl_gpu_gen_* are tracked until the matching rafgl_gpu_delete_*, the tag (and scope) are
+   kept by pointer, so they have to outlive the object. sizes are estimates from the storage calls made through the
+   rafgl_gl_* wrappers: level 0 times the cube faces or array layers, a third more once mipmaps are generated. GL thread only */
+GLuint rafgl_gpu_gen_texture(const char *tag);
+GLuint rafgl_gpu_gen_buffer(const char *tag);
+GLuint rafgl_gpu_gen_renderbuffer(const char *tag);
+GLuint rafgl_gpu_gen_framebuffer(const char *tag);
+void rafgl_gpu_delete_texture(GLuint id);
+void rafgl_gpu_delete_buffer(GLuint id);
+void rafgl_gpu_delete_renderbuffer(GLuint id);
+void rafgl_gpu_delete_framebuffer(GLuint id);
+void rafgl_gl_renderbuffer_storage(GLenum target, GLenum internalformat, GLsizei width, GLsizei height);
+/* objects made until the next call are reported under this scope as well as their tag, NULL ends it */
+void rafgl_gpu_set_scope(const char *scope);
+/* live objects and estimated bytes by RAFGL_GPU_* category */
+rafgl_gpu_memory_t rafgl_gpu_memory_get(void);
+/* totals by category and by scope and tag, the game loop logs this once a state is initialized */
+void rafgl_gpu_memory_log(void);
+/* logs every object made since the current game state was initialized that is still alive and returns how many,
+   the game loop calls this after every state cleanup */
+int rafgl_gpu_memory_report_leaks(void);
+
+/* seconds on a monotonic clock */
+double rafgl_time(void);
+
+/* cursor requests are applied on the main thread after update, so they are safe to make from update */
+void rafgl_cursor_set_pos(double x, double y);
+void rafgl_cursor_set_mode(int mode);
+
 void rafgl_meshPUN_init(rafgl_meshPUN_t *m);
 void rafgl_meshPUN_load_from_OBJ(rafgl_meshPUN_t *m, const char *obj_path);
 void rafgl_meshPUN_load_from_OBJ_offset(rafgl_meshPUN_t *m, const char *obj_path, vec3_t position_offset);
+/* the CPU side of the OBJ loader: fills a newly allocated vertex buffer (free it with rafgl_free) and the mesh name, returns the vertex count or -1 */
+int rafgl_meshPUN_parse_OBJ(rafgl_meshPUN_t *m, const char *obj_path, vec3_t position_offset, rafgl_vertexPUN_t **vertex_buffer_out);
 void rafgl_meshPUN_load_cube(rafgl_meshPUN_t *m, float coord);
+/* free, deletes the vertex array and buffer and leaves the mesh ready to be loaded again */
+void rafgl_meshPUN_cleanup(rafgl_meshPUN_t *m);
 void rafgl_meshPUN_load_terrain_from_heightmap(rafgl_meshPUN_t *m, float w, float h, const char *img_path, float height);
 
 rafgl_framebuffer_simple_t rafgl_framebuffer_simple_create(int w, int h, GLuint internalformat);
 rafgl_framebuffer_multitarget_t rafgl_framebuffer_multitarget_create(int w, int h, int num_attachments);
+/* internal_formats has one format per attachment (NULL for RGBA16F everywhere), with depth_texture set the depth is a
+   DEPTH_COMPONENT24 texture that can be sampled afterwards instead of a renderbuffer */
+rafgl_framebuffer_multitarget_t rafgl_framebuffer_multitarget_create_formats(int w, int h, int num_attachments, const GLenum *internal_formats, int depth_texture);
+/* free, deletes the framebuffer along with its textures and depth renderbuffer or texture */
+void rafgl_framebuffer_simple_cleanup(rafgl_framebuffer_simple_t *fb);
+void rafgl_framebuffer_multitarget_cleanup(rafgl_framebuffer_multitarget_t *fb);
 
 void rafgl_meshPUN_load_plane(rafgl_meshPUN_t *m, float w, float h, int wtiles, int htiles);
 
@@ -322,21 +663,250 @@ extern rafgl_pixel_rgb_t RAFGL_COLOUR_KEY;
 
 #ifdef RAFGL_IMPLEMENTATION
 
+/* stb's buffers are counted with the rest, the decoded pixels become raster data that rafgl_raster_cleanup frees */
+#define STBI_MALLOC(size) rafgl_malloc(RAFGL_ALLOC_IMAGE, size)
+#define STBI_REALLOC(ptr, size) rafgl_realloc(RAFGL_ALLOC_IMAGE, ptr, size)
+#define STBI_FREE(ptr) rafgl_free(ptr)
+#define STBIW_MALLOC(size) rafgl_malloc(RAFGL_ALLOC_IMAGE, size)
+#define STBIW_REALLOC(ptr, size) rafgl_realloc(RAFGL_ALLOC_IMAGE, ptr, size)
+#define STBIW_FREE(ptr) rafgl_free(ptr)
+
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include <stb_image_write.h>
 
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#ifdef RAFGL_HEADLESS
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif // RAFGL_HEADLESS
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif // _WIN32
+
 /* rafgl core implementation */
 
 rafgl_pixel_rgb_t RAFGL_COLOUR_KEY;
 
+/* in front of every tracked block, the union keeps the block itself aligned like malloc's own */
+typedef union _rafgl_alloc_header_t
+{
+    struct
+    {
+        size_t size;
+        int tag;
+        unsigned int magic;
+    } info;
+    max_align_t align;
+} rafgl_alloc_header_t;
+
+#define __RAFGL_ALLOC_MAGIC 0x7261666cu
+
+typedef struct _rafgl_alloc_counters_t
+{
+    atomic_llong calls, bytes, live_blocks, live_bytes, peak_bytes, frame_calls, frame_bytes;
+    atomic_llong last_frame_calls, last_frame_bytes;
+} rafgl_alloc_counters_t;
+
+static const char *__alloc_tag_names[RAFGL_ALLOC_TAGS] = {"other", "obj loader", "meshes", "raster", "list", "image", "file"};
+/* one per tag and the totals after them */
+static rafgl_alloc_counters_t __alloc_counters[RAFGL_ALLOC_TAGS + 1];
+/* what the calling thread allocated, so render can be checked while update allocates on the simulation thread */
+static _Thread_local long long __alloc_thread_calls = 0, __alloc_thread_bytes = 0;
+static int __alloc_check_render = RAFGL_ALLOC_CHECK_RENDER;
+
+static void __rafgl_alloc_count(int tag, long long size)
+{
+    rafgl_alloc_counters_t *c;
+    long long live, peak;
+    int i;
+
+    __alloc_thread_calls++;
+    __alloc_thread_bytes += size;
+
+    for(i = 0; i < 2; i++)
+    {
+        c = &__alloc_counters[i ? RAFGL_ALLOC_TAGS : tag];
+        atomic_fetch_add_explicit(&c->calls, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&c->bytes, size, memory_order_relaxed);
+        atomic_fetch_add_explicit(&c->frame_calls, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&c->frame_bytes, size, memory_order_relaxed);
+        atomic_fetch_add_explicit(&c->live_blocks, 1, memory_order_relaxed);
+        live = atomic_fetch_add_explicit(&c->live_bytes, size, memory_order_relaxed) + size;
+
+        peak = atomic_load_explicit(&c->peak_bytes, memory_order_relaxed);
+        while(live > peak && !atomic_compare_exchange_weak_explicit(&c->peak_bytes, &peak, live, memory_order_relaxed, memory_order_relaxed));
+    }
+}
+
+static void __rafgl_alloc_uncount(int tag, long long size)
+{
+    int i;
+    for(i = 0; i < 2; i++)
+    {
+        rafgl_alloc_counters_t *c = &__alloc_counters[i ? RAFGL_ALLOC_TAGS : tag];
+        atomic_fetch_sub_explicit(&c->live_blocks, 1, memory_order_relaxed);
+        atomic_fetch_sub_explicit(&c->live_bytes, size, memory_order_relaxed);
+    }
+}
+
+void* rafgl_alloc_malloc(int tag, size_t size)
+{
+    rafgl_alloc_header_t *h = malloc(sizeof(rafgl_alloc_header_t) + size);
+
+    if(h == NULL) return NULL;
+    if(tag < 0 || tag >= RAFGL_ALLOC_TAGS) tag = RAFGL_ALLOC_OTHER;
+
+    h->info.size = size;
+    h->info.tag = tag;
+    h->info.magic = __RAFGL_ALLOC_MAGIC;
+    __rafgl_alloc_count(tag, size);
+
+    return h + 1;
+}
+
+void* rafgl_alloc_calloc(int tag, size_t count, size_t size)
+{
+    void *p;
+
+    if(size && count > ((size_t)-1 - sizeof(rafgl_alloc_header_t)) / size) return NULL;
+
+    p = rafgl_alloc_malloc(tag, count * size);
+    if(p != NULL) memset(p, 0, count * size);
+    return p;
+}
+
+void* rafgl_alloc_realloc(int tag, void *ptr, size_t size)
+{
+    rafgl_alloc_header_t *h, *moved;
+
+    if(ptr == NULL) return rafgl_alloc_malloc(tag, size);
+
+    h = (rafgl_alloc_header_t*)ptr - 1;
+    assert(h->info.magic == __RAFGL_ALLOC_MAGIC);
+
+    moved = realloc(h, sizeof(rafgl_alloc_header_t) + size);
+    if(moved == NULL) return NULL;
+
+    /* the block keeps the tag it was first allocated under */
+    __rafgl_alloc_uncount(moved->info.tag, moved->info.size);
+    __rafgl_alloc_count(moved->info.tag, size);
+    moved->info.size = size;
+
+    return moved + 1;
+}
+
+void rafgl_alloc_free(void *ptr)
+{
+    rafgl_alloc_header_t *h;
+
+    if(ptr == NULL) return;
+
+    h = (rafgl_alloc_header_t*)ptr - 1;
+    /* a block from plain malloc, which a build that only tracks in some translation units would hand over */
+    assert(h->info.magic == __RAFGL_ALLOC_MAGIC);
+
+    __rafgl_alloc_uncount(h->info.tag, h->info.size);
+    h->info.magic = 0;
+    free(h);
+}
+
+rafgl_alloc_stats_t rafgl_alloc_get_stats(int tag)
+{
+    rafgl_alloc_stats_t st;
+    rafgl_alloc_counters_t *c = &__alloc_counters[tag >= 0 && tag < RAFGL_ALLOC_TAGS ? tag : RAFGL_ALLOC_TAGS];
+
+    st.calls = atomic_load(&c->calls);
+    st.bytes = atomic_load(&c->bytes);
+    st.live_blocks = atomic_load(&c->live_blocks);
+    st.live_bytes = atomic_load(&c->live_bytes);
+    st.peak_bytes = atomic_load(&c->peak_bytes);
+    st.frame_calls = atomic_load(&c->last_frame_calls);
+    st.frame_bytes = atomic_load(&c->last_frame_bytes);
+    return st;
+}
+
+void rafgl_alloc_frame_end(void)
+{
+    int i;
+    for(i = 0; i <= RAFGL_ALLOC_TAGS; i++)
+    {
+        rafgl_alloc_counters_t *c = &__alloc_counters[i];
+        atomic_store(&c->last_frame_calls, atomic_exchange(&c->frame_calls, 0));
+        atomic_store(&c->last_frame_bytes, atomic_exchange(&c->frame_bytes, 0));
+    }
+}
+
+void rafgl_alloc_log(void)
+{
+    rafgl_alloc_stats_t st = rafgl_alloc_get_stats(RAFGL_ALLOC_TAGS);
+    int i;
+
+    rafgl_log(RAFGL_INFO, "[heap] %lld allocations, %lld bytes; %lld live blocks, %lld live bytes, peak %lld bytes\n",
+              st.calls, st.bytes, st.live_blocks, st.live_bytes, st.peak_bytes);
+
+    for(i = 0; i < RAFGL_ALLOC_TAGS; i++)
+    {
+        st = rafgl_alloc_get_stats(i);
+        if(st.calls == 0) continue;
+        rafgl_log(RAFGL_INFO, "    %-10s %8lld allocations %12lld bytes, %6lld live blocks %10lld live bytes, peak %10lld\n",
+                  __alloc_tag_names[i], st.calls, st.bytes, st.live_blocks, st.live_bytes, st.peak_bytes);
+    }
+}
+
+void rafgl_alloc_check_render(int b)
+{
+    __alloc_check_render = b;
+}
+
+/* calls and bytes are what this thread had allocated before render, the first frame of a state may set things up lazily */
+static void __rafgl_alloc_check_render_frame(long long calls, long long bytes, int state_frame)
+{
+    if(!__alloc_check_render || state_frame == 0 || __alloc_thread_calls == calls) return;
+
+    rafgl_log(RAFGL_ERROR, "Render allocated %lld times (%lld bytes) in frame %d of the game state\n", __alloc_thread_calls - calls,
+              __alloc_thread_bytes - bytes, state_frame);
+    rafgl_log_flush();
+    assert(!"render allocated on the heap");
+}
+
 static GLFWwindow *__window;
+#ifdef RAFGL_HEADLESS
+static EGLDisplay __egl_display = EGL_NO_DISPLAY;
+static EGLSurface __egl_surface = EGL_NO_SURFACE;
+static EGLContext __egl_context = EGL_NO_CONTEXT;
+/* there is no cursor to move, it simply stays where it was last put */
+static double __headless_cursor_x = 0.0, __headless_cursor_y = 0.0;
+#endif // RAFGL_HEADLESS
+static volatile int __close_requested = 0;
 static int __done = 0;
 static int __window_width = 0, __window_height = 0;
 
-static uint8_t __keys_down[400];
-static uint8_t __keys_pressed[400];
+#define RAFGL_KEY_SLOTS 400
+
+static uint8_t __keys_down[RAFGL_KEY_SLOTS];
+static uint8_t __keys_pressed[RAFGL_KEY_SLOTS];
+
+#define RAFGL_INPUT_KEY     0
+#define RAFGL_INPUT_CURSOR  1
+#define RAFGL_INPUT_BUTTON  2
+
+typedef struct _rafgl_input_event_t
+{
+    double time;
+    int type, key, action;
+} rafgl_input_event_t;
+
+static rafgl_input_event_t __input_events[RAFGL_INPUT_EVENTS];
+static int __input_event_head = 0, __input_event_count = 0;
+
+static int __redraw_forced = 1;
 
 static rafgl_spritesheet_t __mono_char_sheet[RAFGL_FONT_COUNT];
 static int __countx = 16, __county = 8;
@@ -378,6 +948,49 @@ void main()\n\
 static unsigned int __raster_program = 0;
 static unsigned int __raster_vao = 0;
 
+/* the corners come from gl_VertexID, (0, 0), (2, 0) and (0, 2) in uv, so the one triangle covers the screen and is clipped to it */
+static const char *__fullscreen_vertex_shader_source = "\
+#version 330 core\n\
+\n\
+out vec2 pass_uv;\n\
+\n\
+void main()\n\
+{\n\
+    pass_uv = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);\n\
+    gl_Position = vec4(pass_uv * 2.0 - 1.0, 0.0, 1.0);\n\
+}\
+";
+
+/* core profile draws need a vertex array bound even when it has no attributes */
+static unsigned int __fullscreen_vao = 0;
+
+/* the GL 4.3 compute entry points, NULL on a 3.3 context */
+typedef void (APIENTRYP __rafgl_dispatch_compute_proc)(GLuint groups_x, GLuint groups_y, GLuint groups_z);
+typedef void (APIENTRYP __rafgl_bind_image_texture_proc)(GLuint unit, GLuint texture, GLint level, GLboolean layered, GLint layer, GLenum access, GLenum format);
+typedef void (APIENTRYP __rafgl_memory_barrier_proc)(GLbitfield barriers);
+static __rafgl_dispatch_compute_proc __gl_dispatch_compute = NULL;
+static __rafgl_bind_image_texture_proc __gl_bind_image_texture = NULL;
+static __rafgl_memory_barrier_proc __gl_memory_barrier = NULL;
+
+/* called once the context is current and glad is loaded */
+static void __rafgl_compute_load(GLADloadproc load)
+{
+    GLint major = 0, minor = 0;
+
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+
+    if(major < 4 || (major == 4 && minor < 3))
+    {
+        rafgl_log(RAFGL_INFO, "OpenGL %d.%d context, compute shaders are not available\n", major, minor);
+        return;
+    }
+
+    __gl_dispatch_compute = (__rafgl_dispatch_compute_proc) load("glDispatchCompute");
+    __gl_bind_image_texture = (__rafgl_bind_image_texture_proc) load("glBindImageTexture");
+    __gl_memory_barrier = (__rafgl_memory_barrier_proc) load("glMemoryBarrier");
+}
+
 static float __raster_corners[] = {
      1.0f, 1.0f,
     -1.0f, 1.0f,
@@ -389,13 +1002,48 @@ static float __raster_corners[] = {
 };
 
 
+static int __rafgl_latency_tracking = 0;
+
+static void __rafgl_input_push(int type, int key, int action)
+{
+    rafgl_input_event_t *last = __input_event_count ? &__input_events[(__input_event_head + __input_event_count - 1) % RAFGL_INPUT_EVENTS] : NULL;
+
+    /* the cursor is sampled once per frame anyway, a run of moves only needs the time of the first one */
+    if(type == RAFGL_INPUT_CURSOR && last != NULL && last->type == RAFGL_INPUT_CURSOR) return;
+
+    if(__input_event_count == RAFGL_INPUT_EVENTS)
+    {
+        rafgl_log(RAFGL_WARNING, "Input event queue is full, dropping an event!\n");
+        return;
+    }
+
+    rafgl_input_event_t *e = &__input_events[(__input_event_head + __input_event_count) % RAFGL_INPUT_EVENTS];
+    e->time = rafgl_time();
+    e->type = type;
+    e->key = key;
+    e->action = action;
+    __input_event_count++;
+}
+
+void __cursor_pos_callback(GLFWwindow* window, double x, double y)
+{
+    __rafgl_input_push(RAFGL_INPUT_CURSOR, 0, 0);
+}
+
+void __mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
+{
+    __rafgl_input_push(RAFGL_INPUT_BUTTON, button, action);
+}
+
 void __key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
 {
     /* printf("%c %d\n", key, action); */
-    if(__keys_down[key] == 0 && action != 0) __keys_pressed[key] = 1;
-        else __keys_pressed[key] = 0;
-    __keys_down[key] = action;
+    __rafgl_input_push(RAFGL_INPUT_KEY, key, action);
+}
 
+void __refresh_callback(GLFWwindow *window)
+{
+    __redraw_forced = 1;
 }
 
 void __error_callback(int error, const char* description)
@@ -407,583 +1055,2879 @@ char *__log_level_names[RAFGL_LOG_LEVELS] = {"error", "warning", "info"};
 FILE *__log_files[RAFGL_LOG_LEVELS];
 
 static float __rafgl_time_from_init = 0;
-void rafgl_log(int level, const char *format, ...)
+static int __rafgl_swap_interval = RAFGL_VSYNC_ON;
+
+static void __rafgl_apply_swap_interval(void)
 {
-    va_list args;
-    va_start(args, format);
-    FILE* fd = __log_files[level];
-    if(level == RAFGL_ERROR)
+#ifdef RAFGL_HEADLESS
+    /* a pbuffer is never presented, so there is nothing to sync to */
+    eglSwapInterval(__egl_display, 0);
+#else
+    int interval = __rafgl_swap_interval;
+    if(interval == RAFGL_VSYNC_ADAPTIVE && !glfwExtensionSupported("GLX_EXT_swap_control_tear") && !glfwExtensionSupported("WGL_EXT_swap_control_tear"))
     {
-        fprintf(stderr, "%s: ", __log_level_names[level]);
-        vfprintf(stderr, format, args);
-
+        rafgl_log(RAFGL_WARNING, "Adaptive vsync is not supported, using regular vsync instead!\n");
+        interval = RAFGL_VSYNC_ON;
     }
-    else
+    glfwSwapInterval(interval);
+#endif // RAFGL_HEADLESS
+}
+
+void rafgl_game_set_swap_interval(int interval)
+{
+    __rafgl_swap_interval = interval;
+    if(__done)
     {
-        printf("%s : ", __log_level_names[level]);
-        vprintf(format, args);
+        __rafgl_apply_swap_interval();
     }
+}
 
-    vfprintf(fd, format, args);
-    va_end(args);
+static int __rafgl_log_level = RAFGL_INFO;
+
+void rafgl_log_set_level(int level)
+{
+    __rafgl_log_level = level;
 }
 
+/* callers only pack the format pointer, its arguments and a timestamp into a lock-free ring,
+   a writer thread formats them and flushes once per batch */
+#ifndef RAFGL_LOG_RING
+#define RAFGL_LOG_RING 1024
+#endif // RAFGL_LOG_RING
+/* positions are masked into the ring */
+#if (RAFGL_LOG_RING) <= 0 || ((RAFGL_LOG_RING) & ((RAFGL_LOG_RING) - 1)) != 0
+#error "RAFGL_LOG_RING has to be a power of two"
+#endif
+#define RAFGL_LOG_ARG_BYTES 240
+#define RAFGL_LOG_MESSAGE 1024
+
+/* what a conversion takes from the argument list, the packer and the writer walk the format the same way */
+#define __RAFGL_LOG_ARG_NONE        0
+#define __RAFGL_LOG_ARG_INT         1
+#define __RAFGL_LOG_ARG_LONG        2
+#define __RAFGL_LOG_ARG_LLONG       3
+#define __RAFGL_LOG_ARG_SIZE        4
+#define __RAFGL_LOG_ARG_DOUBLE      5
+#define __RAFGL_LOG_ARG_LDOUBLE     6
+#define __RAFGL_LOG_ARG_STRING      7
+#define __RAFGL_LOG_ARG_POINTER     8
+#define __RAFGL_LOG_ARG_UNSUPPORTED 9
+
+typedef struct _rafgl_log_spec_t
+{
+    int length, stars, arg;
+} __rafgl_log_spec_t;
 
-int rafgl_game_init(rafgl_game_t *game, const char *title, int window_width, int window_height, int fullscreen)
+typedef struct _rafgl_log_entry_t
 {
-    if(__done) return -1;
-    __done = 1;
+    /* the ring position the slot is free for, plus one once the entry is published */
+    atomic_size_t sequence;
+    int level;
+    double time;
+    /* NULL when args already holds the formatted message */
+    const char *format;
+    unsigned char args[RAFGL_LOG_ARG_BYTES];
+} __rafgl_log_entry_t;
+
+static __rafgl_log_entry_t __log_ring[RAFGL_LOG_RING];
+static atomic_size_t __log_head, __log_tail;
+static atomic_int __log_writer_running, __log_writer_quit, __log_dropped;
+/* callers between deciding to push and having pushed, the writer isn't stopped for good until there are none */
+static atomic_int __log_producers;
+static pthread_t __log_writer;
+/* the writer waits on wake with an empty ring and sleeping set, producers only take the lock to signal it then;
+   rafgl_log_flush waits on drained, which the writer broadcasts after every batch */
+static pthread_mutex_t __log_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t __log_wake = PTHREAD_COND_INITIALIZER, __log_drained = PTHREAD_COND_INITIALIZER;
+static atomic_int __log_writer_sleeping;
+static int __rafgl_log_async = 1;
+static double __log_epoch = 0.0;
+
+/* messages per second, 0 is unlimited */
+static int __log_rate_limit[RAFGL_LOG_LEVELS] = {0, 200, 200};
+static atomic_long __log_rate_window[RAFGL_LOG_LEVELS];
+static atomic_int __log_rate_count[RAFGL_LOG_LEVELS], __log_rate_suppressed[RAFGL_LOG_LEVELS];
+
+
+void rafgl_log_set_async(int b)
+{
+    __rafgl_log_async = b;
+}
 
+void rafgl_log_set_rate_limit(int level, int per_second)
+{
+    if(level >= 0 && level < RAFGL_LOG_LEVELS)
+        __log_rate_limit[level] = per_second;
+}
 
-    int i;
-    char fnames[255];
-    for(i = 0; i < RAFGL_LOG_LEVELS; i++)
+/* spec points at the '%' */
+static __rafgl_log_spec_t __rafgl_log_parse_spec(const char *spec)
+{
+    __rafgl_log_spec_t s = {1, 0, __RAFGL_LOG_ARG_UNSUPPORTED};
+    const char *p = spec + 1;
+    int longs = 0, sized = 0, long_double = 0;
+
+    while(*p && strchr("-+ #0", *p)) p++;
+    if(*p == '*') { s.stars++; p++; }
+    else while(*p >= '0' && *p <= '9') p++;
+    if(*p == '.')
     {
-        sprintf(fnames, "logs/%s.log", __log_level_names[i]);
-        __log_files[i] = fopen(fnames, "w");
+        p++;
+        if(*p == '*') { s.stars++; p++; }
+        else while(*p >= '0' && *p <= '9') p++;
+    }
+    while(*p && strchr("hlLjzt", *p))
+    {
+        if(*p == 'l') longs++;
+        else if(*p == 'L') long_double = 1;
+        else if(*p != 'h') sized = 1;
+        p++;
     }
 
-    __window_width = window_width;
-    __window_height = window_height;
-
-    if(!glfwInit())
+    switch(*p)
     {
-        fprintf(stderr, "GLFWInit() failed\n");
+        case 'd': case 'i': case 'u': case 'x': case 'X': case 'o':
+            s.arg = sized ? __RAFGL_LOG_ARG_SIZE : longs >= 2 ? __RAFGL_LOG_ARG_LLONG : longs ? __RAFGL_LOG_ARG_LONG : __RAFGL_LOG_ARG_INT;
+            break;
+        case 'c':
+            s.arg = longs ? __RAFGL_LOG_ARG_UNSUPPORTED : __RAFGL_LOG_ARG_INT;
+            break;
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+            s.arg = long_double ? __RAFGL_LOG_ARG_LDOUBLE : __RAFGL_LOG_ARG_DOUBLE;
+            break;
+        case 's':
+            s.arg = longs ? __RAFGL_LOG_ARG_UNSUPPORTED : __RAFGL_LOG_ARG_STRING;
+            break;
+        case 'p':
+            s.arg = __RAFGL_LOG_ARG_POINTER;
+            break;
+        case '%':
+            s.arg = __RAFGL_LOG_ARG_NONE;
+            break;
     }
 
-    glfwSetErrorCallback(__error_callback);
+    if(*p) p++;
+    s.length = p - spec;
+    return s;
+}
 
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GLFW_TRUE);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
-    glfwWindowHint(GLFW_SAMPLES, 4);
+#define __RAFGL_LOG_PUT(type, value) do { type __v = (value); if(used + (int)sizeof(type) > RAFGL_LOG_ARG_BYTES) return -1; \
+                                          memcpy(out + used, &__v, sizeof(type)); used += sizeof(type); } while(0)
 
-    GLFWmonitor *mnt = glfwGetPrimaryMonitor();
+/* returns the bytes used, or -1 when the arguments don't fit or a conversion isn't supported */
+static int __rafgl_log_pack(unsigned char *out, const char *format, va_list args)
+{
+    int used = 0, k, length;
+    const char *p, *str;
+    __rafgl_log_spec_t spec;
 
-    const GLFWvidmode* mode = glfwGetVideoMode(mnt);
+    for(p = format; *p; p++)
+    {
+        if(*p != '%') continue;
+
+        spec = __rafgl_log_parse_spec(p);
+        for(k = 0; k < spec.stars; k++)
+        {
+            __RAFGL_LOG_PUT(int, va_arg(args, int));
+        }
 
+        switch(spec.arg)
+        {
+            case __RAFGL_LOG_ARG_INT: __RAFGL_LOG_PUT(int, va_arg(args, int)); break;
+            case __RAFGL_LOG_ARG_LONG: __RAFGL_LOG_PUT(long, va_arg(args, long)); break;
+            case __RAFGL_LOG_ARG_LLONG: __RAFGL_LOG_PUT(long long, va_arg(args, long long)); break;
+            case __RAFGL_LOG_ARG_SIZE: __RAFGL_LOG_PUT(size_t, va_arg(args, size_t)); break;
+            case __RAFGL_LOG_ARG_DOUBLE: __RAFGL_LOG_PUT(double, va_arg(args, double)); break;
+            case __RAFGL_LOG_ARG_LDOUBLE: __RAFGL_LOG_PUT(long double, va_arg(args, long double)); break;
+            case __RAFGL_LOG_ARG_POINTER: __RAFGL_LOG_PUT(void*, va_arg(args, void*)); break;
+            case __RAFGL_LOG_ARG_STRING:
+                /* the caller's buffer may be gone by the time the writer gets to it, so the characters are copied */
+                str = va_arg(args, const char*);
+                if(str == NULL) str = "(null)";
+                length = strlen(str) + 1;
+                if(used + length > RAFGL_LOG_ARG_BYTES) return -1;
+                memcpy(out + used, str, length);
+                used += length;
+                break;
+            case __RAFGL_LOG_ARG_UNSUPPORTED:
+                return -1;
+        }
 
-    if(fullscreen)
-    {
-        __window_width = mode->width;
-        __window_height = mode->height;
-        __window = glfwCreateWindow(mode->width, mode->height, title, mnt, NULL);
-    }
-    else
-    {
-        __window = glfwCreateWindow(window_width, window_height, title, NULL, NULL);
+        p += spec.length - 1;
     }
 
+    return used;
+}
+
+#define __RAFGL_LOG_GET(v) (memcpy(&(v), args + used, sizeof(v)), used += sizeof(v), (v))
 
-    if(__window == NULL)
+/* the writer's side of __rafgl_log_pack, every conversion is formatted on its own with the widths filled in */
+static void __rafgl_log_unpack(char *out, int size, const char *format, const unsigned char *args)
+{
+    int written = 0, used = 0, n, k, star;
+    int as_int;
+    long as_long;
+    long long as_llong;
+    size_t as_size;
+    double as_double;
+    long double as_ldouble;
+    void *as_pointer;
+    char spec_text[64];
+    const char *p = format;
+    __rafgl_log_spec_t spec;
+
+    while(*p && written < size - 1)
     {
-        rafgl_log(RAFGL_ERROR, "Failed to create GLFW window!\n");
-        glfwTerminate();
-        return -1;
-    }
+        if(*p != '%')
+        {
+            out[written++] = *p++;
+            continue;
+        }
 
-    glfwMakeContextCurrent(__window);
+        spec = __rafgl_log_parse_spec(p);
+        for(k = 0, n = 0; k < spec.length && n < (int)sizeof(spec_text) - 12; k++)
+        {
+            if(p[k] == '*')
+            {
+                memcpy(&star, args + used, sizeof(int));
+                used += sizeof(int);
+                n += sprintf(spec_text + n, "%d", star);
+            }
+            else spec_text[n++] = p[k];
+        }
+        spec_text[n] = 0;
 
-    if(!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
-    {
-        rafgl_log(RAFGL_ERROR, "Failed to initiate GLAD!\n");
-        glfwTerminate();
-        return -1;
+        switch(spec.arg)
+        {
+            case __RAFGL_LOG_ARG_INT: n = snprintf(out + written, size - written, spec_text, __RAFGL_LOG_GET(as_int)); break;
+            case __RAFGL_LOG_ARG_LONG: n = snprintf(out + written, size - written, spec_text, __RAFGL_LOG_GET(as_long)); break;
+            case __RAFGL_LOG_ARG_LLONG: n = snprintf(out + written, size - written, spec_text, __RAFGL_LOG_GET(as_llong)); break;
+            case __RAFGL_LOG_ARG_SIZE: n = snprintf(out + written, size - written, spec_text, __RAFGL_LOG_GET(as_size)); break;
+            case __RAFGL_LOG_ARG_DOUBLE: n = snprintf(out + written, size - written, spec_text, __RAFGL_LOG_GET(as_double)); break;
+            case __RAFGL_LOG_ARG_LDOUBLE: n = snprintf(out + written, size - written, spec_text, __RAFGL_LOG_GET(as_ldouble)); break;
+            case __RAFGL_LOG_ARG_POINTER: n = snprintf(out + written, size - written, spec_text, __RAFGL_LOG_GET(as_pointer)); break;
+            case __RAFGL_LOG_ARG_STRING:
+                n = snprintf(out + written, size - written, spec_text, (const char*)(args + used));
+                used += strlen((const char*)(args + used)) + 1;
+                break;
+            default:
+                n = snprintf(out + written, size - written, "%s", spec.arg == __RAFGL_LOG_ARG_NONE ? "%" : "");
+                break;
+        }
+
+        written += rafgl_clampi(n, 0, size - 1 - written);
+        p += spec.length;
     }
 
-    game -> window = __window;
-    game -> current_game_state = -1;
-    game -> next_game_state = -1;
-    rafgl_list_init(&(game -> game_states), sizeof(rafgl_game_state_t));
+    out[written] = 0;
+}
 
-    if(!__raster_vao)
-    {
-        glGenVertexArrays(1, &__raster_vao);
-        GLuint raster_vbo;
-        glGenBuffers(1, &raster_vbo);
-        glBindVertexArray(__raster_vao);
-        glBindBuffer(GL_ARRAY_BUFFER, raster_vbo);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(__raster_corners), __raster_corners, GL_STATIC_DRAW);
+static void __rafgl_log_write(int level, double time, const char *message)
+{
+    if(level == RAFGL_ERROR)
+        fprintf(stderr, "%s: %s", __log_level_names[level], message);
+    else
+        printf("%s : %s", __log_level_names[level], message);
 
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), NULL);
-        glBindVertexArray(0);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    /* log files are only opened by rafgl_game_init */
+    if(__log_files[level] != NULL)
+        fprintf(__log_files[level], "[%10.4f] %s", time - __log_epoch, message);
+}
+
+/* what was dropped because the ring was full or a level went over its rate, returns how many lines that took */
+static int __rafgl_log_report_losses(void)
+{
+    char message[128];
+    int level, count, lines = 0;
 
+    if((count = atomic_exchange(&__log_dropped, 0)))
+    {
+        snprintf(message, sizeof(message), "[log] ring full, %d message(s) dropped\n", count);
+        __rafgl_log_write(RAFGL_WARNING, rafgl_time(), message);
+        lines++;
     }
 
-    if(!__raster_program)
+    for(level = 0; level < RAFGL_LOG_LEVELS; level++)
     {
-        __raster_program = rafgl_program_create_from_source(__2D_raster_vertex_shader_source, __2D_raster_fragment_shader_source);
-        glUniform1i(glGetUniformLocation(__raster_program, "raster"), 0);
-        __flip = glGetUniformLocation(__raster_program, "uni_flip");
+        if((count = atomic_exchange(&__log_rate_suppressed[level], 0)))
+        {
+            snprintf(message, sizeof(message), "[log] rate limit, %d %s message(s) suppressed\n", count, __log_level_names[level]);
+            __rafgl_log_write(RAFGL_WARNING, rafgl_time(), message);
+            lines++;
+        }
     }
 
-    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    return lines;
+}
 
-    glfwSetKeyCallback(__window, __key_callback);
+static int __rafgl_log_rate_limited(int level, double now)
+{
+    int limit = __log_rate_limit[level];
+    long second = (long) now;
+    long window;
 
-    RAFGL_COLOUR_KEY.rgba = rafgl_RGB(255, 0, 254);
-    rafgl_spritesheet_init(&__mono_char_sheet[0], "res/fonts/chars-small.png", __countx, __county);
-    rafgl_spritesheet_init(&__mono_char_sheet[1], "res/fonts/chars.png", __countx, __county);
-    rafgl_spritesheet_init(&__mono_char_sheet[2], "res/fonts/chars-large.png", __countx, __county);
+    if(limit <= 0) return 0;
 
-    return 0;
+    window = atomic_load(&__log_rate_window[level]);
+    if(window != second && atomic_compare_exchange_strong(&__log_rate_window[level], &window, second))
+        atomic_store(&__log_rate_count[level], 0);
+
+    if(atomic_fetch_add(&__log_rate_count[level], 1) < limit) return 0;
+
+    atomic_fetch_add(&__log_rate_suppressed[level], 1);
+    return 1;
 }
 
-void rafgl_window_set_title(const char *name)
+/* a bounded MPSC queue: producers claim a position with a CAS on the head, then publish through the slot's sequence */
+static void __rafgl_log_push(int level, double time, const char *format, va_list args)
 {
-    glfwSetWindowTitle(__window, name);
-}
+    size_t position = atomic_load_explicit(&__log_head, memory_order_relaxed);
+    __rafgl_log_entry_t *entry;
+    va_list pack_args;
 
+    for(;;)
+    {
+        entry = &__log_ring[position & (RAFGL_LOG_RING - 1)];
+        size_t sequence = atomic_load_explicit(&entry->sequence, memory_order_acquire);
+        long difference = (long)(sequence - position);
 
-void __rafgl_raster_draw_spritesheet_text(rafgl_raster_t *raster, rafgl_spritesheet_t *spritesheet, int sheet_x, int sheet_y, int x, int y, uint32_t colour)
+        if(difference == 0)
+        {
+            if(atomic_compare_exchange_weak_explicit(&__log_head, &position, position + 1, memory_order_relaxed, memory_order_relaxed))
+                break;
+        }
+        else if(difference < 0)
+        {
+            /* the writer hasn't freed this slot yet, a frame spike is worse than a lost message */
+            atomic_fetch_add(&__log_dropped, 1);
+            return;
+        }
+        else
+        {
+            position = atomic_load_explicit(&__log_head, memory_order_relaxed);
+        }
+    }
+
+    entry->level = level;
+    entry->time = time;
+    entry->format = format;
+
+    va_copy(pack_args, args);
+    if(__rafgl_log_pack(entry->args, format, pack_args) < 0)
+    {
+        /* too long, or a conversion the packer doesn't know, so it is formatted here instead */
+        entry->format = NULL;
+        vsnprintf((char*) entry->args, RAFGL_LOG_ARG_BYTES, format, args);
+    }
+    va_end(pack_args);
+
+    atomic_store_explicit(&entry->sequence, position + 1, memory_order_release);
+
+    /* seq_cst on both sides: either the writer sees this entry before it sleeps or this sees it sleeping */
+    atomic_thread_fence(memory_order_seq_cst);
+    if(atomic_load(&__log_writer_sleeping))
+    {
+        pthread_mutex_lock(&__log_lock);
+        pthread_cond_signal(&__log_wake);
+        pthread_mutex_unlock(&__log_lock);
+    }
+}
+
+/* only ever called by one thread at a time: the writer, or whoever stops it once it's gone */
+static int __rafgl_log_drain(void)
 {
-    int fl, fr, fu, fd;
-    int flc, frc, fuc, fdc;
-    int xi, yi;
+    char message[RAFGL_LOG_MESSAGE];
+    size_t position = atomic_load_explicit(&__log_tail, memory_order_relaxed);
+    int count = 0, i;
 
-    rafgl_pixel_rgb_t sampled;
+    for(;;)
+    {
+        __rafgl_log_entry_t *entry = &__log_ring[position & (RAFGL_LOG_RING - 1)];
+        if(atomic_load_explicit(&entry->sequence, memory_order_acquire) != position + 1) break;
 
-    fl = x;
-    fr = x + spritesheet->frame_width;
-    fu = y;
-    fd = y + spritesheet->frame_height;
+        if(entry->format != NULL)
+            __rafgl_log_unpack(message, sizeof(message), entry->format, entry->args);
+        else
+            snprintf(message, sizeof(message), "%s", (const char*) entry->args);
 
-    flc = rafgl_max_m(fl, 0);
-    frc = rafgl_min_m(fr, raster->width);
-    fuc = rafgl_max_m(fu, 0);
-    fdc = rafgl_min_m(fd, raster->height);
+        __rafgl_log_write(entry->level, entry->time, message);
 
-    for(yi = fuc; yi < fdc; yi++)
+        atomic_store_explicit(&entry->sequence, position + RAFGL_LOG_RING, memory_order_release);
+        position++;
+        count++;
+    }
+
+    if(__rafgl_log_report_losses() || count)
     {
-        for(xi = flc; xi < frc; xi++)
+        fflush(stdout);
+        fflush(stderr);
+        for(i = 0; i < RAFGL_LOG_LEVELS; i++)
         {
-            sampled = pixel_at_m(spritesheet->sheet, sheet_x * spritesheet->frame_width + xi - fl, sheet_y * spritesheet->frame_height + yi - fu);
-            if(sampled.r || sampled.g || sampled.b)
-            {
-                pixel_at_pm(raster, xi, yi).rgba = colour;
-            }
+            if(__log_files[i] != NULL) fflush(__log_files[i]);
         }
     }
 
+    /* rafgl_log_flush waits on the tail, so it only moves once the batch is on its way to disk */
+    atomic_store_explicit(&__log_tail, position, memory_order_release);
+    return count;
 }
 
-
-int rafgl_raster_draw_string(rafgl_raster_t *raster, const char *s, int x, int y, uint32_t colour, int font_size)
+/* whether the entry at the tail is published, only the writer moves the tail */
+static int __rafgl_log_pending(void)
 {
+    size_t position = atomic_load_explicit(&__log_tail, memory_order_relaxed);
+    return atomic_load(&__log_ring[position & (RAFGL_LOG_RING - 1)].sequence) == position + 1;
+}
 
-    char c, i = 0, index, xt, yt, ox = 0, oy = 0;
-    while((c = s[i++]) != '\0')
+static void* __rafgl_log_writer_main(void *p)
+{
+    for(;;)
     {
-        if(c == '\n')
-        {
-            ox = -1;
-            oy++;
-        }
-        if(c < 32 || c >= 128)
+        if(__rafgl_log_drain())
         {
-            ox++;
+            pthread_mutex_lock(&__log_lock);
+            pthread_cond_broadcast(&__log_drained);
+            pthread_mutex_unlock(&__log_lock);
             continue;
         }
 
-        index = c - 32;
-        yt = index / __countx;
-        xt = index % __countx;
+        /* a message whose position was claimed but isn't published yet is still waited for */
+        if(atomic_load(&__log_writer_quit) && atomic_load(&__log_tail) == atomic_load(&__log_head))
+            break;
 
-        __rafgl_raster_draw_spritesheet_text(raster, &__mono_char_sheet[font_size % 3], xt, yt, x + ox * __mono_char_sheet[font_size % 3].frame_width, y + oy * __mono_char_sheet[font_size % 3].frame_height, colour);
-        ox++;
+        pthread_mutex_lock(&__log_lock);
+        atomic_store(&__log_writer_sleeping, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        while(!__rafgl_log_pending() && !atomic_load(&__log_writer_quit))
+            pthread_cond_wait(&__log_wake, &__log_lock);
+        atomic_store(&__log_writer_sleeping, 0);
+        pthread_mutex_unlock(&__log_lock);
+    }
+    return NULL;
+}
 
+static void __rafgl_log_stop_writer(void)
+{
+    if(!atomic_load(&__log_writer_running)) return;
+
+    /* later messages are written on the caller's thread again */
+    atomic_store(&__log_writer_running, 0);
+    pthread_mutex_lock(&__log_lock);
+    atomic_store(&__log_writer_quit, 1);
+    pthread_cond_signal(&__log_wake);
+    pthread_cond_broadcast(&__log_drained);
+    pthread_mutex_unlock(&__log_lock);
+    pthread_join(__log_writer, NULL);
+
+    /* a caller that saw the writer still running may be pushing after its last batch, which the final drain picks up */
+    while(atomic_load(&__log_producers) > 0)
+        sched_yield();
+    __rafgl_log_drain();
+}
 
+static void __rafgl_log_start_writer(void)
+{
+    static int at_exit_registered = 0;
+    size_t i;
 
+    if(!__rafgl_log_async || atomic_load(&__log_writer_running)) return;
 
+    for(i = 0; i < RAFGL_LOG_RING; i++)
+    {
+        atomic_store(&__log_ring[i].sequence, i);
     }
-}
+    atomic_store(&__log_head, 0);
+    atomic_store(&__log_tail, 0);
+    atomic_store(&__log_writer_quit, 0);
 
+    if(pthread_create(&__log_writer, NULL, __rafgl_log_writer_main, NULL))
+    {
+        rafgl_log(RAFGL_WARNING, "Failed to start the log writer thread, logging synchronously!\n");
+        return;
+    }
+    atomic_store(&__log_writer_running, 1);
 
-int rafgl_raster_init(rafgl_raster_t *raster, int width, int height)
-{
-    raster->data = calloc(width * height, sizeof(rafgl_pixel_rgb_t));
-    raster->width = width;
-    raster->height = height;
-    return 0;
+    /* exit() from anywhere still gets everything queued written out */
+    if(!at_exit_registered)
+    {
+        atexit(__rafgl_log_stop_writer);
+        at_exit_registered = 1;
+    }
 }
 
-int rafgl_raster_cleanup(rafgl_raster_t *raster)
+void rafgl_log_flush(void)
 {
-    free(raster->data);
-    raster->height = 0;
-    raster->width = 0;
-    return 0;
-}
+    int i;
 
+    if(atomic_load(&__log_writer_running))
+    {
+        size_t head = atomic_load(&__log_head);
+        pthread_mutex_lock(&__log_lock);
+        while(atomic_load(&__log_writer_running) && atomic_load(&__log_tail) < head)
+            pthread_cond_wait(&__log_drained, &__log_lock);
+        pthread_mutex_unlock(&__log_lock);
+        return;
+    }
 
-void rafgl_spritesheet_init(rafgl_spritesheet_t *spritesheet, const char *sheet_path, int sheet_width, int sheet_height)
-{
-    rafgl_raster_load_from_image(&(spritesheet->sheet), sheet_path);
-    spritesheet->sheet_width = sheet_width;
-    spritesheet->sheet_height = sheet_height;
-    spritesheet->frame_width = spritesheet->sheet.width / sheet_width;
-    spritesheet->frame_height = spritesheet->sheet.height / sheet_height;
+    fflush(stdout);
+    fflush(stderr);
+    for(i = 0; i < RAFGL_LOG_LEVELS; i++)
+    {
+        if(__log_files[i] != NULL) fflush(__log_files[i]);
+    }
 }
 
+void rafgl_log(int level, const char *format, ...)
+{
+    char message[RAFGL_LOG_MESSAGE];
+    va_list args;
+    double now;
 
+    if(level > __rafgl_log_level || level < 0) return;
 
-void rafgl_raster_draw_spritesheet(rafgl_raster_t *raster, rafgl_spritesheet_t *spritesheet, int sheet_x, int sheet_y, int x, int y)
-{
-    int fl, fr, fu, fd;
-    int flc, frc, fuc, fdc;
-    int xi, yi;
+    now = rafgl_time();
+    if(__rafgl_log_rate_limited(level, now)) return;
 
-    rafgl_pixel_rgb_t sampled;
+    va_start(args, format);
+    atomic_fetch_add(&__log_producers, 1);
+    if(atomic_load(&__log_writer_running))
+    {
+        __rafgl_log_push(level, now, format, args);
+    }
+    else
+    {
+        vsnprintf(message, sizeof(message), format, args);
+        __rafgl_log_write(level, now, message);
+        __rafgl_log_report_losses();
+    }
+    atomic_fetch_sub(&__log_producers, 1);
+    va_end(args);
+}
 
-    fl = x;
-    fr = x + spritesheet->frame_width;
-    fu = y;
-    fd = y + spritesheet->frame_height;
 
-    flc = rafgl_max_m(fl, 0);
-    frc = rafgl_min_m(fr, raster->width);
-    fuc = rafgl_max_m(fu, 0);
-    fdc = rafgl_min_m(fd, raster->height);
+#ifdef RAFGL_HEADLESS
 
-    for(yi = fuc; yi < fdc; yi++)
+/* headless backend: an EGL pbuffer stands in for the window and input stays at rest */
+static int __rafgl_window_create(const char *title, int fullscreen)
+{
+    EGLint major, minor, config_count;
+    EGLConfig config;
+
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+    if(get_platform_display != NULL)
     {
-        for(xi = flc; xi < frc; xi++)
-        {
-            sampled = pixel_at_m(spritesheet->sheet, sheet_x * spritesheet->frame_width + xi - fl, sheet_y * spritesheet->frame_height + yi - fu);
-            if(sampled.rgba != RAFGL_COLOUR_KEY.rgba)
-            {
-                pixel_at_pm(raster, xi, yi) = sampled;
-            }
-        }
+        __egl_display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    }
+#endif // EGL_PLATFORM_SURFACELESS_MESA
+    if(__egl_display == EGL_NO_DISPLAY)
+    {
+        __egl_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
     }
 
-}
+    if(__egl_display == EGL_NO_DISPLAY || !eglInitialize(__egl_display, &major, &minor))
+    {
+        rafgl_log(RAFGL_ERROR, "Failed to initialize EGL!\n");
+        return -1;
+    }
 
+    const EGLint config_attribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+        EGL_DEPTH_SIZE, 24,
+        EGL_NONE
+    };
+    const EGLint surface_attribs[] = {
+        EGL_WIDTH, __window_width,
+        EGL_HEIGHT, __window_height,
+        EGL_NONE
+    };
+    /* 4.3 for compute shaders, 3.3 is all the rest needs */
+    EGLint context_attribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 4,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
 
-int rafgl_raster_copy(rafgl_raster_t *raster_to, rafgl_raster_t *raster_from)
-{
+    if(!eglChooseConfig(__egl_display, config_attribs, &config, 1, &config_count) || config_count == 0)
+    {
+        rafgl_log(RAFGL_ERROR, "No EGL config with pbuffer and desktop GL support!\n");
+        eglTerminate(__egl_display);
+        return -1;
+    }
 
-    if(raster_to->data == NULL)
+    eglBindAPI(EGL_OPENGL_API);
+    __egl_surface = eglCreatePbufferSurface(__egl_display, config, surface_attribs);
+    __egl_context = eglCreateContext(__egl_display, config, EGL_NO_CONTEXT, context_attribs);
+    if(__egl_context == EGL_NO_CONTEXT)
     {
-        /* new raster */
-        rafgl_raster_init(raster_to, raster_from->width, raster_from->height);
+        context_attribs[1] = 3;
+        __egl_context = eglCreateContext(__egl_display, config, EGL_NO_CONTEXT, context_attribs);
     }
-    else if(raster_to -> width != raster_from -> width || raster_to -> height != raster_from -> height)
+
+    if(__egl_surface == EGL_NO_SURFACE || __egl_context == EGL_NO_CONTEXT || !eglMakeCurrent(__egl_display, __egl_surface, __egl_surface, __egl_context))
     {
-        /* resize */
-        rafgl_raster_cleanup(raster_to);
-        rafgl_raster_init(raster_to, raster_from->width, raster_from->height);
+        rafgl_log(RAFGL_ERROR, "Failed to create the headless GL context!\n");
+        eglTerminate(__egl_display);
+        return -1;
     }
 
-    /* just copy */
-    memcpy(raster_to->data, raster_from->data, raster_from->width * raster_from->height * sizeof(rafgl_pixel_rgb_t));
+    if(!gladLoadGLLoader((GLADloadproc)eglGetProcAddress))
+    {
+        rafgl_log(RAFGL_ERROR, "Failed to initiate GLAD!\n");
+        eglTerminate(__egl_display);
+        return -1;
+    }
+    __rafgl_compute_load((GLADloadproc)eglGetProcAddress);
+
+    rafgl_log(RAFGL_INFO, "Headless EGL %d.%d context [%s]\n", major, minor, glGetString(GL_RENDERER));
     return 0;
 }
 
-int rafgl_raster_load_from_image(rafgl_raster_t *raster, const char *image_path)
+static void __rafgl_window_poll_events(int wait)
 {
-    int width, height, channels;
-    raster->data = (rafgl_pixel_rgb_t *) stbi_load(image_path, &width, &height, &channels, 4);
-    raster->width = width;
-    raster->height = height;
-    return 0;
 }
 
-int rafgl_raster_save_to_png(rafgl_raster_t *raster, const char *image_path)
+static void __rafgl_window_swap(void)
 {
-    return stbi_write_png(image_path, raster->width, raster->height, 4, raster->data, 0);
+    eglSwapBuffers(__egl_display, __egl_surface);
 }
 
-void rafgl_raster_box_blur(rafgl_raster_t *result, rafgl_raster_t *tmp, rafgl_raster_t *from, int radius)
+static int __rafgl_window_should_close(void)
 {
-    int x, y;
-    float xn, yn, offset;
-    int sample_count = 2 * radius + 1;
+    return __close_requested;
+}
 
-    rafgl_pixel_rgb_t sampled, resulting;
+static void __rafgl_window_destroy(void)
+{
+    eglMakeCurrent(__egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(__egl_display, __egl_context);
+    eglDestroySurface(__egl_display, __egl_surface);
+    eglTerminate(__egl_display);
+}
 
-    int r, g, b;
+static void __rafgl_window_framebuffer_size(int *width, int *height)
+{
+    *width = __window_width;
+    *height = __window_height;
+}
 
+static void __rafgl_window_cursor_pos(double *x, double *y)
+{
+    *x = __headless_cursor_x;
+    *y = __headless_cursor_y;
+}
 
-    for(y = 0; y < tmp->height; y++)
-    {
-        for(x = 0; x < tmp->width; x++)
-        {
+static void __rafgl_window_set_cursor_pos(double x, double y)
+{
+    __headless_cursor_x = x;
+    __headless_cursor_y = y;
+}
 
-            r = 0;
-            g = 0;
-            b = 0;
-            for(offset = -radius; offset <= radius; offset++)
-            {
-                sampled = rafgl_point_sample(from, 1.0f * (x + offset) / (tmp->width), 1.0f * (y) / (tmp->height));
-                r += sampled.r;
-                g += sampled.g;
-                b += sampled.b;
-            }
+static void __rafgl_window_set_cursor_mode(int mode)
+{
+}
 
-            resulting.r = r / sample_count;
-            resulting.g = g / sample_count;
-            resulting.b = b / sample_count;
+static int __rafgl_window_mouse_button(int button)
+{
+    return 0;
+}
 
-            pixel_at_pm(tmp, x, y) = resulting;
-        }
-    }
+void rafgl_window_set_title(const char *name)
+{
+}
 
-    for(y = 0; y < result->height; y++)
+#else
+
+static int __rafgl_window_create(const char *title, int fullscreen)
+{
+    if(!glfwInit())
     {
-        for(x = 0; x < result->width; x++)
-        {
-            r = g = b = 0;
-            for(offset = -radius; offset <= radius; offset++)
-            {
-                sampled = rafgl_point_sample(tmp, 1.0f * (x) / result->width, 1.0f * (y + offset) / result->height);
-                r += sampled.r;
-                g += sampled.g;
-                b += sampled.b;
-            }
+        fprintf(stderr, "GLFWInit() failed\n");
+    }
 
-            resulting.r = r / sample_count;
-            resulting.g = g / sample_count;
-            resulting.b = b / sample_count;
+    glfwSetErrorCallback(__error_callback);
 
-            pixel_at_pm(result, x, y) = resulting;
-        }
-    }
-}
+    /* 4.3 for compute shaders, the window is made again with 3.3, which is all the rest needs, if that fails */
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GLFW_TRUE);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+    glfwWindowHint(GLFW_SAMPLES, 4);
 
-int rafgl_raster_draw_raster(rafgl_raster_t *to, rafgl_raster_t *from, int x, int y)
-{
+    GLFWmonitor *mnt = glfwGetPrimaryMonitor();
 
-    int fl, fr, fu, fd;
-    int flc, frc, fuc, fdc;
-    int xi, yi;
+    const GLFWvidmode* mode = glfwGetVideoMode(mnt);
 
-    rafgl_pixel_rgb_t sampled;
 
-    fl = x;
-    fr = x + from->width;
-    fu = y;
-    fd = y + from->height;
+    for(int attempt = 0; attempt < 2 && __window == NULL; attempt++)
+    {
+        if(attempt)
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+
+        if(fullscreen)
+        {
+            __window_width = mode->width;
+            __window_height = mode->height;
+            __window = glfwCreateWindow(mode->width, mode->height, title, mnt, NULL);
+        }
+        else
+        {
+            __window = glfwCreateWindow(__window_width, __window_height, title, NULL, NULL);
+        }
+    }
+
+
+    if(__window == NULL)
+    {
+        rafgl_log(RAFGL_ERROR, "Failed to create GLFW window!\n");
+        glfwTerminate();
+        return -1;
+    }
+
+    glfwMakeContextCurrent(__window);
+
+    if(!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    {
+        rafgl_log(RAFGL_ERROR, "Failed to initiate GLAD!\n");
+        glfwTerminate();
+        return -1;
+    }
+    __rafgl_compute_load((GLADloadproc)glfwGetProcAddress);
+
+    glfwSetKeyCallback(__window, __key_callback);
+    glfwSetWindowRefreshCallback(__window, __refresh_callback);
+    glfwSetCursorPosCallback(__window, __cursor_pos_callback);
+    glfwSetMouseButtonCallback(__window, __mouse_button_callback);
+
+    return 0;
+}
+
+static void __rafgl_window_poll_events(int wait)
+{
+    if(wait)
+        glfwWaitEventsTimeout(RAFGL_IDLE_TIMEOUT);
+    else
+        glfwPollEvents();
+}
+
+static void __rafgl_window_swap(void)
+{
+    glfwSwapBuffers(__window);
+}
+
+static int __rafgl_window_should_close(void)
+{
+    return __close_requested || glfwWindowShouldClose(__window);
+}
+
+static void __rafgl_window_destroy(void)
+{
+    glfwDestroyWindow(__window);
+    glfwTerminate();
+}
+
+static void __rafgl_window_framebuffer_size(int *width, int *height)
+{
+    glfwGetFramebufferSize(__window, width, height);
+}
+
+static void __rafgl_window_cursor_pos(double *x, double *y)
+{
+    glfwGetCursorPos(__window, x, y);
+}
+
+static void __rafgl_window_set_cursor_pos(double x, double y)
+{
+    glfwSetCursorPos(__window, x, y);
+}
+
+static void __rafgl_window_set_cursor_mode(int mode)
+{
+    glfwSetInputMode(__window, GLFW_CURSOR, mode);
+}
+
+static int __rafgl_window_mouse_button(int button)
+{
+    return glfwGetMouseButton(__window, button);
+}
+
+void rafgl_window_set_title(const char *name)
+{
+    glfwSetWindowTitle(__window, name);
+}
+
+#endif // RAFGL_HEADLESS
+
+void rafgl_window_request_close(void)
+{
+    __close_requested = 1;
+}
+
+int rafgl_game_init(rafgl_game_t *game, const char *title, int window_width, int window_height, int fullscreen)
+{
+    if(__done) return -1;
+    __done = 1;
+
+
+    int i;
+    char fnames[255];
+    for(i = 0; i < RAFGL_LOG_LEVELS; i++)
+    {
+        sprintf(fnames, "logs/%s.log", __log_level_names[i]);
+        __log_files[i] = fopen(fnames, "w");
+    }
+    __log_epoch = rafgl_time();
+    __rafgl_log_start_writer();
+
+    __window_width = window_width;
+    __window_height = window_height;
+
+    if(__rafgl_window_create(title, fullscreen))
+    {
+        return -1;
+    }
+
+    __rafgl_apply_swap_interval();
+
+    game -> window = __window;
+    game -> current_game_state = -1;
+    game -> next_game_state = -1;
+    rafgl_list_init(&(game -> game_states), sizeof(rafgl_game_state_t));
+
+    if(!__raster_vao)
+    {
+        glGenVertexArrays(1, &__raster_vao);
+        GLuint raster_vbo = rafgl_gpu_gen_buffer("rafgl raster quad");
+        glBindVertexArray(__raster_vao);
+        glBindBuffer(GL_ARRAY_BUFFER, raster_vbo);
+        rafgl_gl_buffer_data(GL_ARRAY_BUFFER, sizeof(__raster_corners), __raster_corners, GL_STATIC_DRAW);
+
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), NULL);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    }
+
+    if(!__fullscreen_vao)
+    {
+        glGenVertexArrays(1, &__fullscreen_vao);
+    }
+
+    if(!__raster_program)
+    {
+        __raster_program = rafgl_program_create_from_source(__2D_raster_vertex_shader_source, __2D_raster_fragment_shader_source);
+        glUniform1i(glGetUniformLocation(__raster_program, "raster"), 0);
+        __flip = glGetUniformLocation(__raster_program, "uni_flip");
+    }
+
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+
+    RAFGL_COLOUR_KEY.rgba = rafgl_RGB(255, 0, 254);
+    rafgl_font_init();
+
+    return 0;
+}
+
+void rafgl_font_init(void)
+{
+    rafgl_spritesheet_init(&__mono_char_sheet[0], "res/fonts/chars-small.png", __countx, __county);
+    rafgl_spritesheet_init(&__mono_char_sheet[1], "res/fonts/chars.png", __countx, __county);
+    rafgl_spritesheet_init(&__mono_char_sheet[2], "res/fonts/chars-large.png", __countx, __county);
+}
+
+
+void __rafgl_raster_draw_spritesheet_text(rafgl_raster_t *raster, rafgl_spritesheet_t *spritesheet, int sheet_x, int sheet_y, int x, int y, uint32_t colour)
+{
+    int fl, fr, fu, fd;
+    int flc, frc, fuc, fdc;
+    int xi, yi;
+
+    rafgl_pixel_rgb_t sampled;
+
+    fl = x;
+    fr = x + spritesheet->frame_width;
+    fu = y;
+    fd = y + spritesheet->frame_height;
 
     flc = rafgl_max_m(fl, 0);
-    frc = rafgl_min_m(fr, to->width);
+    frc = rafgl_min_m(fr, raster->width);
     fuc = rafgl_max_m(fu, 0);
-    fdc = rafgl_min_m(fd, to->height);
+    fdc = rafgl_min_m(fd, raster->height);
+
+    for(yi = fuc; yi < fdc; yi++)
+    {
+        for(xi = flc; xi < frc; xi++)
+        {
+            sampled = pixel_at_m(spritesheet->sheet, sheet_x * spritesheet->frame_width + xi - fl, sheet_y * spritesheet->frame_height + yi - fu);
+            if(sampled.r || sampled.g || sampled.b)
+            {
+                pixel_at_pm(raster, xi, yi).rgba = colour;
+            }
+        }
+    }
+
+}
+
+
+int rafgl_raster_draw_string(rafgl_raster_t *raster, const char *s, int x, int y, uint32_t colour, int font_size)
+{
+
+    /* ints, a char index wraps after 127 characters */
+    int i = 0, index, xt, yt, ox = 0, oy = 0;
+    char c;
+    while((c = s[i++]) != '\0')
+    {
+        if(c == '\n')
+        {
+            ox = -1;
+            oy++;
+        }
+        if(c < 32 || c >= 128)
+        {
+            ox++;
+            continue;
+        }
+
+        index = c - 32;
+        yt = index / __countx;
+        xt = index % __countx;
+
+        __rafgl_raster_draw_spritesheet_text(raster, &__mono_char_sheet[font_size % 3], xt, yt, x + ox * __mono_char_sheet[font_size % 3].frame_width, y + oy * __mono_char_sheet[font_size % 3].frame_height, colour);
+        ox++;
+
+
+
+
+    }
+
+    return 0;
+}
+
+
+int rafgl_raster_init(rafgl_raster_t *raster, int width, int height)
+{
+    raster->data = rafgl_calloc(RAFGL_ALLOC_RASTER, width * height, sizeof(rafgl_pixel_rgb_t));
+    raster->width = width;
+    raster->height = height;
+    return 0;
+}
+
+int rafgl_raster_cleanup(rafgl_raster_t *raster)
+{
+    rafgl_free(raster->data);
+    raster->height = 0;
+    raster->width = 0;
+    return 0;
+}
+
+
+void rafgl_spritesheet_init(rafgl_spritesheet_t *spritesheet, const char *sheet_path, int sheet_width, int sheet_height)
+{
+    rafgl_raster_load_from_image(&(spritesheet->sheet), sheet_path);
+    spritesheet->sheet_width = sheet_width;
+    spritesheet->sheet_height = sheet_height;
+    spritesheet->frame_width = spritesheet->sheet.width / sheet_width;
+    spritesheet->frame_height = spritesheet->sheet.height / sheet_height;
+}
+
+
+
+void rafgl_raster_draw_spritesheet(rafgl_raster_t *raster, rafgl_spritesheet_t *spritesheet, int sheet_x, int sheet_y, int x, int y)
+{
+    int fl, fr, fu, fd;
+    int flc, frc, fuc, fdc;
+    int xi, yi;
+
+    rafgl_pixel_rgb_t sampled;
+
+    fl = x;
+    fr = x + spritesheet->frame_width;
+    fu = y;
+    fd = y + spritesheet->frame_height;
+
+    flc = rafgl_max_m(fl, 0);
+    frc = rafgl_min_m(fr, raster->width);
+    fuc = rafgl_max_m(fu, 0);
+    fdc = rafgl_min_m(fd, raster->height);
+
+    for(yi = fuc; yi < fdc; yi++)
+    {
+        for(xi = flc; xi < frc; xi++)
+        {
+            sampled = pixel_at_m(spritesheet->sheet, sheet_x * spritesheet->frame_width + xi - fl, sheet_y * spritesheet->frame_height + yi - fu);
+            if(sampled.rgba != RAFGL_COLOUR_KEY.rgba)
+            {
+                pixel_at_pm(raster, xi, yi) = sampled;
+            }
+        }
+    }
+
+}
+
+
+int rafgl_raster_copy(rafgl_raster_t *raster_to, rafgl_raster_t *raster_from)
+{
+
+    if(raster_to->data == NULL)
+    {
+        /* new raster */
+        rafgl_raster_init(raster_to, raster_from->width, raster_from->height);
+    }
+    else if(raster_to -> width != raster_from -> width || raster_to -> height != raster_from -> height)
+    {
+        /* resize */
+        rafgl_raster_cleanup(raster_to);
+        rafgl_raster_init(raster_to, raster_from->width, raster_from->height);
+    }
+
+    /* just copy */
+    memcpy(raster_to->data, raster_from->data, raster_from->width * raster_from->height * sizeof(rafgl_pixel_rgb_t));
+    return 0;
+}
+
+int rafgl_raster_load_from_image(rafgl_raster_t *raster, const char *image_path)
+{
+    int width, height, channels;
+    raster->data = (rafgl_pixel_rgb_t *) stbi_load(image_path, &width, &height, &channels, 4);
+    if(raster->data == NULL)
+    {
+        raster->width = raster->height = 0;
+        return -1;
+    }
+    raster->width = width;
+    raster->height = height;
+    return 0;
+}
+
+int rafgl_raster_save_to_png(rafgl_raster_t *raster, const char *image_path)
+{
+    return stbi_write_png(image_path, raster->width, raster->height, 4, raster->data, 0);
+}
+
+void rafgl_raster_box_blur(rafgl_raster_t *result, rafgl_raster_t *tmp, rafgl_raster_t *from, int radius)
+{
+    int x, y;
+    float xn, yn, offset;
+    int sample_count = 2 * radius + 1;
+
+    rafgl_pixel_rgb_t sampled, resulting;
+
+    int r, g, b;
+
+
+    for(y = 0; y < tmp->height; y++)
+    {
+        for(x = 0; x < tmp->width; x++)
+        {
+
+            r = 0;
+            g = 0;
+            b = 0;
+            for(offset = -radius; offset <= radius; offset++)
+            {
+                sampled = rafgl_point_sample(from, 1.0f * (x + offset) / (tmp->width), 1.0f * (y) / (tmp->height));
+                r += sampled.r;
+                g += sampled.g;
+                b += sampled.b;
+            }
+
+            resulting.r = r / sample_count;
+            resulting.g = g / sample_count;
+            resulting.b = b / sample_count;
+
+            pixel_at_pm(tmp, x, y) = resulting;
+        }
+    }
+
+    for(y = 0; y < result->height; y++)
+    {
+        for(x = 0; x < result->width; x++)
+        {
+            r = g = b = 0;
+            for(offset = -radius; offset <= radius; offset++)
+            {
+                sampled = rafgl_point_sample(tmp, 1.0f * (x) / result->width, 1.0f * (y + offset) / result->height);
+                r += sampled.r;
+                g += sampled.g;
+                b += sampled.b;
+            }
+
+            resulting.r = r / sample_count;
+            resulting.g = g / sample_count;
+            resulting.b = b / sample_count;
+
+            pixel_at_pm(result, x, y) = resulting;
+        }
+    }
+}
+
+int rafgl_raster_draw_raster(rafgl_raster_t *to, rafgl_raster_t *from, int x, int y)
+{
+
+    int fl, fr, fu, fd;
+    int flc, frc, fuc, fdc;
+    int xi, yi;
+
+    rafgl_pixel_rgb_t sampled;
+
+    fl = x;
+    fr = x + from->width;
+    fu = y;
+    fd = y + from->height;
+
+    flc = rafgl_max_m(fl, 0);
+    frc = rafgl_min_m(fr, to->width);
+    fuc = rafgl_max_m(fu, 0);
+    fdc = rafgl_min_m(fd, to->height);
+
+    for(yi = fuc; yi < fdc; yi++)
+    {
+        for(xi = flc; xi < frc; xi++)
+        {
+            sampled = pixel_at_pm(from, xi - fl, yi - fu);
+            if(sampled.rgba != RAFGL_COLOUR_KEY.rgba)
+            {
+                pixel_at_pm(to, xi, yi) = sampled;
+            }
+        }
+    }
+
+
+}
+
+/* Cohen-Sutherland line clipping algorithm constants */
+static const int __cohsuth_INSIDE = 0;     /* 0000 */
+static const int __cohsuth_LEFT   = 1;     /* 0001 */
+static const int __cohsuth_RIGHT  = 2;     /* 0010 */
+static const int __cohsuth_BOTTOM = 4;     /* 0100 */
+static const int __cohsuth_TOP    = 8;     /* 1000 */
+
+static int __compute_outcode(int x, int y, rafgl_raster_t *raster)
+{
+    int xmin = 0, ymin = 0, xmax = raster->width - 1, ymax = raster->height - 1;
+    int code = __cohsuth_INSIDE;
+    if(x < xmin)
+    {
+        code |= __cohsuth_LEFT;
+    }
+    else if(x > xmax)
+    {
+        code |= __cohsuth_RIGHT;
+    }
+
+    if(y < ymin)
+    {
+        code |= __cohsuth_BOTTOM;
+    }
+    else if(y > ymax)
+    {
+        code |= __cohsuth_TOP;
+    }
+
+    return code;
+}
+
+void rafgl_raster_draw_line(rafgl_raster_t *raster, int x0, int y0, int x1, int y1, uint32_t colour)
+{
+
+    int xmin = 0, ymin = 0, xmax = raster->width - 1, ymax = raster->height - 1;
+    int outcode0 = __compute_outcode(x0, y0, raster);
+    int outcode1 = __compute_outcode(x1, y1, raster);
+    int accept = 0;
+    int xnew, ynew;
+    int outside_outcode;
+
+    while(1)
+    {
+
+        if(!(outcode0 | outcode1))
+        {
+            /* trivijalno prihvatanje */
+            accept = 1;
+            break;
+        }
+        else if(outcode0 & outcode1)
+        {
+            /* trivijalno odbacivanje */
+            break;
+        }
+        else
+        {
+            outside_outcode = outcode0 ? outcode0 : outcode1;
+            if(outside_outcode & __cohsuth_TOP)
+            {
+                xnew = x0 + (x1 - x0) * (ymax - y0) / (y1 - y0);
+                ynew = ymax;
+            }
+            else if(outside_outcode & __cohsuth_BOTTOM)
+            {
+                xnew = x0 + (x1 - x0) * (ymin - y0) / (y1 - y0);
+				ynew = ymin;
+            }
+            else if (outside_outcode & __cohsuth_RIGHT)
+            {
+				ynew = y0 + (y1 - y0) * (xmax - x0) / (x1 - x0);
+				xnew = xmax;
+			}
+			else if (outside_outcode & __cohsuth_LEFT)
+            {
+				ynew = y0 + (y1 - y0) * (xmin - x0) / (x1 - x0);
+				xnew = xmin;
+			}
+
+			if(outside_outcode == outcode0)
+            {
+                x0 = xnew;
+                y0 = ynew;
+                outcode0 = __compute_outcode(x0, y0, raster);
+            }
+            else
+            {
+                x1 = xnew;
+                y1 = ynew;
+                outcode1 = __compute_outcode(x1, y1, raster);
+            }
+        }
+
+
+    }
+
+
+    if(!accept)
+        return;
+
+    x0 = rafgl_clampi(x0, 0, xmax);
+    y0 = rafgl_clampi(y0, 0, ymax);
+    x1 = rafgl_clampi(x1, 0, xmax);
+    y1 = rafgl_clampi(y1, 0, ymax);
+
+
+    /* printf("---\nx0: %d\ny0: %d\nx1: %d\ny1: %d\n", x0, y0, x1, y1); */
+
+    int dx =  rafgl_abs_m((x1-x0)), sx = x0<x1 ? 1 : -1;
+    int dy = -rafgl_abs_m((y1-y0)), sy = y0<y1 ? 1 : -1;
+    int err = dx+dy, e2; /* error value e_xy */
+
+    while(1)
+    {
+        pixel_at_pm(raster, x0, y0).rgba = colour;
+        if (x0==x1 && y0==y1) break;
+        e2 = 2*err;
+        if (e2 >= dy) { err += dy; x0 += sx; } /* e_xy+e_x > 0 */
+        if (e2 <= dx) { err += dx; y0 += sy; } /* e_xy+e_y < 0 */
+    }
+
+}
+
+/* DOES NOT DO CLIPPING! */
+void rafgl_raster_draw_circle(rafgl_raster_t *raster, int cx, int cy, int r, uint32_t colour)
+{
+    int x = -r, y = 0, err = 2-2*r; /* II. Quadrant */
+    do {
+        pixel_at_pm(raster, cx-x, cy+y).rgba = colour; /*   I. Quadrant */
+        pixel_at_pm(raster, cx-y, cy-x).rgba = colour; /*  II. Quadrant */
+        pixel_at_pm(raster, cx+x, cy-y).rgba = colour; /* III. Quadrant */
+        pixel_at_pm(raster, cx+y, cy+x).rgba = colour; /*  IV. Quadrant */
+        r = err;
+        if (r <= y) err += ++y*2+1;           /* e_xy+e_y < 0 */
+        if (r > x || err > y) err += ++x*2+1; /* e_xy+e_x > 0 or no 2nd y-step */
+    } while (x < 0);
+}
+
+void rafgl_raster_draw_rectangle(rafgl_raster_t *raster, int x0, int y0, int w, int h, uint32_t colour)
+{
+    rafgl_raster_draw_line(raster, x0, y0, x0 + w, y0, colour);
+    rafgl_raster_draw_line(raster, x0, y0 + h, x0 + w, y0 + h, colour);
+    rafgl_raster_draw_line(raster, x0, y0, x0, y0 + h, colour);
+    rafgl_raster_draw_line(raster, x0 + w, y0, x0 + w, y0 + h, colour);
+}
+
+void rafgl_raster_bilinear_upsample(rafgl_raster_t *to, rafgl_raster_t *from)
+{
+    int x, y;
+    int w = to->width, h = to->height;
+    float xn, yn;
+
+    for(y = 0; y < h; y++)
+    {
+        yn = ((float)y) / h;
+        for(x = 0; x < w; x++)
+        {
+            xn = ((float)x) / w;
+            pixel_at_pm(to, x, y) = rafgl_bilinear_sample(from, xn, yn);
+        }
+    }
+}
+
+
+void rafgl_game_add_game_state(rafgl_game_t *game, void (*init)(GLFWwindow *window, void *args), void (*update)(GLFWwindow *window, float delta_time, rafgl_game_data_t *game_data, void *args), void (*render)(GLFWwindow *window, void *args), void (*cleanup)(GLFWwindow *window, void *args))
+{
+    rafgl_game_state_t state;
+    state.init = init;
+    state.update = update;
+    state.render = render;
+    state.cleanup = cleanup;
+    state.id = 0;
+
+    rafgl_list_append(&game->game_states, &state);
+}
+
+static int __rafgl_log_fps = 0;
+static int __game_state_change_request = -1;
+static void *__game_state_change_request_args = NULL;
+
+void rafgl_log_fps(int b)
+{
+    __rafgl_log_fps = b;
+}
+
+void rafgl_game_request_state_change(int state_index, void *args)
+{
+    __game_state_change_request = state_index;
+    __game_state_change_request_args = args;
+}
+
+int rafgl_snapshot_init(rafgl_snapshot_t *snapshot, int size)
+{
+    snapshot->data[0] = rafgl_calloc(RAFGL_ALLOC_OTHER, 1, size);
+    snapshot->data[1] = rafgl_calloc(RAFGL_ALLOC_OTHER, 1, size);
+    snapshot->size = size;
+    snapshot->front = 0;
+    return 0;
+}
+
+void* rafgl_snapshot_back(rafgl_snapshot_t *snapshot)
+{
+    return snapshot->data[!snapshot->front];
+}
+
+void* rafgl_snapshot_front(rafgl_snapshot_t *snapshot)
+{
+    return snapshot->data[snapshot->front];
+}
+
+void rafgl_snapshot_swap(rafgl_snapshot_t *snapshot)
+{
+    snapshot->front = !snapshot->front;
+    memcpy(snapshot->data[!snapshot->front], snapshot->data[snapshot->front], snapshot->size);
+}
+
+void rafgl_snapshot_cleanup(rafgl_snapshot_t *snapshot)
+{
+    rafgl_free(snapshot->data[0]);
+    rafgl_free(snapshot->data[1]);
+    snapshot->data[0] = snapshot->data[1] = NULL;
+    snapshot->size = 0;
+}
+
+static int __rafgl_pipelined = 0;
+static rafgl_snapshot_t *__rafgl_snapshot = NULL;
+
+void rafgl_game_set_pipelined(int b)
+{
+    __rafgl_pipelined = b;
+}
+
+void rafgl_game_set_snapshot(rafgl_snapshot_t *snapshot)
+{
+    __rafgl_snapshot = snapshot;
+}
+
+static int __rafgl_render_on_demand = 0;
+/* requested from update (possibly on the simulation thread), forced from main thread events, published by the loop */
+static int __redraw_requested = 0, __redraw_published = 1, __last_frame_drawn = 1;
+
+void rafgl_game_set_render_on_demand(int b)
+{
+    __rafgl_render_on_demand = b;
+    __redraw_forced = 1;
+}
+
+void rafgl_game_request_redraw(void)
+{
+    __redraw_requested = 1;
+}
+
+#define RAFGL_LATENCY_SAMPLES 256
+
+/* input time moves along with the frame it belongs to: polled -> published with the snapshot -> rendered */
+static double __polled_input_time = 0.0, __published_input_time = 0.0, __rendered_input_time = 0.0;
+static double __upload_time = 0.0;
+static float __latency_present_ms[RAFGL_LATENCY_SAMPLES], __latency_upload_ms[RAFGL_LATENCY_SAMPLES];
+static int __latency_sample_count = 0, __latency_sample_next = 0;
+
+void rafgl_latency_tracking(int b)
+{
+    __rafgl_latency_tracking = b;
+}
+
+void rafgl_input_latch_cursor(double *x, double *y)
+{
+    __rafgl_window_cursor_pos(x, y);
+    if(__rafgl_latency_tracking)
+    {
+        /* the frame now reflects the cursor as of this moment, not as of the poll */
+        __rendered_input_time = rafgl_time();
+    }
+}
+
+void rafgl_latency_mark_upload(void)
+{
+    if(__rafgl_latency_tracking)
+    {
+        __upload_time = rafgl_time();
+    }
+}
+
+static int __rafgl_compare_floats(const void *a, const void *b)
+{
+    float fa = *(const float*)a, fb = *(const float*)b;
+    return (fa > fb) - (fa < fb);
+}
+
+/* p in [0, 1], values must be sorted */
+static float __rafgl_percentile(const float *sorted, int count, float p)
+{
+    if(count <= 0) return 0.0f;
+    return sorted[rafgl_clampi((int)(p * (count - 1) + 0.5f), 0, count - 1)];
+}
+
+static void __rafgl_latency_frame_presented(void)
+{
+    if(!__rafgl_latency_tracking || __rendered_input_time == 0.0) return;
+
+    double now = rafgl_time();
+    __latency_present_ms[__latency_sample_next] = (now - __rendered_input_time) * 1000.0;
+    __latency_upload_ms[__latency_sample_next] = __upload_time >= __rendered_input_time ? (__upload_time - __rendered_input_time) * 1000.0 : 0.0f;
+    __latency_sample_next = (__latency_sample_next + 1) % RAFGL_LATENCY_SAMPLES;
+    if(__latency_sample_count < RAFGL_LATENCY_SAMPLES) __latency_sample_count++;
+
+    __rendered_input_time = 0.0;
+}
+
+static void __rafgl_latency_log(void)
+{
+    float present[RAFGL_LATENCY_SAMPLES], upload[RAFGL_LATENCY_SAMPLES];
+    int n = __latency_sample_count;
+
+    if(!__rafgl_latency_tracking || n == 0) return;
+
+    memcpy(present, __latency_present_ms, n * sizeof(float));
+    memcpy(upload, __latency_upload_ms, n * sizeof(float));
+    qsort(present, n, sizeof(float), __rafgl_compare_floats);
+    qsort(upload, n, sizeof(float), __rafgl_compare_floats);
+
+    rafgl_log(RAFGL_INFO, "[latency] input-to-present p50 %.2f p90 %.2f p99 %.2f max %.2f ms, input-to-upload p50 %.2f p99 %.2f ms (%d frames)\n",
+              __rafgl_percentile(present, n, 0.5f), __rafgl_percentile(present, n, 0.9f), __rafgl_percentile(present, n, 0.99f), __rafgl_percentile(present, n, 1.0f),
+              __rafgl_percentile(upload, n, 0.5f), __rafgl_percentile(upload, n, 0.99f), n);
+}
+
+double rafgl_time(void)
+{
+#ifdef _WIN32
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    if(!frequency.QuadPart) QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double) counter.QuadPart / frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif // _WIN32
+}
+
+typedef struct _rafgl_profile_zone_t
+{
+    const char *name;
+    double cpu_begin;
+    float cpu_ms[RAFGL_PROFILE_HISTORY], gpu_ms[RAFGL_PROFILE_HISTORY];
+    int cpu_count, cpu_next, gpu_count, gpu_next;
+
+    GLuint queries[RAFGL_PROFILE_QUERY_FRAMES];
+    /* trace event waiting for the query result, -1 when the slot is free */
+    int query_event[RAFGL_PROFILE_QUERY_FRAMES], query_frame[RAFGL_PROFILE_QUERY_FRAMES];
+    int active_slot, trace_event;
+} rafgl_profile_zone_t;
+
+typedef struct _rafgl_profile_event_t
+{
+    int zone, frame;
+    double begin;
+    float cpu_ms, gpu_ms;
+} rafgl_profile_event_t;
+
+static int __rafgl_profile_enabled = 0;
+static rafgl_profile_zone_t __profile_zones[RAFGL_PROFILE_MAX_ZONES];
+static int __profile_zone_count = 0, __profile_frame = 0, __profile_gpu_zone = -1;
+static rafgl_profile_event_t __profile_events[RAFGL_PROFILE_TRACE_EVENTS];
+static int __profile_event_count = 0, __profile_event_next = 0;
+static double __profile_epoch = 0.0;
+/* update writes the pending request and publish hands it over to frame end, so no buffer is shared between threads */
+static char __profile_export_pending[256], __profile_export_request[256];
+
+void rafgl_profile_enable(int b)
+{
+    __rafgl_profile_enabled = b;
+    if(__profile_epoch == 0.0) __profile_epoch = rafgl_time();
+}
+
+int rafgl_profile_is_enabled(void)
+{
+    return __rafgl_profile_enabled;
+}
+
+int rafgl_profile_zone(const char *name)
+{
+    int i;
+    for(i = 0; i < __profile_zone_count; i++)
+    {
+        if(__profile_zones[i].name == name || !strcmp(__profile_zones[i].name, name)) return i;
+    }
+    if(__profile_zone_count == RAFGL_PROFILE_MAX_ZONES)
+    {
+        rafgl_log(RAFGL_WARNING, "Too many profiling zones, [%s] is not profiled!\n", name);
+        return -1;
+    }
+
+    rafgl_profile_zone_t *z = &__profile_zones[__profile_zone_count];
+    memset(z, 0, sizeof(*z));
+    z->name = name;
+    z->active_slot = -1;
+    for(i = 0; i < RAFGL_PROFILE_QUERY_FRAMES; i++)
+    {
+        z->query_event[i] = -1;
+    }
+    return __profile_zone_count++;
+}
+
+static void __rafgl_profile_push(float *history, int *count, int *next, float value)
+{
+    history[*next] = value;
+    *next = (*next + 1) % RAFGL_PROFILE_HISTORY;
+    if(*count < RAFGL_PROFILE_HISTORY) (*count)++;
+}
+
+/* reads a finished query, returns 0 without touching anything when the result isn't there yet */
+static int __rafgl_profile_collect(rafgl_profile_zone_t *z, int slot)
+{
+    GLint available = 0;
+    GLuint64 elapsed_ns;
+
+    if(z->query_event[slot] < 0) return 1;
+
+    glGetQueryObjectiv(z->queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+    if(!available) return 0;
+
+    glGetQueryObjectui64v(z->queries[slot], GL_QUERY_RESULT, &elapsed_ns);
+    int event = z->query_event[slot];
+    z->query_event[slot] = -1;
+
+    /* some drivers (llvmpipe among them) report garbage for the first timer query of a context */
+    if(z->query_frame[slot] == 0) return 1;
+
+    __rafgl_profile_push(z->gpu_ms, &z->gpu_count, &z->gpu_next, elapsed_ns * 1e-6f);
+
+    /* the event may have been overwritten by a newer one if the trace ring wrapped */
+    rafgl_profile_event_t *e = &__profile_events[event];
+    if(e->zone == z - __profile_zones && e->gpu_ms < 0.0f)
+    {
+        e->gpu_ms = elapsed_ns * 1e-6f;
+    }
+
+    return 1;
+}
+
+void rafgl_profile_begin(int zone)
+{
+    if(!__rafgl_profile_enabled || zone < 0) return;
+
+    rafgl_profile_zone_t *z = &__profile_zones[zone];
+    int slot = __profile_frame % RAFGL_PROFILE_QUERY_FRAMES;
+
+    z->trace_event = __profile_event_next;
+    __profile_event_next = (__profile_event_next + 1) % RAFGL_PROFILE_TRACE_EVENTS;
+    if(__profile_event_count < RAFGL_PROFILE_TRACE_EVENTS) __profile_event_count++;
+
+    rafgl_profile_event_t *e = &__profile_events[z->trace_event];
+    e->zone = zone;
+    e->frame = __profile_frame;
+    e->cpu_ms = 0.0f;
+    e->gpu_ms = -1.0f;
+
+    z->active_slot = -1;
+    if(__profile_gpu_zone < 0 && __rafgl_profile_collect(z, slot))
+    {
+        if(!z->queries[0]) glGenQueries(RAFGL_PROFILE_QUERY_FRAMES, z->queries);
+        glBeginQuery(GL_TIME_ELAPSED, z->queries[slot]);
+        z->query_event[slot] = z->trace_event;
+        z->query_frame[slot] = __profile_frame;
+        z->active_slot = slot;
+        __profile_gpu_zone = zone;
+    }
+
+    z->cpu_begin = e->begin = rafgl_time();
+}
+
+int rafgl_profile_begin_named(const char *name)
+{
+    int zone = __rafgl_profile_enabled ? rafgl_profile_zone(name) : -1;
+    rafgl_profile_begin(zone);
+    return zone;
+}
+
+void rafgl_profile_end(int zone)
+{
+    if(!__rafgl_profile_enabled || zone < 0) return;
+
+    rafgl_profile_zone_t *z = &__profile_zones[zone];
+    float cpu_ms = (rafgl_time() - z->cpu_begin) * 1000.0;
+
+    if(z->active_slot >= 0)
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+        z->active_slot = -1;
+        __profile_gpu_zone = -1;
+    }
+
+    __profile_events[z->trace_event].cpu_ms = cpu_ms;
+    __rafgl_profile_push(z->cpu_ms, &z->cpu_count, &z->cpu_next, cpu_ms);
+}
+
+void rafgl_profile_request_export(const char *basename)
+{
+    strncpy(__profile_export_pending, basename, sizeof(__profile_export_pending) - 1);
+}
+
+/* main thread, while update isn't running */
+static void __rafgl_profile_publish_export(void)
+{
+    if(!__profile_export_pending[0]) return;
+
+    strcpy(__profile_export_request, __profile_export_pending);
+    __profile_export_pending[0] = '\0';
+}
+
+void rafgl_profile_frame_end(void)
+{
+    int i, slot;
+    char path[300];
+
+    if(!__rafgl_profile_enabled) return;
+
+    for(i = 0; i < __profile_zone_count; i++)
+    {
+        for(slot = 0; slot < RAFGL_PROFILE_QUERY_FRAMES; slot++)
+        {
+            __rafgl_profile_collect(&__profile_zones[i], slot);
+        }
+    }
+    __profile_frame++;
+
+    if(__profile_export_request[0])
+    {
+        sprintf(path, "%s.json", __profile_export_request);
+        rafgl_profile_export_trace(path);
+        sprintf(path, "%s.csv", __profile_export_request);
+        rafgl_profile_export_csv(path);
+        rafgl_log(RAFGL_INFO, "Exported profile to [%s.json] and [%s.csv]\n", __profile_export_request, __profile_export_request);
+        __profile_export_request[0] = '\0';
+    }
+}
+
+int rafgl_profile_zone_count(void)
+{
+    return __profile_zone_count;
+}
+
+/* fills min, avg, p50, p90, p99 and max in that order */
+static void __rafgl_profile_summarize(const float *history, int count, float *out)
+{
+    float sorted[RAFGL_PROFILE_HISTORY];
+    double sum = 0.0;
+    int i;
+
+    memset(out, 0, 6 * sizeof(float));
+    if(count == 0) return;
+
+    memcpy(sorted, history, count * sizeof(float));
+    qsort(sorted, count, sizeof(float), __rafgl_compare_floats);
+    for(i = 0; i < count; i++)
+    {
+        sum += sorted[i];
+    }
+    out[0] = sorted[0];
+    out[1] = sum / count;
+    out[2] = __rafgl_percentile(sorted, count, 0.5f);
+    out[3] = __rafgl_percentile(sorted, count, 0.9f);
+    out[4] = __rafgl_percentile(sorted, count, 0.99f);
+    out[5] = sorted[count - 1];
+}
+
+rafgl_profile_stats_t rafgl_profile_get_stats(int zone)
+{
+    rafgl_profile_stats_t stats;
+    memset(&stats, 0, sizeof(stats));
+    if(zone < 0 || zone >= __profile_zone_count) return stats;
+
+    rafgl_profile_zone_t *z = &__profile_zones[zone];
+    stats.name = z->name;
+    stats.cpu_samples = z->cpu_count;
+    stats.gpu_samples = z->gpu_count;
+    float summary[6];
+    __rafgl_profile_summarize(z->cpu_ms, z->cpu_count, summary);
+    stats.cpu_ms_min = summary[0];
+    stats.cpu_ms_avg = summary[1];
+    stats.cpu_ms_p50 = summary[2];
+    stats.cpu_ms_p90 = summary[3];
+    stats.cpu_ms_p99 = summary[4];
+    stats.cpu_ms_max = summary[5];
+    __rafgl_profile_summarize(z->gpu_ms, z->gpu_count, summary);
+    stats.gpu_ms_min = summary[0];
+    stats.gpu_ms_avg = summary[1];
+    stats.gpu_ms_p50 = summary[2];
+    stats.gpu_ms_p90 = summary[3];
+    stats.gpu_ms_p99 = summary[4];
+    stats.gpu_ms_max = summary[5];
+    return stats;
+}
+
+void rafgl_profile_reset(void)
+{
+    int i, slot;
+
+    for(i = 0; i < __profile_zone_count; i++)
+    {
+        rafgl_profile_zone_t *z = &__profile_zones[i];
+        z->cpu_count = z->cpu_next = 0;
+        z->gpu_count = z->gpu_next = 0;
+        /* results still in flight belong to the discarded samples */
+        for(slot = 0; slot < RAFGL_PROFILE_QUERY_FRAMES; slot++)
+        {
+            z->query_event[slot] = -1;
+        }
+    }
+    __profile_event_count = __profile_event_next = 0;
+}
+
+void rafgl_profile_log(void)
+{
+    int i;
+    rafgl_profile_stats_t st;
+
+    if(!__rafgl_profile_enabled) return;
+
+    for(i = 0; i < __profile_zone_count; i++)
+    {
+        st = rafgl_profile_get_stats(i);
+        rafgl_log(RAFGL_INFO, "[profile] %-10s cpu min %6.2f avg %6.2f p99 %6.2f | gpu min %6.2f avg %6.2f p99 %6.2f ms\n", st.name,
+                  st.cpu_ms_min, st.cpu_ms_avg, st.cpu_ms_p99, st.gpu_ms_min, st.gpu_ms_avg, st.gpu_ms_p99);
+    }
+}
+
+int rafgl_profile_export_trace(const char *path)
+{
+    FILE *f = fopen(path, "w");
+    int i, first = 1;
+    double gpu_cursor = 0.0;
+
+    if(f == NULL)
+    {
+        rafgl_log(RAFGL_ERROR, "Failed to open [%s] for the profile trace!\n", path);
+        return -1;
+    }
+
+    fprintf(f, "{\"traceEvents\":[\n");
+    fprintf(f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n");
+    fprintf(f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}");
+
+    /* oldest to newest */
+    for(i = 0; i < __profile_event_count; i++)
+    {
+        int index = (__profile_event_next - __profile_event_count + i + RAFGL_PROFILE_TRACE_EVENTS) % RAFGL_PROFILE_TRACE_EVENTS;
+        rafgl_profile_event_t *e = &__profile_events[index];
+        double begin_us = (e->begin - __profile_epoch) * 1e6;
+
+        fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%d}}",
+                __profile_zones[e->zone].name, begin_us, e->cpu_ms * 1000.0, e->frame);
+
+        if(e->gpu_ms >= 0.0f)
+        {
+            /* the GPU can't start a pass before it's submitted or before the previous one is done */
+            gpu_cursor = rafgl_max_m(gpu_cursor, begin_us);
+            fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":1,\"tid\":2,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%d}}",
+                    __profile_zones[e->zone].name, gpu_cursor, e->gpu_ms * 1000.0, e->frame);
+            gpu_cursor += e->gpu_ms * 1000.0;
+        }
+        first = 0;
+    }
+
+    fprintf(f, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    fclose(f);
+    return first ? 1 : 0;
+}
+
+int rafgl_profile_export_csv(const char *path)
+{
+    FILE *f = fopen(path, "w");
+    int i;
+    rafgl_profile_stats_t st;
+
+    if(f == NULL)
+    {
+        rafgl_log(RAFGL_ERROR, "Failed to open [%s] for the profile summary!\n", path);
+        return -1;
+    }
+
+    fprintf(f, "zone,cpu_samples,cpu_ms_min,cpu_ms_avg,cpu_ms_p99,gpu_samples,gpu_ms_min,gpu_ms_avg,gpu_ms_p99\n");
+    for(i = 0; i < __profile_zone_count; i++)
+    {
+        st = rafgl_profile_get_stats(i);
+        fprintf(f, "%s,%d,%.4f,%.4f,%.4f,%d,%.4f,%.4f,%.4f\n", st.name, st.cpu_samples, st.cpu_ms_min, st.cpu_ms_avg, st.cpu_ms_p99,
+                st.gpu_samples, st.gpu_ms_min, st.gpu_ms_avg, st.gpu_ms_p99);
+    }
+
+    fclose(f);
+    return 0;
+}
+
+typedef struct _rafgl_gpu_object_t
+{
+    int category;
+    GLuint id;
+    const char *tag, *scope;
+    long long bytes;
+    /* textures, one face of level 0 */
+    long long level_bytes;
+    int faces, mipmapped;
+    /* the game state the object was made in, 0 before the first one */
+    int state;
+} rafgl_gpu_object_t;
+
+static const char *__gpu_category_names[RAFGL_GPU_CATEGORIES] = {"texture", "buffer", "renderbuffer", "framebuffer"};
+static rafgl_gpu_object_t *__gpu_objects = NULL;
+static int __gpu_object_count = 0, __gpu_object_capacity = 0, __gpu_state = 0;
+static const char *__gpu_scope = NULL;
+static rafgl_gpu_memory_t __gpu_memory;
+
+/* kilobytes below 10 MB, megabytes above */
+static void __rafgl_format_bytes(char *s, int size, long long bytes)
+{
+    if(bytes < 10 * 1024 * 1024)
+        snprintf(s, size, "%.1f KB", bytes / 1024.0);
+    else
+        snprintf(s, size, "%.1f MB", bytes / (1024.0 * 1024.0));
+}
+
+static rafgl_gpu_object_t* __rafgl_gpu_find(int category, GLuint id)
+{
+    int i;
+    for(i = __gpu_object_count - 1; i >= 0; i--)
+    {
+        if(__gpu_objects[i].category == category && __gpu_objects[i].id == id)
+            return &__gpu_objects[i];
+    }
+    return NULL;
+}
+
+static void __rafgl_gpu_track(int category, GLuint id, const char *tag)
+{
+    rafgl_gpu_object_t *o;
+
+    if(id == 0) return;
+
+    if(__gpu_object_count == __gpu_object_capacity)
+    {
+        int capacity = __gpu_object_capacity ? __gpu_object_capacity * 2 : 64;
+        rafgl_gpu_object_t *objects = rafgl_realloc(RAFGL_ALLOC_OTHER, __gpu_objects, capacity * sizeof(rafgl_gpu_object_t));
+        if(objects == NULL) return;
+        __gpu_objects = objects;
+        __gpu_object_capacity = capacity;
+    }
+
+    o = &__gpu_objects[__gpu_object_count++];
+    memset(o, 0, sizeof(*o));
+    o->category = category;
+    o->id = id;
+    o->tag = tag;
+    o->scope = __gpu_scope;
+    o->faces = 1;
+    o->state = __gpu_state;
+
+    __gpu_memory.objects[category]++;
+}
+
+static void __rafgl_gpu_resize(rafgl_gpu_object_t *o, long long bytes)
+{
+    __gpu_memory.bytes[o->category] += bytes - o->bytes;
+    __gpu_memory.total_bytes += bytes - o->bytes;
+    __gpu_memory.peak_bytes = rafgl_max_m(__gpu_memory.peak_bytes, __gpu_memory.total_bytes);
+    o->bytes = bytes;
+}
+
+static void __rafgl_gpu_untrack(int category, GLuint id)
+{
+    rafgl_gpu_object_t *o = __rafgl_gpu_find(category, id);
+
+    if(o == NULL) return;
+
+    __rafgl_gpu_resize(o, 0);
+    __gpu_memory.objects[category]--;
+    *o = __gpu_objects[--__gpu_object_count];
+}
+
+/* estimated bytes per texel the driver keeps, three channel formats are assumed to be padded to four */
+static int __rafgl_gpu_texel_size(GLint internalformat)
+{
+    switch(internalformat)
+    {
+        case GL_R8: case GL_RED: return 1;
+        case GL_RG8: case GL_RG8_SNORM: case GL_RG: case GL_R16F: case GL_DEPTH_COMPONENT16: return 2;
+        case GL_RG16F: case GL_R32F: return 4;
+        case GL_RGBA16F: case GL_RGB16F: case GL_RG32F: return 8;
+        case GL_RGBA32F: case GL_RGB32F: return 16;
+        default: return 4;
+    }
+}
+
+/* level 0 of the texture bound to target was (re)specified, layers is 1 for anything but an array */
+static void __rafgl_gpu_texture_storage(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLsizei layers)
+{
+    GLint bound = 0;
+    int cube = target >= GL_TEXTURE_CUBE_MAP_POSITIVE_X && target <= GL_TEXTURE_CUBE_MAP_NEGATIVE_Z;
+    int array = target == GL_TEXTURE_2D_ARRAY;
+    rafgl_gpu_object_t *o;
+
+    if(level != 0 || (target != GL_TEXTURE_2D && !cube && !array)) return;
+
+    glGetIntegerv(cube ? GL_TEXTURE_BINDING_CUBE_MAP : array ? GL_TEXTURE_BINDING_2D_ARRAY : GL_TEXTURE_BINDING_2D, &bound);
+    if((o = __rafgl_gpu_find(RAFGL_GPU_TEXTURE, bound)) == NULL) return;
+
+    o->level_bytes = (long long)width * height * __rafgl_gpu_texel_size(internalformat);
+    o->faces = cube ? 6 : layers;
+    __rafgl_gpu_resize(o, o->level_bytes * o->faces * (o->mipmapped ? 4 : 3) / 3);
+}
+
+static void __rafgl_gpu_texture_mipmapped(GLenum target)
+{
+    GLint bound = 0;
+    rafgl_gpu_object_t *o;
+
+    glGetIntegerv(target == GL_TEXTURE_CUBE_MAP ? GL_TEXTURE_BINDING_CUBE_MAP : GL_TEXTURE_BINDING_2D, &bound);
+    if((o = __rafgl_gpu_find(RAFGL_GPU_TEXTURE, bound)) == NULL || o->mipmapped) return;
+
+    o->mipmapped = 1;
+    __rafgl_gpu_resize(o, o->level_bytes * o->faces * 4 / 3);
+}
+
+static void __rafgl_gpu_buffer_storage(GLenum target, GLsizeiptr size)
+{
+    GLint bound = 0;
+    rafgl_gpu_object_t *o;
+
+    if(target == GL_ARRAY_BUFFER)
+        glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &bound);
+    else if(target == GL_ELEMENT_ARRAY_BUFFER)
+        glGetIntegerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &bound);
+
+    if((o = __rafgl_gpu_find(RAFGL_GPU_BUFFER, bound)) != NULL)
+        __rafgl_gpu_resize(o, size);
+}
+
+GLuint rafgl_gpu_gen_texture(const char *tag)
+{
+    GLuint id = 0;
+    glGenTextures(1, &id);
+    __rafgl_gpu_track(RAFGL_GPU_TEXTURE, id, tag);
+    return id;
+}
+
+GLuint rafgl_gpu_gen_buffer(const char *tag)
+{
+    GLuint id = 0;
+    glGenBuffers(1, &id);
+    __rafgl_gpu_track(RAFGL_GPU_BUFFER, id, tag);
+    return id;
+}
+
+GLuint rafgl_gpu_gen_renderbuffer(const char *tag)
+{
+    GLuint id = 0;
+    glGenRenderbuffers(1, &id);
+    __rafgl_gpu_track(RAFGL_GPU_RENDERBUFFER, id, tag);
+    return id;
+}
+
+GLuint rafgl_gpu_gen_framebuffer(const char *tag)
+{
+    GLuint id = 0;
+    glGenFramebuffers(1, &id);
+    __rafgl_gpu_track(RAFGL_GPU_FRAMEBUFFER, id, tag);
+    return id;
+}
+
+void rafgl_gpu_delete_texture(GLuint id)
+{
+    __rafgl_gpu_untrack(RAFGL_GPU_TEXTURE, id);
+    glDeleteTextures(1, &id);
+}
+
+void rafgl_gpu_delete_buffer(GLuint id)
+{
+    __rafgl_gpu_untrack(RAFGL_GPU_BUFFER, id);
+    glDeleteBuffers(1, &id);
+}
+
+void rafgl_gpu_delete_renderbuffer(GLuint id)
+{
+    __rafgl_gpu_untrack(RAFGL_GPU_RENDERBUFFER, id);
+    glDeleteRenderbuffers(1, &id);
+}
+
+void rafgl_gpu_delete_framebuffer(GLuint id)
+{
+    __rafgl_gpu_untrack(RAFGL_GPU_FRAMEBUFFER, id);
+    glDeleteFramebuffers(1, &id);
+}
+
+void rafgl_gl_renderbuffer_storage(GLenum target, GLenum internalformat, GLsizei width, GLsizei height)
+{
+    GLint bound = 0;
+    rafgl_gpu_object_t *o;
+
+    glRenderbufferStorage(target, internalformat, width, height);
+
+    glGetIntegerv(GL_RENDERBUFFER_BINDING, &bound);
+    if((o = __rafgl_gpu_find(RAFGL_GPU_RENDERBUFFER, bound)) != NULL)
+        __rafgl_gpu_resize(o, (long long)width * height * __rafgl_gpu_texel_size(internalformat));
+}
+
+void rafgl_gpu_set_scope(const char *scope)
+{
+    __gpu_scope = scope;
+}
+
+rafgl_gpu_memory_t rafgl_gpu_memory_get(void)
+{
+    return __gpu_memory;
+}
+
+void rafgl_gpu_memory_log(void)
+{
+    int i, j, c;
+    char total[32], peak[32];
+
+    __rafgl_format_bytes(total, sizeof(total), __gpu_memory.total_bytes);
+    __rafgl_format_bytes(peak, sizeof(peak), __gpu_memory.peak_bytes);
+    rafgl_log(RAFGL_INFO, "[GPU memory] %s in %d objects, peak %s\n", total, __gpu_object_count, peak);
+
+    for(c = 0; c < RAFGL_GPU_CATEGORIES; c++)
+    {
+        if(__gpu_memory.objects[c] == 0) continue;
+        __rafgl_format_bytes(total, sizeof(total), __gpu_memory.bytes[c]);
+        rafgl_log(RAFGL_INFO, "    %-12s %4d objects %12s\n", __gpu_category_names[c], __gpu_memory.objects[c], total);
+    }
+
+    /* every scope and tag pair once, at the first object that has it */
+    for(i = 0; i < __gpu_object_count; i++)
+    {
+        rafgl_gpu_object_t *o = &__gpu_objects[i];
+        long long bytes = 0;
+        int count = 0;
+
+        for(j = 0; j < i; j++)
+        {
+            if(__gpu_objects[j].scope == o->scope && __gpu_objects[j].tag == o->tag) break;
+        }
+        if(j < i) continue;
+
+        for(j = i; j < __gpu_object_count; j++)
+        {
+            if(__gpu_objects[j].scope == o->scope && __gpu_objects[j].tag == o->tag)
+            {
+                bytes += __gpu_objects[j].bytes;
+                count++;
+            }
+        }
+
+        __rafgl_format_bytes(total, sizeof(total), bytes);
+        rafgl_log(RAFGL_INFO, "    %s%s%s: %d objects %s\n", o->scope ? o->scope : "", o->scope ? "/" : "", o->tag, count, total);
+    }
+}
+
+int rafgl_gpu_memory_report_leaks(void)
+{
+    int i, leaks = 0;
+    long long bytes = 0;
+    char size[32];
+
+    for(i = 0; i < __gpu_object_count; i++)
+    {
+        rafgl_gpu_object_t *o = &__gpu_objects[i];
+        if(o->state != __gpu_state || o->state == 0) continue;
+
+        __rafgl_format_bytes(size, sizeof(size), o->bytes);
+        rafgl_log(RAFGL_WARNING, "Leaked %s %u from [%s%s%s], %s\n", __gpu_category_names[o->category], o->id,
+                  o->scope ? o->scope : "", o->scope ? "/" : "", o->tag, size);
+        bytes += o->bytes;
+        leaks++;
+    }
+
+    if(leaks)
+    {
+        __rafgl_format_bytes(size, sizeof(size), bytes);
+        rafgl_log(RAFGL_WARNING, "%d GPU objects (%s) outlived the game state that made them\n", leaks, size);
+    }
+
+    return leaks;
+}
+
+static rafgl_render_counters_t __counters_current, __counters_frame, __counters_total;
+static rafgl_render_counters_t __counters_history[RAFGL_COUNTERS_HISTORY];
+static int __counters_count = 0, __counters_next = 0, __counters_frame_index = 0;
+/* same handoff as the profile export, update writes pending and publish moves it over */
+static char __counters_export_pending[256], __counters_export_request[256];
+
+static int __rafgl_gl_pixel_size(GLenum format, GLenum type)
+{
+    int components, size;
+
+    switch(format)
+    {
+        case GL_RED: case GL_DEPTH_COMPONENT: components = 1; break;
+        case GL_RG: components = 2; break;
+        case GL_RGB: case GL_BGR: components = 3; break;
+        default: components = 4; break;
+    }
+
+    switch(type)
+    {
+        case GL_UNSIGNED_BYTE: case GL_BYTE: size = 1; break;
+        case GL_UNSIGNED_SHORT: case GL_SHORT: case GL_HALF_FLOAT: size = 2; break;
+        default: size = 4; break;
+    }
+
+    return components * size;
+}
+
+void rafgl_gl_draw_arrays(GLenum mode, GLint first, GLsizei count)
+{
+    __counters_current.draw_calls++;
+    if(mode == GL_TRIANGLES)
+        __counters_current.triangles += count / 3;
+    else if(mode == GL_TRIANGLE_STRIP || mode == GL_TRIANGLE_FAN)
+        __counters_current.triangles += rafgl_max_m(count - 2, 0);
+    glDrawArrays(mode, first, count);
+}
+
+void rafgl_gl_clear(GLbitfield mask)
+{
+    __counters_current.clears++;
+    glClear(mask);
+}
+
+void rafgl_gl_use_program(GLuint program)
+{
+    __counters_current.state_changes++;
+    glUseProgram(program);
+}
+
+void rafgl_gl_bind_vertex_array(GLuint vao)
+{
+    __counters_current.state_changes++;
+    glBindVertexArray(vao);
+}
+
+void rafgl_gl_bind_framebuffer(GLenum target, GLuint framebuffer)
+{
+    __counters_current.state_changes++;
+    glBindFramebuffer(target, framebuffer);
+}
+
+void rafgl_gl_active_texture(GLenum unit)
+{
+    __counters_current.state_changes++;
+    glActiveTexture(unit);
+}
+
+void rafgl_gl_bind_texture(GLenum target, GLuint texture)
+{
+    __counters_current.state_changes++;
+    glBindTexture(target, texture);
+}
+
+void rafgl_gl_enable(GLenum capability)
+{
+    __counters_current.state_changes++;
+    glEnable(capability);
+}
+
+void rafgl_gl_disable(GLenum capability)
+{
+    __counters_current.state_changes++;
+    glDisable(capability);
+}
+
+void rafgl_gl_depth_mask(GLboolean flag)
+{
+    __counters_current.state_changes++;
+    glDepthMask(flag);
+}
+
+void rafgl_gl_generate_mipmap(GLenum target)
+{
+    __counters_current.mipmap_generations++;
+    glGenerateMipmap(target);
+    __rafgl_gpu_texture_mipmapped(target);
+}
+
+void rafgl_gl_uniform1i(GLint location, GLint v)
+{
+    __counters_current.uniform_uploads++;
+    glUniform1i(location, v);
+}
+
+void rafgl_gl_uniform1f(GLint location, GLfloat v)
+{
+    __counters_current.uniform_uploads++;
+    glUniform1f(location, v);
+}
+
+void rafgl_gl_uniform3f(GLint location, GLfloat x, GLfloat y, GLfloat z)
+{
+    __counters_current.uniform_uploads++;
+    glUniform3f(location, x, y, z);
+}
+
+void rafgl_gl_uniform3fv(GLint location, GLsizei count, const GLfloat *v)
+{
+    __counters_current.uniform_uploads++;
+    glUniform3fv(location, count, v);
+}
+
+void rafgl_gl_uniform_matrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat *m)
+{
+    __counters_current.uniform_uploads++;
+    glUniformMatrix4fv(location, count, transpose, m);
+}
+
+void rafgl_gl_buffer_data(GLenum target, GLsizeiptr size, const void *data, GLenum usage)
+{
+    if(data != NULL) __counters_current.bytes_uploaded += size;
+    glBufferData(target, size, data, usage);
+    __rafgl_gpu_buffer_storage(target, size);
+}
+
+void rafgl_gl_tex_image_2d(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLenum format, GLenum type, const void *data)
+{
+    if(data != NULL) __counters_current.bytes_uploaded += (long long)width * height * __rafgl_gl_pixel_size(format, type);
+    glTexImage2D(target, level, internalformat, width, height, 0, format, type, data);
+    __rafgl_gpu_texture_storage(target, level, internalformat, width, height, 1);
+}
+
+void rafgl_gl_tex_image_3d(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, const void *data)
+{
+    if(data != NULL) __counters_current.bytes_uploaded += (long long)width * height * depth * __rafgl_gl_pixel_size(format, type);
+    glTexImage3D(target, level, internalformat, width, height, depth, 0, format, type, data);
+    __rafgl_gpu_texture_storage(target, level, internalformat, width, height, depth);
+}
+
+void rafgl_gl_bind_image_texture(GLuint unit, GLuint texture, GLint level, GLboolean layered, GLint layer, GLenum access, GLenum format)
+{
+    __counters_current.state_changes++;
+    __gl_bind_image_texture(unit, texture, level, layered, layer, access, format);
+}
+
+void rafgl_gl_memory_barrier(GLbitfield barriers)
+{
+    __counters_current.state_changes++;
+    __gl_memory_barrier(barriers);
+}
 
-    for(yi = fuc; yi < fdc; yi++)
+/* applies op(a, b) to every field of a */
+#define __RAFGL_COUNTERS_EACH(a, b, op) \
+    do { \
+        (a).draw_calls = op((a).draw_calls, (b).draw_calls); \
+        (a).state_changes = op((a).state_changes, (b).state_changes); \
+        (a).uniform_uploads = op((a).uniform_uploads, (b).uniform_uploads); \
+        (a).clears = op((a).clears, (b).clears); \
+        (a).mipmap_generations = op((a).mipmap_generations, (b).mipmap_generations); \
+        (a).triangles = op((a).triangles, (b).triangles); \
+        (a).bytes_uploaded = op((a).bytes_uploaded, (b).bytes_uploaded); \
+    } while(0)
+#define __RAFGL_COUNTERS_ADD(x, y) ((x) + (y))
+
+rafgl_render_counters_t rafgl_counters_get_frame(void)
+{
+    return __counters_frame;
+}
+
+rafgl_render_counters_t rafgl_counters_get_total(void)
+{
+    return __counters_total;
+}
+
+rafgl_render_counters_stats_t rafgl_counters_get_stats(void)
+{
+    rafgl_render_counters_stats_t st;
+    int i, n = __counters_count;
+
+    memset(&st, 0, sizeof(st));
+    st.frames = n;
+    if(n == 0) return st;
+
+    st.min = st.max = __counters_history[0];
+    for(i = 0; i < n; i++)
     {
-        for(xi = flc; xi < frc; xi++)
-        {
-            sampled = pixel_at_pm(from, xi - fl, yi - fu);
-            if(sampled.rgba != RAFGL_COLOUR_KEY.rgba)
-            {
-                pixel_at_pm(to, xi, yi) = sampled;
-            }
-        }
+        __RAFGL_COUNTERS_EACH(st.min, __counters_history[i], rafgl_min_m);
+        __RAFGL_COUNTERS_EACH(st.max, __counters_history[i], rafgl_max_m);
+        __RAFGL_COUNTERS_EACH(st.avg, __counters_history[i], __RAFGL_COUNTERS_ADD);
     }
 
+#define __RAFGL_COUNTERS_DIV(x, y) (((x) + (y) / 2) / (y))
+    __RAFGL_COUNTERS_EACH(st.avg, ((rafgl_render_counters_t){n, n, n, n, n, n, n}), __RAFGL_COUNTERS_DIV);
+#undef __RAFGL_COUNTERS_DIV
 
+    return st;
 }
 
-/* Cohen-Sutherland line clipping algorithm constants */
-static const int __cohsuth_INSIDE = 0;     /* 0000 */
-static const int __cohsuth_LEFT   = 1;     /* 0001 */
-static const int __cohsuth_RIGHT  = 2;     /* 0010 */
-static const int __cohsuth_BOTTOM = 4;     /* 0100 */
-static const int __cohsuth_TOP    = 8;     /* 1000 */
+void rafgl_counters_reset(void)
+{
+    __counters_count = 0;
+    __counters_next = 0;
+}
 
-static int __compute_outcode(int x, int y, rafgl_raster_t *raster)
+void rafgl_counters_request_export(const char *path)
 {
-    int xmin = 0, ymin = 0, xmax = raster->width - 1, ymax = raster->height - 1;
-    int code = __cohsuth_INSIDE;
-    if(x < xmin)
+    strncpy(__counters_export_pending, path, sizeof(__counters_export_pending) - 1);
+}
+
+/* main thread, while update isn't running */
+static void __rafgl_counters_publish_export(void)
+{
+    if(!__counters_export_pending[0]) return;
+    strcpy(__counters_export_request, __counters_export_pending);
+    __counters_export_pending[0] = '\0';
+}
+
+void rafgl_counters_frame_end(void)
+{
+    __counters_frame = __counters_current;
+    __RAFGL_COUNTERS_EACH(__counters_total, __counters_current, __RAFGL_COUNTERS_ADD);
+
+    __counters_history[__counters_next] = __counters_current;
+    __counters_next = (__counters_next + 1) % RAFGL_COUNTERS_HISTORY;
+    if(__counters_count < RAFGL_COUNTERS_HISTORY) __counters_count++;
+    __counters_frame_index++;
+
+    memset(&__counters_current, 0, sizeof(__counters_current));
+
+    if(__counters_export_request[0])
     {
-        code |= __cohsuth_LEFT;
+        if(rafgl_counters_export_csv(__counters_export_request) == 0)
+            rafgl_log(RAFGL_INFO, "Exported render counters to [%s]\n", __counters_export_request);
+        __counters_export_request[0] = '\0';
     }
-    else if(x > xmax)
+}
+
+int rafgl_counters_draw(rafgl_raster_t *raster, int x, int y, uint32_t colour, int font_size)
+{
+    rafgl_render_counters_stats_t st = rafgl_counters_get_stats();
+    rafgl_render_counters_t *f = &__counters_frame;
+    char text[512], frame_bytes[32], max_bytes[32];
+    int i, lines = 1;
+
+    __rafgl_format_bytes(frame_bytes, sizeof(frame_bytes), f->bytes_uploaded);
+    __rafgl_format_bytes(max_bytes, sizeof(max_bytes), st.max.bytes_uploaded);
+
+    snprintf(text, sizeof(text),
+             "frame %d, %d in history\n"
+             "draws %d avg %d max %d\n"
+             "tris %lld avg %lld max %lld\n"
+             "state %d avg %d max %d\n"
+             "uniforms %d avg %d max %d\n"
+             "clears %d mipmaps %d\n"
+             "upload %s max %s",
+             __counters_frame_index, st.frames,
+             f->draw_calls, st.avg.draw_calls, st.max.draw_calls,
+             f->triangles, st.avg.triangles, st.max.triangles,
+             f->state_changes, st.avg.state_changes, st.max.state_changes,
+             f->uniform_uploads, st.avg.uniform_uploads, st.max.uniform_uploads,
+             f->clears, f->mipmap_generations,
+             frame_bytes, max_bytes);
+
+    rafgl_raster_draw_string(raster, text, x, y, colour, font_size);
+    for(i = 0; text[i] != '\0'; i++)
+        if(text[i] == '\n') lines++;
+    return lines;
+}
+
+int rafgl_counters_export_csv(const char *path)
+{
+    FILE *f = fopen(path, "w");
+    int i, first = __counters_frame_index - __counters_count;
+    rafgl_render_counters_t *c;
+
+    if(f == NULL)
     {
-        code |= __cohsuth_RIGHT;
+        rafgl_log(RAFGL_ERROR, "Failed to open [%s] for the render counters!\n", path);
+        return -1;
     }
 
-    if(y < ymin)
+    fprintf(f, "frame,draw_calls,triangles,state_changes,uniform_uploads,clears,mipmap_generations,bytes_uploaded\n");
+    for(i = 0; i < __counters_count; i++)
     {
-        code |= __cohsuth_BOTTOM;
+        c = &__counters_history[(__counters_next - __counters_count + i + RAFGL_COUNTERS_HISTORY) % RAFGL_COUNTERS_HISTORY];
+        fprintf(f, "%d,%d,%lld,%d,%d,%d,%d,%lld\n", first + i, c->draw_calls, c->triangles, c->state_changes, c->uniform_uploads,
+                c->clears, c->mipmap_generations, c->bytes_uploaded);
     }
-    else if(y > ymax)
+
+    fclose(f);
+    return 0;
+}
+
+static void __rafgl_counters_log(void)
+{
+    rafgl_render_counters_stats_t st = rafgl_counters_get_stats();
+
+    if(st.frames == 0) return;
+    rafgl_log(RAFGL_INFO, "[counters] per frame: %d draws, %lld triangles, %d state changes, %d uniforms (max %d draws, %lld uploaded bytes)\n",
+              st.avg.draw_calls, st.avg.triangles, st.avg.state_changes, st.avg.uniform_uploads, st.max.draw_calls, st.max.bytes_uploaded);
+}
+
+static int __cursor_pos_requested = 0, __cursor_mode_requested = -1;
+static double __cursor_requested_x, __cursor_requested_y;
+
+void rafgl_cursor_set_pos(double x, double y)
+{
+    __cursor_requested_x = x;
+    __cursor_requested_y = y;
+    __cursor_pos_requested = 1;
+}
+
+void rafgl_cursor_set_mode(int mode)
+{
+    __cursor_mode_requested = mode;
+}
+
+/* called on the main thread once update is done, GLFW only allows cursor changes from there */
+static void __rafgl_game_publish(rafgl_game_t *game)
+{
+    if(__cursor_mode_requested >= 0)
     {
-        code |= __cohsuth_TOP;
+        __rafgl_window_set_cursor_mode(__cursor_mode_requested);
+        __cursor_mode_requested = -1;
+    }
+    if(__cursor_pos_requested)
+    {
+        __rafgl_window_set_cursor_pos(__cursor_requested_x, __cursor_requested_y);
+        __cursor_pos_requested = 0;
+    }
+    if(__rafgl_snapshot != NULL)
+    {
+        rafgl_snapshot_swap(__rafgl_snapshot);
     }
+    __redraw_published = __redraw_requested;
+    __redraw_requested = 0;
 
-    return code;
+    __published_input_time = __polled_input_time;
+    __polled_input_time = 0.0;
+
+    __rafgl_profile_publish_export();
+    __rafgl_counters_publish_export();
 }
 
-void rafgl_raster_draw_line(rafgl_raster_t *raster, int x0, int y0, int x1, int y1, uint32_t colour)
+typedef struct _rafgl_sim_thread_t
 {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int pending, quit;
 
-    int xmin = 0, ymin = 0, xmax = raster->width - 1, ymax = raster->height - 1;
-    int outcode0 = __compute_outcode(x0, y0, raster);
-    int outcode1 = __compute_outcode(x1, y1, raster);
-    int accept = 0;
-    int xnew, ynew;
-    int outside_outcode;
+    rafgl_game_state_t *state;
+    GLFWwindow *window;
+    float elapsed;
+    rafgl_game_data_t *game_data;
+    void *args;
+} rafgl_sim_thread_t;
+
+static void* __rafgl_sim_thread_main(void *p)
+{
+    rafgl_sim_thread_t *sim = p;
 
+    pthread_mutex_lock(&sim->lock);
     while(1)
     {
-
-        if(!(outcode0 | outcode1))
-        {
-            /* trivijalno prihvatanje */
-            accept = 1;
-            break;
-        }
-        else if(outcode0 & outcode1)
+        while(!sim->pending && !sim->quit)
         {
-            /* trivijalno odbacivanje */
-            break;
+            pthread_cond_wait(&sim->cond, &sim->lock);
         }
-        else
-        {
-            outside_outcode = outcode0 ? outcode0 : outcode1;
-            if(outside_outcode & __cohsuth_TOP)
-            {
-                xnew = x0 + (x1 - x0) * (ymax - y0) / (y1 - y0);
-                ynew = ymax;
-            }
-            else if(outside_outcode & __cohsuth_BOTTOM)
-            {
-                xnew = x0 + (x1 - x0) * (ymin - y0) / (y1 - y0);
-				ynew = ymin;
-            }
-            else if (outside_outcode & __cohsuth_RIGHT)
-            {
-				ynew = y0 + (y1 - y0) * (xmax - x0) / (x1 - x0);
-				xnew = xmax;
-			}
-			else if (outside_outcode & __cohsuth_LEFT)
-            {
-				ynew = y0 + (y1 - y0) * (xmin - x0) / (x1 - x0);
-				xnew = xmin;
-			}
+        if(sim->quit) break;
 
-			if(outside_outcode == outcode0)
-            {
-                x0 = xnew;
-                y0 = ynew;
-                outcode0 = __compute_outcode(x0, y0, raster);
-            }
-            else
-            {
-                x1 = xnew;
-                y1 = ynew;
-                outcode1 = __compute_outcode(x1, y1, raster);
-            }
-        }
+        pthread_mutex_unlock(&sim->lock);
+        sim->state->update(sim->window, sim->elapsed, sim->game_data, sim->args);
+        pthread_mutex_lock(&sim->lock);
+
+        sim->pending = 0;
+        pthread_cond_broadcast(&sim->cond);
+    }
+    pthread_mutex_unlock(&sim->lock);
+
+    return NULL;
+}
 
+static void __rafgl_sim_kick(rafgl_sim_thread_t *sim, rafgl_game_state_t *state, float elapsed, void *args)
+{
+    pthread_mutex_lock(&sim->lock);
+    sim->state = state;
+    sim->elapsed = elapsed;
+    sim->args = args;
+    sim->pending = 1;
+    pthread_cond_broadcast(&sim->cond);
+    pthread_mutex_unlock(&sim->lock);
+}
 
+static void __rafgl_sim_wait(rafgl_sim_thread_t *sim)
+{
+    pthread_mutex_lock(&sim->lock);
+    while(sim->pending)
+    {
+        pthread_cond_wait(&sim->cond, &sim->lock);
     }
+    pthread_mutex_unlock(&sim->lock);
+}
 
+static int __frame_count = 0;
+static double __last_frame, __last_fps_frame;
 
-    if(!accept)
-        return;
+static float __rafgl_frame_limit = 0.0f, __rafgl_delta_smoothing = 0.0f, __rafgl_fixed_delta = 0.0f;
+static double __next_frame_deadline;
+static float __smoothed_delta;
+static double __frame_time_sum, __frame_time_sq_sum, __frame_time_min, __frame_time_max;
+static rafgl_frame_stats_t __frame_stats;
 
-    x0 = rafgl_clampi(x0, 0, xmax);
-    y0 = rafgl_clampi(y0, 0, ymax);
-    x1 = rafgl_clampi(x1, 0, xmax);
-    y1 = rafgl_clampi(y1, 0, ymax);
+void rafgl_game_set_frame_limit(float fps)
+{
+    __rafgl_frame_limit = fps;
+    __next_frame_deadline = 0.0;
+}
 
+void rafgl_game_set_delta_smoothing(float smoothing)
+{
+    __rafgl_delta_smoothing = rafgl_clampf(smoothing, 0.0f, 0.99f);
+}
 
-    /* printf("---\nx0: %d\ny0: %d\nx1: %d\ny1: %d\n", x0, y0, x1, y1); */
+void rafgl_game_set_fixed_delta(float seconds)
+{
+    __rafgl_fixed_delta = seconds;
+}
 
-    int dx =  rafgl_abs_m((x1-x0)), sx = x0<x1 ? 1 : -1;
-    int dy = -rafgl_abs_m((y1-y0)), sy = y0<y1 ? 1 : -1;
-    int err = dx+dy, e2; /* error value e_xy */
+rafgl_frame_stats_t rafgl_game_get_frame_stats(void)
+{
+    return __frame_stats;
+}
 
-    while(1)
+static void __rafgl_sleep(double seconds)
+{
+#ifdef _WIN32
+    Sleep((DWORD)(seconds * 1000.0));
+#else
+    struct timespec ts;
+    ts.tv_sec = (time_t) seconds;
+    ts.tv_nsec = (long)((seconds - ts.tv_sec) * 1e9);
+    nanosleep(&ts, NULL);
+#endif // _WIN32
+}
+
+/* OS sleeps overshoot by up to a scheduler tick, so the last stretch before the deadline is spun */
+#define RAFGL_FRAME_LIMIT_SPIN 0.002
+
+static void __rafgl_game_limit_frame_rate(void)
+{
+    if(__rafgl_frame_limit <= 0.0f) return;
+
+    double period = 1.0 / __rafgl_frame_limit;
+    double now = rafgl_time();
+
+    __next_frame_deadline += period;
+    /* fell more than a frame behind (or just started), don't try to catch up */
+    if(__next_frame_deadline < now - period || __next_frame_deadline > now + period)
     {
-        pixel_at_pm(raster, x0, y0).rgba = colour;
-        if (x0==x1 && y0==y1) break;
-        e2 = 2*err;
-        if (e2 >= dy) { err += dy; x0 += sx; } /* e_xy+e_x > 0 */
-        if (e2 <= dx) { err += dx; y0 += sy; } /* e_xy+e_y < 0 */
+        __next_frame_deadline = now + period;
     }
 
+    if(__next_frame_deadline - now > RAFGL_FRAME_LIMIT_SPIN)
+    {
+        __rafgl_sleep(__next_frame_deadline - now - RAFGL_FRAME_LIMIT_SPIN);
+    }
+    while(rafgl_time() < __next_frame_deadline);
 }
 
-/* DOES NOT DO CLIPPING! */
-void rafgl_raster_draw_circle(rafgl_raster_t *raster, int cx, int cy, int r, uint32_t colour)
+static void __rafgl_game_reset_frame_time(void)
 {
-    int x = -r, y = 0, err = 2-2*r; /* II. Quadrant */
-    do {
-        pixel_at_pm(raster, cx-x, cy+y).rgba = colour; /*   I. Quadrant */
-        pixel_at_pm(raster, cx-y, cy-x).rgba = colour; /*  II. Quadrant */
-        pixel_at_pm(raster, cx+x, cy-y).rgba = colour; /* III. Quadrant */
-        pixel_at_pm(raster, cx+y, cy+x).rgba = colour; /*  IV. Quadrant */
-        r = err;
-        if (r <= y) err += ++y*2+1;           /* e_xy+e_y < 0 */
-        if (r > x || err > y) err += ++x*2+1; /* e_xy+e_x > 0 or no 2nd y-step */
-    } while (x < 0);
+    __frame_count = 0;
+    __frame_time_sum = __frame_time_sq_sum = __frame_time_max = 0.0;
+    __frame_time_min = 1e9;
+    __smoothed_delta = 0.0f;
+    __last_fps_frame = __last_frame = rafgl_time();
 }
 
-void rafgl_raster_draw_rectangle(rafgl_raster_t *raster, int x0, int y0, int w, int h, uint32_t colour)
+/* keys pressed during the last drained frame, so only those have to be cleared */
+static int __pressed_keys[RAFGL_INPUT_EVENTS], __pressed_key_count = 0;
+/* key events applied by the last drain, which is what a recording stores */
+static rafgl_input_event_t __frame_key_events[RAFGL_INPUT_EVENTS];
+static int __frame_key_event_count = 0;
+
+/* a recording is the magic followed by one record per frame: float delta_time, double cursor x and y,
+   uint8 mouse buttons (lmb 1, rmb 2, mmb 4), uint16 key event count and then uint16 key, uint8 action per event */
+#define RAFGL_INPUT_RECORDING_MAGIC "RAFGLIN1"
+
+static FILE *__record_file = NULL, *__replay_file = NULL;
+
+int rafgl_input_record(const char *path)
 {
-    rafgl_raster_draw_line(raster, x0, y0, x0 + w, y0, colour);
-    rafgl_raster_draw_line(raster, x0, y0 + h, x0 + w, y0 + h, colour);
-    rafgl_raster_draw_line(raster, x0, y0, x0, y0 + h, colour);
-    rafgl_raster_draw_line(raster, x0 + w, y0, x0 + w, y0 + h, colour);
+    __record_file = fopen(path, "wb");
+    if(__record_file == NULL)
+    {
+        rafgl_log(RAFGL_ERROR, "Failed to open [%s] for the input recording!\n", path);
+        return -1;
+    }
+    fwrite(RAFGL_INPUT_RECORDING_MAGIC, 1, 8, __record_file);
+    return 0;
 }
 
-void rafgl_raster_bilinear_upsample(rafgl_raster_t *to, rafgl_raster_t *from)
+int rafgl_input_replay(const char *path)
 {
-    int x, y;
-    int w = to->width, h = to->height;
-    float xn, yn;
+    char magic[8];
+
+    __replay_file = fopen(path, "rb");
+    if(__replay_file == NULL)
+    {
+        rafgl_log(RAFGL_ERROR, "Failed to open the input recording [%s]!\n", path);
+        return -1;
+    }
+    if(fread(magic, 1, 8, __replay_file) != 8 || memcmp(magic, RAFGL_INPUT_RECORDING_MAGIC, 8))
+    {
+        rafgl_log(RAFGL_ERROR, "[%s] is not an input recording!\n", path);
+        fclose(__replay_file);
+        __replay_file = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+/* applies the queued events in order, the only place the key arrays are written */
+static void __rafgl_input_drain(void)
+{
+    int i;
+
+    for(i = 0; i < __pressed_key_count; i++)
+    {
+        __keys_pressed[__pressed_keys[i]] = 0;
+    }
+    __pressed_key_count = 0;
+    __frame_key_event_count = 0;
+
+    __polled_input_time = __rafgl_latency_tracking && __input_event_count ? __input_events[__input_event_head].time : 0.0;
+
+    while(__input_event_count)
+    {
+        rafgl_input_event_t *e = &__input_events[__input_event_head];
+        __input_event_head = (__input_event_head + 1) % RAFGL_INPUT_EVENTS;
+        __input_event_count--;
+
+        if(e->type != RAFGL_INPUT_KEY || e->key < 0 || e->key >= RAFGL_KEY_SLOTS) continue;
+
+        if(__keys_down[e->key] == 0 && e->action != 0)
+        {
+            __keys_pressed[e->key] = 1;
+            __pressed_keys[__pressed_key_count++] = e->key;
+        }
+        else __keys_pressed[e->key] = 0;
+        __keys_down[e->key] = e->action;
+
+        __frame_key_events[__frame_key_event_count++] = *e;
+    }
+}
+
+static void __rafgl_input_record_frame(const rafgl_game_data_t *game_data, float elapsed)
+{
+    uint8_t buttons = (game_data->is_lmb_down ? 1 : 0) | (game_data->is_rmb_down ? 2 : 0) | (game_data->is_mmb_down ? 4 : 0);
+    uint16_t count = __frame_key_event_count, key;
+    uint8_t action;
+    int i;
+
+    fwrite(&elapsed, sizeof(float), 1, __record_file);
+    fwrite(&game_data->mouse_pos_x, sizeof(double), 1, __record_file);
+    fwrite(&game_data->mouse_pos_y, sizeof(double), 1, __record_file);
+    fwrite(&buttons, sizeof(uint8_t), 1, __record_file);
+    fwrite(&count, sizeof(uint16_t), 1, __record_file);
+    for(i = 0; i < count; i++)
+    {
+        key = __frame_key_events[i].key;
+        action = __frame_key_events[i].action;
+        fwrite(&key, sizeof(uint16_t), 1, __record_file);
+        fwrite(&action, sizeof(uint8_t), 1, __record_file);
+    }
+}
+
+/* live input is thrown away and the recorded frame takes its place */
+static void __rafgl_input_replay_frame(rafgl_game_data_t *game_data, float *elapsed)
+{
+    uint8_t buttons, action;
+    uint16_t count, key;
+    int i, ok;
+
+    __input_event_count = 0;
+
+    ok = fread(elapsed, sizeof(float), 1, __replay_file) == 1;
+    ok = ok && fread(&game_data->mouse_pos_x, sizeof(double), 1, __replay_file) == 1;
+    ok = ok && fread(&game_data->mouse_pos_y, sizeof(double), 1, __replay_file) == 1;
+    ok = ok && fread(&buttons, sizeof(uint8_t), 1, __replay_file) == 1;
+    ok = ok && fread(&count, sizeof(uint16_t), 1, __replay_file) == 1;
+    for(i = 0; ok && i < count; i++)
+    {
+        ok = fread(&key, sizeof(uint16_t), 1, __replay_file) == 1 && fread(&action, sizeof(uint8_t), 1, __replay_file) == 1;
+        if(ok) __rafgl_input_push(RAFGL_INPUT_KEY, key, action);
+    }
+
+    if(!ok)
+    {
+        rafgl_log(RAFGL_INFO, "Input replay finished\n");
+        fclose(__replay_file);
+        __replay_file = NULL;
+        __input_event_count = 0;
+        *elapsed = 0.0f;
+        rafgl_window_request_close();
+        return;
+    }
+
+    game_data->is_lmb_down = (buttons & 1) != 0;
+    game_data->is_rmb_down = (buttons & 2) != 0;
+    game_data->is_mmb_down = (buttons & 4) != 0;
+}
+
+/* input is only touched here, and never while the simulation thread is running update */
+static float __rafgl_game_poll(rafgl_game_t *game, rafgl_game_data_t *game_data)
+{
+    static int fbwlast = 0, fbhlast = 0;
+    double current_frame;
+    float elapsed;
+    int fbwidth, fbheight;
+
+    __rafgl_window_poll_events(__rafgl_render_on_demand && !__last_frame_drawn);
+
+    current_frame = rafgl_time();
+
+    elapsed = current_frame - __last_frame;
+    __last_frame = current_frame;
+
+    ++__frame_count;
+    __frame_time_sum += elapsed;
+    __frame_time_sq_sum += elapsed * elapsed;
+    __frame_time_min = rafgl_min_m(__frame_time_min, elapsed);
+    __frame_time_max = rafgl_max_m(__frame_time_max, elapsed);
 
-    for(y = 0; y < h; y++)
+    if(current_frame - __last_fps_frame >= 2.0f)
     {
-        yn = ((float)y) / h;
-        for(x = 0; x < w; x++)
+        double mean = __frame_time_sum / __frame_count;
+        double variance = __frame_time_sq_sum / __frame_count - mean * mean;
+
+        __frame_stats.fps = __frame_count / (current_frame - __last_fps_frame);
+        __frame_stats.frame_ms_avg = mean * 1000.0;
+        __frame_stats.frame_ms_min = __frame_time_min * 1000.0;
+        __frame_stats.frame_ms_max = __frame_time_max * 1000.0;
+        __frame_stats.jitter_ms = sqrt(rafgl_max_m(variance, 0.0)) * 1000.0;
+
+        if(__rafgl_log_fps)
         {
-            xn = ((float)x) / w;
-            pixel_at_pm(to, x, y) = rafgl_bilinear_sample(from, xn, yn);
+            rafgl_log(RAFGL_INFO, "[FPS = %.2f] frame %.2f ms (min %.2f, max %.2f, jitter %.2f)\n", __frame_stats.fps, __frame_stats.frame_ms_avg, __frame_stats.frame_ms_min, __frame_stats.frame_ms_max, __frame_stats.jitter_ms);
+            __rafgl_latency_log();
+            rafgl_profile_log();
+            __rafgl_counters_log();
+#ifdef RAFGL_TRACK_ALLOCATIONS
+            rafgl_alloc_stats_t heap = rafgl_alloc_get_stats(RAFGL_ALLOC_TAGS);
+            rafgl_log(RAFGL_INFO, "[heap] %lld live bytes in %lld blocks, peak %lld, %lld allocations last frame\n", heap.live_bytes,
+                      heap.live_blocks, heap.peak_bytes, heap.frame_calls);
+#endif // RAFGL_TRACK_ALLOCATIONS
         }
+        __frame_count = 0;
+        __frame_time_sum = __frame_time_sq_sum = __frame_time_max = 0.0;
+        __frame_time_min = 1e9;
+        __last_fps_frame = current_frame;
     }
-}
 
+    /* hitches (window drags, breakpoints) would otherwise be fed straight into the simulation */
+    if(elapsed > 0.25f) elapsed = 0.25f;
 
-void rafgl_game_add_game_state(rafgl_game_t *game, void (*init)(GLFWwindow *window, void *args), void (*update)(GLFWwindow *window, float delta_time, rafgl_game_data_t *game_data, void *args), void (*render)(GLFWwindow *window, void *args), void (*cleanup)(GLFWwindow *window, void *args))
-{
-    rafgl_game_state_t state;
-    state.init = init;
-    state.update = update;
-    state.render = render;
-    state.cleanup = cleanup;
-    state.id = 0;
+    if(__rafgl_delta_smoothing > 0.0f)
+    {
+        if(__smoothed_delta <= 0.0f) __smoothed_delta = elapsed;
+        __smoothed_delta = __rafgl_delta_smoothing * __smoothed_delta + (1.0f - __rafgl_delta_smoothing) * elapsed;
+        elapsed = __smoothed_delta;
+    }
 
-    rafgl_list_append(&game->game_states, &state);
-}
+    if(__rafgl_fixed_delta > 0.0f)
+    {
+        elapsed = __rafgl_fixed_delta;
+    }
 
-static int __rafgl_log_fps = 0;
-static int __game_state_change_request = -1;
-static void *__game_state_change_request_args = NULL;
 
-void rafgl_log_fps(int b)
+    __rafgl_window_framebuffer_size(&fbwidth, &fbheight);
+    if(fbwlast != fbwidth || fbhlast != fbheight)
+    {
+        glViewport(0, 0, fbwidth, fbheight);
+        __redraw_forced = 1;
+    }
+    fbwlast = fbwidth;
+    fbhlast = fbheight;
+
+    game_data->raster_width = fbwidth;
+    game_data->raster_height = fbheight;
+
+    __rafgl_window_cursor_pos(&game_data->mouse_pos_x, &game_data->mouse_pos_y);
+
+    game_data->is_lmb_down = __rafgl_window_mouse_button(GLFW_MOUSE_BUTTON_LEFT);
+    game_data->is_rmb_down = __rafgl_window_mouse_button(GLFW_MOUSE_BUTTON_RIGHT);
+    game_data->is_mmb_down = __rafgl_window_mouse_button(GLFW_MOUSE_BUTTON_MIDDLE);
+
+    if(__replay_file != NULL)
+    {
+        __rafgl_input_replay_frame(game_data, &elapsed);
+    }
+
+    __rafgl_input_drain();
+
+    if(__record_file != NULL)
+    {
+        __rafgl_input_record_frame(game_data, elapsed);
+    }
+
+    return elapsed;
+}
+
+/* GPU objects are attributed to the state whose init made them, so its cleanup can be checked for leaks */
+static void __rafgl_game_state_init(rafgl_game_t *game, rafgl_game_state_t *state, void *args)
 {
-    __rafgl_log_fps = b;
+    __gpu_state++;
+    state->init(game->window, args, __window_width, __window_height);
+    rafgl_gpu_set_scope(NULL);
+    rafgl_gpu_memory_log();
 }
 
-void rafgl_game_request_state_change(int state_index, void *args)
+static void __rafgl_game_state_cleanup(rafgl_game_t *game, rafgl_game_state_t *state, void *args)
 {
-    __game_state_change_request = state_index;
-    __game_state_change_request_args = args;
+    state->cleanup(game->window, args);
+    rafgl_gpu_memory_report_leaks();
 }
 
 void rafgl_game_start(rafgl_game_t *game, void *_args)
 {
-    int frame_count = 0;
     void *args = _args;
     rafgl_game_state_t *current_state = rafgl_list_get(&game->game_states, 0);
     int current_game_state_index = 0, i;
@@ -992,66 +3936,83 @@ void rafgl_game_start(rafgl_game_t *game, void *_args)
     game_data.keys_down = __keys_down;
     game_data.keys_pressed = __keys_pressed;
 
-    current_state->init(game->window, args, __window_width, __window_height);
-
+    __rafgl_game_state_init(game, current_state, args);
+    __rafgl_game_reset_frame_time();
 
-    double current_frame, last_frame;
     float elapsed;
+    int state_frame = 0;
 
-    double last_fps_frame;
-
-    last_fps_frame = last_frame = glfwGetTime();
-
-    int fbwidth, fbheight, fbwlast = 0, fbhlast = 0;
+    /* in pipelined mode update for frame N + 1 runs here while frame N is rendered, the first frame has to be primed */
+    rafgl_sim_thread_t sim;
+    int pipelined = __rafgl_pipelined, primed = 0;
 
-    while(!glfwWindowShouldClose(game->window))
+    if(pipelined)
     {
-        for(i = 0; i < 400; i++)
+        memset(&sim, 0, sizeof(sim));
+        sim.window = game->window;
+        sim.game_data = &game_data;
+        pthread_mutex_init(&sim.lock, NULL);
+        pthread_cond_init(&sim.cond, NULL);
+        if(pthread_create(&sim.thread, NULL, __rafgl_sim_thread_main, &sim))
         {
-            __keys_pressed[i] = 0;
+            rafgl_log(RAFGL_WARNING, "Failed to start the simulation thread, running sequentially!\n");
+            pthread_cond_destroy(&sim.cond);
+            pthread_mutex_destroy(&sim.lock);
+            pipelined = 0;
         }
-        glfwPollEvents();
-
-        current_frame = glfwGetTime();
+    }
 
-        ++frame_count;
-        if(current_frame - last_fps_frame >= 2.0f)
+    while(!__rafgl_window_should_close())
+    {
+        if(pipelined && !primed)
         {
-            if(__rafgl_log_fps)
-            {
-                rafgl_log(RAFGL_INFO, "[FPS = %.2f]\n", frame_count / 2.0f);
-            }
-            frame_count = 0;
-            last_fps_frame = current_frame;
+            elapsed = __rafgl_game_poll(game, &game_data);
+            current_state->update(game->window, elapsed, &game_data, args);
+            __rafgl_game_publish(game);
+            primed = 1;
         }
 
-        elapsed = current_frame - last_frame;
-        last_frame = current_frame;
+        elapsed = __rafgl_game_poll(game, &game_data);
 
-
-        glfwGetFramebufferSize(game->window, &fbwidth, &fbheight);
-        if(fbwlast != fbwidth || fbhlast != fbheight)
+        if(pipelined)
         {
-            glViewport(0, 0, fbwidth, fbheight);
+            __rafgl_sim_kick(&sim, current_state, elapsed, args);
+        }
+        else
+        {
+            current_state->update(game->window, elapsed, &game_data, args);
+            __rafgl_game_publish(game);
         }
-        fbwlast = fbwidth;
-        fbhlast = fbheight;
-
-        game_data.raster_width = fbwidth;
-        game_data.raster_height = fbheight;
 
-        glfwGetCursorPos(game->window, &game_data.mouse_pos_x, &game_data.mouse_pos_y);
+        __last_frame_drawn = !__rafgl_render_on_demand || __redraw_published || __redraw_forced;
+        if(__last_frame_drawn)
+        {
+            __redraw_forced = 0;
 
-        game_data.is_lmb_down = glfwGetMouseButton(game->window, GLFW_MOUSE_BUTTON_LEFT);
-        game_data.is_rmb_down = glfwGetMouseButton(game->window, GLFW_MOUSE_BUTTON_RIGHT);
-        game_data.is_mmb_down = glfwGetMouseButton(game->window, GLFW_MOUSE_BUTTON_MIDDLE);
+            __rendered_input_time = __published_input_time;
+            __published_input_time = 0.0;
 
-        current_state->update(game->window, elapsed, &game_data, args);
+            long long render_calls = __alloc_thread_calls, render_bytes = __alloc_thread_bytes;
+            current_state->render(game->window, args);
+            __rafgl_alloc_check_render_frame(render_calls, render_bytes, state_frame++);
 
+            RAFGL_PROFILE_SCOPE("swap")
+            {
+                __rafgl_window_swap();
+            }
+            __rafgl_latency_frame_presented();
+            rafgl_profile_frame_end();
+            rafgl_counters_frame_end();
+            rafgl_alloc_frame_end();
 
-        current_state->render(game->window, args);
+            __rafgl_game_limit_frame_rate();
+        }
 
-        glfwSwapBuffers(game->window);
+        if(pipelined)
+        {
+            __rafgl_sim_wait(&sim);
+            __rafgl_game_publish(game);
+        }
 
         if(__game_state_change_request == current_game_state_index)
         {
@@ -1062,7 +4023,7 @@ void rafgl_game_start(rafgl_game_t *game, void *_args)
         if(__game_state_change_request >= 0)
         {
             rafgl_log(RAFGL_INFO, "Changigng state!\n");
-            current_state->cleanup(game->window, args);
+            __rafgl_game_state_cleanup(game, current_state, args);
 
             args = __game_state_change_request_args;
             __game_state_change_request_args = NULL;
@@ -1072,16 +4033,46 @@ void rafgl_game_start(rafgl_game_t *game, void *_args)
             current_game_state_index = __game_state_change_request;
             __game_state_change_request = -1;
 
-            current_state->init(game->window, args, __window_width, __window_height);
-            last_frame = glfwGetTime();
+            __rafgl_game_state_init(game, current_state, args);
+            __rafgl_game_reset_frame_time();
+            primed = 0;
+            state_frame = 0;
 
         }
 
     }
 
+    if(pipelined)
+    {
+        pthread_mutex_lock(&sim.lock);
+        sim.quit = 1;
+        pthread_cond_broadcast(&sim.cond);
+        pthread_mutex_unlock(&sim.lock);
+        pthread_join(sim.thread, NULL);
+        pthread_cond_destroy(&sim.cond);
+        pthread_mutex_destroy(&sim.lock);
+    }
+
+    /* while the context is still there */
+    __rafgl_game_state_cleanup(game, current_state, args);
+#ifdef RAFGL_TRACK_ALLOCATIONS
+    rafgl_alloc_log();
+#endif // RAFGL_TRACK_ALLOCATIONS
+
+    if(__record_file != NULL)
+    {
+        fclose(__record_file);
+        __record_file = NULL;
+    }
+
+    __rafgl_window_destroy();
+
+    /* everything still queued is written before the files go away */
+    __rafgl_log_stop_writer();
     for(i = 0; i < RAFGL_LOG_LEVELS; i++)
     {
-        fclose(__log_files[i]);
+        if(__log_files[i] != NULL) fclose(__log_files[i]);
+        __log_files[i] = NULL;
     }
 
 
@@ -1251,8 +4242,7 @@ rafgl_pixel_rgb_t rafgl_bilinear_sample(rafgl_raster_t *src, float u, float v)
 
 void rafgl_texture_init(rafgl_texture_t *tex)
 {
-    GLuint tx;
-    glGenTextures(1, &tx);
+    GLuint tx = rafgl_gpu_gen_texture("rafgl_texture_init");
     tex->channels = 0;
     tex->width = 0;
     tex->height = 0;
@@ -1277,7 +4267,7 @@ void rafgl_texture_load_from_raster(rafgl_texture_t *texture, rafgl_raster_t *ra
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, raster->width, raster->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, raster->data);
+    rafgl_gl_tex_image_2d(GL_TEXTURE_2D, 0, GL_RGBA, raster->width, raster->height, GL_RGBA, GL_UNSIGNED_BYTE, raster->data);
 
     glBindTexture(GL_TEXTURE_2D, 0);
 
@@ -1288,30 +4278,56 @@ void rafgl_texture_load_from_raster(rafgl_texture_t *texture, rafgl_raster_t *ra
     texture->tex_type = GL_TEXTURE_2D;
 }
 
+void rafgl_raster_load_from_texture(rafgl_raster_t *raster, GLuint tex_id)
+{
+    int width, height, x, y;
+    rafgl_pixel_rgb_t tmp;
+
+    glBindTexture(GL_TEXTURE_2D, tex_id);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+
+    rafgl_raster_init(raster, width, height);
+
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, raster->data);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    for(y = 0; y < height / 2; y++)
+    {
+        for(x = 0; x < width; x++)
+        {
+            tmp = pixel_at_pm(raster, x, y);
+            pixel_at_pm(raster, x, y) = pixel_at_pm(raster, x, height - 1 - y);
+            pixel_at_pm(raster, x, height - 1 - y) = tmp;
+        }
+    }
+}
+
 
 void rafgl_texture_show(const rafgl_texture_t *texture, int flip)
 {
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, texture->tex_id);
+    rafgl_gl_active_texture(GL_TEXTURE0);
+    rafgl_gl_bind_texture(GL_TEXTURE_2D, texture->tex_id);
 
-    glBindVertexArray(__raster_vao);
-    glUseProgram(__raster_program);
+    rafgl_gl_bind_vertex_array(__raster_vao);
+    rafgl_gl_use_program(__raster_program);
 
-    glUniform1f(__flip, flip);
+    rafgl_gl_uniform1f(__flip, flip);
 
-    glDrawArrays(GL_TRIANGLES, 0, 6);
+    rafgl_gl_draw_arrays(GL_TRIANGLES, 0, 6);
 
-    glUseProgram(0);
-    glBindVertexArray(0);
+    rafgl_gl_use_program(0);
+    rafgl_gl_bind_vertex_array(0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    rafgl_gl_bind_texture(GL_TEXTURE_2D, 0);
 
 }
 
 void rafgl_texture_cleanup(rafgl_texture_t *texture)
 {
-    glDeleteTextures(1, &(texture->tex_id));
+    rafgl_gpu_delete_texture(texture->tex_id);
     texture->channels = 0;
     texture->height = 0;
     texture->width = 0;
@@ -1352,8 +4368,8 @@ void rafgl_texture_load_cubemap(rafgl_texture_t *tex, const char *cubemap_paths[
         {
             rafgl_log(RAFGL_ERROR, "Failed to load texture at path [%s] intended for a cubemap!\n", cubemap_paths[i]);
         }
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-        free(data);
+        rafgl_gl_tex_image_2d(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGBA, width, height, GL_RGBA, GL_UNSIGNED_BYTE, data);
+        rafgl_free(data);
     }
 
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -1369,15 +4385,40 @@ void rafgl_texture_load_cubemap(rafgl_texture_t *tex, const char *cubemap_paths[
 }
 
 
+/* a format and type glTexImage2D accepts along with internalformat when there is no data to upload */
+static void __rafgl_transfer_format(GLenum internalformat, GLenum *format, GLenum *type)
+{
+    switch(internalformat)
+    {
+        case GL_R8: case GL_R16F: case GL_R32F: *format = GL_RED; break;
+        case GL_RG8: case GL_RG8_SNORM: case GL_RG16F: case GL_RG32F: *format = GL_RG; break;
+        case GL_RGB8: case GL_RGB16F: case GL_RGB32F: *format = GL_RGB; break;
+        case GL_DEPTH_COMPONENT16: case GL_DEPTH_COMPONENT24: case GL_DEPTH_COMPONENT32F: *format = GL_DEPTH_COMPONENT; break;
+        default: *format = GL_RGBA; break;
+    }
+
+    switch(internalformat)
+    {
+        case GL_R8: case GL_RG8: case GL_RGB8: case GL_RGBA8: *type = GL_UNSIGNED_BYTE; break;
+        case GL_RG8_SNORM: *type = GL_BYTE; break;
+        case GL_DEPTH_COMPONENT16: case GL_DEPTH_COMPONENT24: *type = GL_UNSIGNED_INT; break;
+        default: *type = GL_FLOAT; break;
+    }
+}
+
 rafgl_framebuffer_multitarget_t rafgl_framebuffer_multitarget_create(int w, int h, int num_attachments)
+{
+    return rafgl_framebuffer_multitarget_create_formats(w, h, num_attachments, NULL, RAFGL_FALSE);
+}
+
+rafgl_framebuffer_multitarget_t rafgl_framebuffer_multitarget_create_formats(int w, int h, int num_attachments, const GLenum *internal_formats, int depth_texture)
 {
     if(num_attachments > 16)
     {
         rafgl_log(RAFGL_WARNING, "Cant make %d attachments to a fbo, using 16 instead!\n", num_attachments);
         num_attachments = 16;
     }
-    GLuint framebuffer;
-    glGenFramebuffers(1, &framebuffer);
+    GLuint framebuffer = rafgl_gpu_gen_framebuffer("rafgl_framebuffer_multitarget_create");
     glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
 
     rafgl_framebuffer_multitarget_t fb_mt;
@@ -1389,13 +4430,17 @@ rafgl_framebuffer_multitarget_t rafgl_framebuffer_multitarget_create(int w, int
     fb_mt.num_textures = num_attachments;
 
     GLuint texture_colour_buffer;
+    GLenum internal_format, format, type;
     int i;
 
     for(i = 0; i < num_attachments; i++)
     {
-        glGenTextures(1, &texture_colour_buffer);
+        internal_format = internal_formats == NULL ? GL_RGBA16F : internal_formats[i];
+        __rafgl_transfer_format(internal_format, &format, &type);
+
+        texture_colour_buffer = rafgl_gpu_gen_texture("rafgl_framebuffer_multitarget_create colour");
         glBindTexture(GL_TEXTURE_2D, texture_colour_buffer);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, w, h, 0, GL_RGBA, GL_FLOAT, NULL);
+        rafgl_gl_tex_image_2d(GL_TEXTURE_2D, 0, internal_format, w, h, format, type, NULL);
 
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
@@ -1414,13 +4459,31 @@ rafgl_framebuffer_multitarget_t rafgl_framebuffer_multitarget_create(int w, int
 
 
 
-    GLuint rbo;
-    glGenRenderbuffers(1, &rbo);
-    glBindRenderbuffer(GL_RENDERBUFFER, rbo);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, w, h);
-    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    fb_mt.rbo_id = fb_mt.depth_tex_id = 0;
+    if(depth_texture)
+    {
+        GLuint depth = rafgl_gpu_gen_texture("rafgl_framebuffer_multitarget_create depth");
+        glBindTexture(GL_TEXTURE_2D, depth);
+        rafgl_gl_tex_image_2d(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, w, h, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
 
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+        fb_mt.depth_tex_id = depth;
+    }
+    else
+    {
+        GLuint rbo = rafgl_gpu_gen_renderbuffer("rafgl_framebuffer_multitarget_create depth");
+        glBindRenderbuffer(GL_RENDERBUFFER, rbo);
+        rafgl_gl_renderbuffer_storage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, w, h);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rbo);
+        fb_mt.rbo_id = rbo;
+    }
 
     if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
 	{
@@ -1436,15 +4499,13 @@ rafgl_framebuffer_multitarget_t rafgl_framebuffer_multitarget_create(int w, int
 rafgl_framebuffer_simple_t rafgl_framebuffer_simple_create(int w, int h, GLuint internalformat)
 {
 
-    GLuint framebuffer;
-    glGenFramebuffers(1, &framebuffer);
+    GLuint framebuffer = rafgl_gpu_gen_framebuffer("rafgl_framebuffer_simple_create");
     glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
 
 
-    GLuint texture_colour_buffer;
-    glGenTextures(1, &texture_colour_buffer);
+    GLuint texture_colour_buffer = rafgl_gpu_gen_texture("rafgl_framebuffer_simple_create colour");
     glBindTexture(GL_TEXTURE_2D, texture_colour_buffer);
-    glTexImage2D(GL_TEXTURE_2D, 0, internalformat, w, h, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+    rafgl_gl_tex_image_2d(GL_TEXTURE_2D, 0, internalformat, w, h, GL_RGB, GL_UNSIGNED_BYTE, NULL);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glBindTexture(GL_TEXTURE_2D, 0);
@@ -1452,10 +4513,9 @@ rafgl_framebuffer_simple_t rafgl_framebuffer_simple_create(int w, int h, GLuint
     // attach it to currently bound framebuffer object
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture_colour_buffer, 0);
 
-    GLuint rbo;
-    glGenRenderbuffers(1, &rbo);
+    GLuint rbo = rafgl_gpu_gen_renderbuffer("rafgl_framebuffer_simple_create depth");
     glBindRenderbuffer(GL_RENDERBUFFER, rbo);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, w, h);
+    rafgl_gl_renderbuffer_storage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, w, h);
     glBindRenderbuffer(GL_RENDERBUFFER, 0);
 
     glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rbo);
@@ -1469,19 +4529,52 @@ rafgl_framebuffer_simple_t rafgl_framebuffer_simple_create(int w, int h, GLuint
     rafgl_framebuffer_simple_t fb;
     fb.fbo_id = framebuffer;
     fb.tex_id = texture_colour_buffer;
+    fb.rbo_id = rbo;
 
     return fb;
 }
 
+void rafgl_framebuffer_simple_cleanup(rafgl_framebuffer_simple_t *fb)
+{
+    rafgl_gpu_delete_framebuffer(fb->fbo_id);
+    rafgl_gpu_delete_texture(fb->tex_id);
+    rafgl_gpu_delete_renderbuffer(fb->rbo_id);
+    fb->fbo_id = fb->tex_id = fb->rbo_id = 0;
+}
+
+void rafgl_framebuffer_multitarget_cleanup(rafgl_framebuffer_multitarget_t *fb)
+{
+    int i;
+
+    rafgl_gpu_delete_framebuffer(fb->fbo_id);
+    for(i = 0; i < fb->num_textures; i++)
+    {
+        rafgl_gpu_delete_texture(fb->tex_ids[i]);
+        fb->tex_ids[i] = 0;
+    }
+    rafgl_gpu_delete_renderbuffer(fb->rbo_id);
+    rafgl_gpu_delete_texture(fb->depth_tex_id);
+    fb->fbo_id = fb->rbo_id = fb->depth_tex_id = 0;
+    fb->num_textures = 0;
+}
+
 void rafgl_meshPUN_init(rafgl_meshPUN_t *m)
 {
     m->loaded = 0;
     m->triangle_count = 0;
     m->vertex_count = 0;
     m->vao_id = 0;
+    m->vbo_id = 0;
     memset(m->name, 0, sizeof(m->name));
 }
 
+void rafgl_meshPUN_cleanup(rafgl_meshPUN_t *m)
+{
+    glDeleteVertexArrays(1, &m->vao_id);
+    rafgl_gpu_delete_buffer(m->vbo_id);
+    rafgl_meshPUN_init(m);
+}
+
 void rafgl_meshPUN_load_plane(rafgl_meshPUN_t *m, float w, float h, int wtiles, int htiles)
 {
     rafgl_meshPUN_load_plane_offset(m, w, h, wtiles, htiles, vec3(0.0f, 0.0f, 0.0f));
@@ -1493,7 +4586,7 @@ void rafgl_meshPUN_load_plane_offset(rafgl_meshPUN_t *m, float w, float h, int w
     float tilew = w / wtiles;
     float tileh = h / htiles;
 
-    rafgl_vertexPUN_t *data = malloc(num_vertices * sizeof(rafgl_vertexPUN_t));
+    rafgl_vertexPUN_t *data = rafgl_malloc(RAFGL_ALLOC_MESH, num_vertices * sizeof(rafgl_vertexPUN_t));
 
     int vertex = 0, x, z;
 
@@ -1534,15 +4627,14 @@ void rafgl_meshPUN_load_plane_offset(rafgl_meshPUN_t *m, float w, float h, int w
     }
 
     glGenVertexArrays(1, &m->vao_id);
-    GLuint vbo;
-    glGenBuffers(1, &vbo);
+    GLuint vbo = rafgl_gpu_gen_buffer("rafgl_meshPUN_load_plane");
 
     glBindVertexArray(m->vao_id);
     glBindBuffer(GL_ARRAY_BUFFER, vbo);
 
-    glBufferData(GL_ARRAY_BUFFER,num_vertices * sizeof(rafgl_vertexPUN_t), data, GL_STATIC_DRAW);
+    rafgl_gl_buffer_data(GL_ARRAY_BUFFER,num_vertices * sizeof(rafgl_vertexPUN_t), data, GL_STATIC_DRAW);
 
-    free(data);
+    rafgl_free(data);
 
     glEnableVertexAttribArray(0);
     glEnableVertexAttribArray(1);
@@ -1556,7 +4648,7 @@ void rafgl_meshPUN_load_plane_offset(rafgl_meshPUN_t *m, float w, float h, int w
     glBindVertexArray(0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-    glDeleteBuffers(1, &vbo);
+    m->vbo_id = vbo;
 
     m->loaded = 1;
     sprintf(m->name, "%d x %d plane", wtiles, htiles);
@@ -1590,7 +4682,7 @@ void rafgl_meshPUN_load_terrain_from_heightmap(rafgl_meshPUN_t *m, float w, floa
     float tilew = w / wtiles;
     float tileh = h / htiles;
 
-    rafgl_vertexPUN_t *data = malloc(num_vertices * sizeof(rafgl_vertexPUN_t));
+    rafgl_vertexPUN_t *data = rafgl_malloc(RAFGL_ALLOC_MESH, num_vertices * sizeof(rafgl_vertexPUN_t));
 
     int vertex = 0, x, z;
     vec3_t direction, normal;
@@ -1639,15 +4731,14 @@ void rafgl_meshPUN_load_terrain_from_heightmap(rafgl_meshPUN_t *m, float w, floa
     }
 
     glGenVertexArrays(1, &m->vao_id);
-    GLuint vbo;
-    glGenBuffers(1, &vbo);
+    GLuint vbo = rafgl_gpu_gen_buffer("rafgl_meshPUN_load_terrain");
 
     glBindVertexArray(m->vao_id);
     glBindBuffer(GL_ARRAY_BUFFER, vbo);
 
-    glBufferData(GL_ARRAY_BUFFER,num_vertices * sizeof(rafgl_vertexPUN_t), data, GL_STATIC_DRAW);
+    rafgl_gl_buffer_data(GL_ARRAY_BUFFER,num_vertices * sizeof(rafgl_vertexPUN_t), data, GL_STATIC_DRAW);
 
-    free(data);
+    rafgl_free(data);
 
     glEnableVertexAttribArray(0);
     glEnableVertexAttribArray(1);
@@ -1661,7 +4752,7 @@ void rafgl_meshPUN_load_terrain_from_heightmap(rafgl_meshPUN_t *m, float w, floa
     glBindVertexArray(0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-    glDeleteBuffers(1, &vbo);
+    m->vbo_id = vbo;
 
     m->loaded = 1;
     sprintf(m->name, "%d x %d plane", wtiles, htiles);
@@ -1740,13 +4831,12 @@ void rafgl_meshPUN_load_cube(rafgl_meshPUN_t *m, float coord)
     };
 
     glGenVertexArrays(1, &m->vao_id);
-    GLuint vbo;
-    glGenBuffers(1, &vbo);
+    GLuint vbo = rafgl_gpu_gen_buffer("rafgl_meshPUN_load_cube");
 
     glBindVertexArray(m->vao_id);
     glBindBuffer(GL_ARRAY_BUFFER, vbo);
 
-    glBufferData(GL_ARRAY_BUFFER, 6 * 2 * 3 * (3 + 2 + 3) * sizeof(GLfloat), cube_vertices, GL_STATIC_DRAW);
+    rafgl_gl_buffer_data(GL_ARRAY_BUFFER, 6 * 2 * 3 * (3 + 2 + 3) * sizeof(GLfloat), cube_vertices, GL_STATIC_DRAW);
 
     glEnableVertexAttribArray(0);
     glEnableVertexAttribArray(1);
@@ -1760,7 +4850,7 @@ void rafgl_meshPUN_load_cube(rafgl_meshPUN_t *m, float coord)
     glBindVertexArray(0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-    glDeleteBuffers(1, &vbo);
+    m->vbo_id = vbo;
 
     m->loaded = 1;
     strcpy(m->name, "cube");
@@ -1783,13 +4873,58 @@ void rafgl_meshPUN_load_from_OBJ_offset(rafgl_meshPUN_t *m, const char *obj_path
         rafgl_log(RAFGL_WARNING, "Trying to load to already loaded mesh! Loading from [%s] to mesh taken by [%s]", obj_path, m->name);
         return;
     }
+
+    rafgl_vertexPUN_t *vertex_buffer;
+    int vcount = rafgl_meshPUN_parse_OBJ(m, obj_path, position_offset, &vertex_buffer);
+    if(vcount < 0) return;
+
+    /* GL BUFFER DATA */
+
+	int vao;
+	glGenVertexArrays(1, &vao);
+
+	m -> vao_id = vao;
+	m -> vertex_count = vcount;
+	m -> triangle_count = vcount / 3;
+
+	glBindVertexArray(vao);
+
+	m -> vbo_id = rafgl_gpu_gen_buffer("rafgl_meshPUN_load_from_OBJ");
+	glBindBuffer(GL_ARRAY_BUFFER, m -> vbo_id);
+	rafgl_gl_buffer_data(GL_ARRAY_BUFFER, vcount * sizeof(rafgl_vertexPUN_t), vertex_buffer, GL_STATIC_DRAW);
+
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glEnableVertexAttribArray(2);
+
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(rafgl_vertexPUN_t), (void*)0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(rafgl_vertexPUN_t), (void*)(3 * sizeof(float)));
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(rafgl_vertexPUN_t), (void*)(5 * sizeof(float)));
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+
+
+    /* free RAM */
+	rafgl_free(vertex_buffer);
+	m->loaded = 1;
+}
+
+int rafgl_meshPUN_parse_OBJ(rafgl_meshPUN_t *m, const char *obj_path, vec3_t position_offset, rafgl_vertexPUN_t **vertex_buffer_out)
+{
+    FILE *f = fopen(obj_path, "rt");
+    if(f == NULL)
+    {
+        rafgl_log(RAFGL_ERROR, "Failed to open [%s], mesh left empty!\n", obj_path);
+        return -1;
+    }
+
     rafgl_list_t vertices, uv_coordinates, normals;
     rafgl_list_init(&vertices, sizeof(vec3_t));
     rafgl_list_init(&uv_coordinates, sizeof(vec3_t));
     rafgl_list_init(&normals, sizeof(vec3_t));
     vec3_t vectmp;
 
-    FILE *f = fopen(obj_path, "rt");
     char line[256];
 
 
@@ -1830,9 +4965,10 @@ void rafgl_meshPUN_load_from_OBJ_offset(rafgl_meshPUN_t *m, const char *obj_path
 
     vec3_t *vertices_buffer, *uv_buffer, *normals_buffer;
 
-    vertices_buffer = malloc(vertices.count * sizeof(vec3_t));
-    uv_buffer = malloc(uv_coordinates.count * sizeof(vec3_t));
-    normals_buffer = malloc(normals.count * sizeof(vec3_t));
+    vertices_buffer = rafgl_malloc(RAFGL_ALLOC_OBJ, vertices.count * sizeof(vec3_t));
+    /* one spare zeroed slot at the end, faces without uvs all point at uv 1 which is this one when the file has none */
+    uv_buffer = rafgl_calloc(RAFGL_ALLOC_OBJ, uv_coordinates.count + 1, sizeof(vec3_t));
+    normals_buffer = rafgl_malloc(RAFGL_ALLOC_OBJ, normals.count * sizeof(vec3_t));
 
     vec3_t *vb1, *vb2, *vb3;
     int o1 = 0, o2 = 0, o3 = 0;
@@ -1864,7 +5000,7 @@ void rafgl_meshPUN_load_from_OBJ_offset(rafgl_meshPUN_t *m, const char *obj_path
         rafgl_list_remove(&normals, 0);
     }
 
-	int fake_uvs = 0;
+	int fake_uvs = 0, parse_failed = 0;
 	rafgl_list_t vertex_indices, uv_indices, normal_indices;
     rafgl_list_init(&vertex_indices, sizeof(int));
     rafgl_list_init(&uv_indices, sizeof(int));
@@ -1891,7 +5027,8 @@ void rafgl_meshPUN_load_from_OBJ_offset(rafgl_meshPUN_t *m, const char *obj_path
 			{
 				rafgl_log(RAFGL_WARNING, "File can't be read, try exporting with other options [matches = %d]", matches);
 				rafgl_log(RAFGL_WARNING, "error on: %s\n", line);
-				return;
+				parse_failed = 1;
+				break;
 			}
 			else
 			{
@@ -1923,13 +5060,7 @@ void rafgl_meshPUN_load_from_OBJ_offset(rafgl_meshPUN_t *m, const char *obj_path
 
 	}
 
-	if(fake_uvs)
-    {
-        vectmp = vec3(0.0f, 0.0f, 0.0f);
-        rafgl_list_append(&uv_coordinates, &vectmp);
-    }
-
-    rafgl_vertexPUN_t *vertex_buffer = malloc(vertex_indices.count * sizeof(rafgl_vertexPUN_t));
+    rafgl_vertexPUN_t *vertex_buffer = parse_failed ? NULL : rafgl_malloc(RAFGL_ALLOC_OBJ, vertex_indices.count * sizeof(rafgl_vertexPUN_t));
     int i;
     int vert_ind;
     int uv_ind;
@@ -1937,7 +5068,7 @@ void rafgl_meshPUN_load_from_OBJ_offset(rafgl_meshPUN_t *m, const char *obj_path
 
     vec3_t vertex_data, uv_data, normal_data;
 
-    int vcount = vertex_indices.count;
+    int vcount = parse_failed ? -1 : vertex_indices.count;
     for(i = 0; i < vcount; i++)
     {
         vert_ind = *((int*)rafgl_list_get(&vertex_indices, 0));
@@ -1961,37 +5092,6 @@ void rafgl_meshPUN_load_from_OBJ_offset(rafgl_meshPUN_t *m, const char *obj_path
 
     }
 
-    /* GL BUFFER DATA */
-
-	int vao;
-	glGenVertexArrays(1, &vao);
-
-	m -> vao_id = vao;
-	m -> vertex_count = vcount;
-	m -> triangle_count = vcount / 3;
-
-	glBindVertexArray(vao);
-
-	int data_buffer;
-	glGenBuffers(1, &data_buffer);
-	glBindBuffer(GL_ARRAY_BUFFER, data_buffer);
-	glBufferData(GL_ARRAY_BUFFER, vcount * sizeof(rafgl_vertexPUN_t), vertex_buffer, GL_STATIC_DRAW);
-
-    glEnableVertexAttribArray(0);
-    glEnableVertexAttribArray(1);
-    glEnableVertexAttribArray(2);
-
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(rafgl_vertexPUN_t), (void*)0);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(rafgl_vertexPUN_t), (void*)(3 * sizeof(float)));
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(rafgl_vertexPUN_t), (void*)(5 * sizeof(float)));
-
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
-
-
-    /* free RAM */
-	free(vertex_buffer);
-
 	rafgl_list_free(&vertices);
 	rafgl_list_free(&uv_coordinates);
 	rafgl_list_free(&normals);
@@ -1999,14 +5099,15 @@ void rafgl_meshPUN_load_from_OBJ_offset(rafgl_meshPUN_t *m, const char *obj_path
 	rafgl_list_free(&vertex_indices);
 	rafgl_list_free(&uv_indices);
 	rafgl_list_free(&normal_indices);
-	m->loaded = 1;
 
-	free(vertices_buffer);
-	free(uv_buffer);
-	free(normals_buffer);
+	rafgl_free(vertices_buffer);
+	rafgl_free(uv_buffer);
+	rafgl_free(normals_buffer);
 
     fclose(f);
 
+    *vertex_buffer_out = vertex_buffer;
+    return vcount;
 }
 
 
@@ -2028,14 +5129,14 @@ int rafgl_list_append_sized(rafgl_list_t *list, int size, void *data)
 {
     if(list -> head == NULL && list -> tail == NULL)
     {
-        list -> head = list -> tail = malloc(sizeof(void*) + size);
+        list -> head = list -> tail = rafgl_malloc(RAFGL_ALLOC_LIST, sizeof(void*) + size);
         memcpy(list -> tail + sizeof(void*), data, size);
         *((void**)list -> tail) = NULL;
         list -> count++;
     }
     else
     {
-        *((void**)list -> tail) = malloc(sizeof(void*) + size);
+        *((void**)list -> tail) = rafgl_malloc(RAFGL_ALLOC_LIST, sizeof(void*) + size);
         list -> tail = *((void**)list -> tail);
         memcpy(list -> tail + sizeof(void*), data, size);
         *((void**)list -> tail) = NULL;
@@ -2068,7 +5169,7 @@ int rafgl_list_remove(rafgl_list_t *list, int index)
 
     }
     list -> count--;
-    free(target);
+    rafgl_free(target);
     return 0;
 }
 
@@ -2096,7 +5197,7 @@ int rafgl_list_free(rafgl_list_t *list)
     {
         curr = i;
         i = *i;
-        free(curr);
+        rafgl_free(curr);
     }
     return 0;
 }
@@ -2135,7 +5236,7 @@ char* rafgl_file_read_content(const char *filepath)
 
     fseek(f, 0, SEEK_SET);
 
-    char *content = calloc(sizeof(char), fsize + 10);          /* This must later be freed */
+    char *content = rafgl_calloc(RAFGL_ALLOC_FILE, sizeof(char), fsize + 10);          /* This must later be freed with rafgl_free */
 
     fread(content, 1, fsize, f);
 
@@ -2207,8 +5308,8 @@ GLuint rafgl_program_create(const char *vertex_source_filepath, const char *frag
 
     program = rafgl_program_create_from_source(vert_source, frag_source);
 
-    free(vert_source);
-    free(frag_source);
+    rafgl_free(vert_source);
+    rafgl_free(frag_source);
 
     return program;
 }
@@ -2230,6 +5331,123 @@ GLuint rafgl_program_create_from_name(const char *program_name)
     return rafgl_program_create(v, f);
 }
 
+GLuint rafgl_program_create_fullscreen_from_name(const char *program_name)
+{
+    GLuint program;
+    char f[255];
+    f[0] = 0;
+
+    strcat(f, "res" SYSTEM_SEPARATOR "shaders" SYSTEM_SEPARATOR);
+    strcat(f, program_name);
+    strcat(f, SYSTEM_SEPARATOR "frag.glsl");
+
+    char *frag_source = rafgl_file_read_content(f);
+    program = rafgl_program_create_from_source(__fullscreen_vertex_shader_source, frag_source);
+    rafgl_free(frag_source);
+
+    return program;
+}
+
+int rafgl_compute_supported(void)
+{
+    return __gl_dispatch_compute != NULL && __gl_bind_image_texture != NULL && __gl_memory_barrier != NULL;
+}
+
+GLuint rafgl_program_create_compute_from_name(const char *program_name)
+{
+    GLuint comp, program;
+    int success;
+    char info_log[512];
+    char c[255];
+    c[0] = 0;
+
+    if(!rafgl_compute_supported())
+        return 0;
+
+    strcat(c, "res" SYSTEM_SEPARATOR "shaders" SYSTEM_SEPARATOR);
+    strcat(c, program_name);
+    strcat(c, SYSTEM_SEPARATOR "comp.glsl");
+
+    char *comp_source = rafgl_file_read_content(c);
+    const char *source = comp_source;
+
+    comp = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(comp, 1, &source, NULL);
+    glCompileShader(comp);
+    rafgl_free(comp_source);
+
+    glGetShaderiv(comp, GL_COMPILE_STATUS, &success);
+
+    if(!success)
+    {
+        glGetShaderInfoLog(comp, 512, NULL, info_log);
+        fprintf(stderr, "ERROR::SHADER::COMPUTE::COMPILE_FAILED\n%s\n", info_log);
+    }
+
+    program = glCreateProgram();
+    glAttachShader(program, comp);
+    glLinkProgram(program);
+
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if(!success)
+    {
+        glGetProgramInfoLog(program, 512, NULL, info_log);
+        fprintf(stderr, "ERROR::SHADER::PROGRAM::LINKING_FAILED\n%s\n", info_log);
+    }
+
+    glDeleteShader(comp);
+
+    return program;
+}
+
+void rafgl_pass_compute(GLuint program, const rafgl_pass_input_t *inputs, int input_count, int groups_x, int groups_y)
+{
+    int i;
+
+    rafgl_gl_use_program(program);
+
+    for(i = 0; i < input_count; i++)
+    {
+        rafgl_gl_active_texture(GL_TEXTURE0 + i);
+        rafgl_gl_bind_texture(inputs[i].target ? inputs[i].target : GL_TEXTURE_2D, inputs[i].tex_id);
+        rafgl_gl_uniform1i(inputs[i].sampler_location, i);
+    }
+
+    /* counted with the draws, it is the same amount of submitted work */
+    __counters_current.draw_calls++;
+    __gl_dispatch_compute(groups_x, groups_y, 1);
+
+    if(input_count > 1) rafgl_gl_active_texture(GL_TEXTURE0);
+}
+
+void rafgl_pass_fullscreen(GLuint program, GLuint target_fbo, const rafgl_pass_input_t *inputs, int input_count)
+{
+    int i;
+    GLboolean depth_test = glIsEnabled(GL_DEPTH_TEST);
+
+    rafgl_gl_bind_framebuffer(GL_FRAMEBUFFER, target_fbo);
+    rafgl_gl_use_program(program);
+
+    for(i = 0; i < input_count; i++)
+    {
+        rafgl_gl_active_texture(GL_TEXTURE0 + i);
+        rafgl_gl_bind_texture(inputs[i].target ? inputs[i].target : GL_TEXTURE_2D, inputs[i].tex_id);
+        rafgl_gl_uniform1i(inputs[i].sampler_location, i);
+    }
+
+    /* every pixel is written, so there is nothing to clear and nothing to test against */
+    if(depth_test) rafgl_gl_disable(GL_DEPTH_TEST);
+
+    rafgl_gl_bind_vertex_array(__fullscreen_vao);
+    rafgl_gl_draw_arrays(GL_TRIANGLES, 0, 3);
+    rafgl_gl_bind_vertex_array(0);
+
+    if(depth_test) rafgl_gl_enable(GL_DEPTH_TEST);
+
+    if(input_count > 1) rafgl_gl_active_texture(GL_TEXTURE0);
+    rafgl_gl_bind_framebuffer(GL_FRAMEBUFFER, 0);
+}
+
 /*
 void test_show(void *element, int last)
 {
@@ -0,0 +1,48 @@
+#ifndef STRESS_SCENE_H_INCLUDED
+#define STRESS_SCENE_H_INCLUDED
+
+#include <stdint.h>
+#include <rafgl.h>
+
+typedef struct _stress_scene_params_t
+{
+    /* the same seed and parameters always produce the same scene */
+    uint32_t seed;
+    /* total number of mesh copies, 0 means no scene */
+    int instance_count;
+    /* copies are spread over this many slabs one behind the other, roughly how many surfaces a pixel covers */
+    int depth_layers;
+    float layer_spacing;
+    /* fraction of the view width and height, at each slab's distance, that the copies are spread over */
+    float coverage;
+    /* the camera the scene is framed for, looking down -z */
+    vec3_t eye;
+    float fov, aspect;
+    float scale_min, scale_max;
+    /* share of copies placed as intersecting pairs (deep crevices) and squashed into plates or needles (thin geometry) */
+    float crevice_fraction, thin_fraction;
+} stress_scene_params_t;
+
+typedef struct _stress_instance_t
+{
+    mat4_t model;
+    /* one of the mesh ids handed to stress_scene_generate */
+    int mesh;
+} stress_instance_t;
+
+typedef struct _stress_scene_t
+{
+    stress_instance_t *instances;
+    int count;
+} stress_scene_t;
+
+/* framed for main_state's starting camera, with instance_count left at 0 */
+void stress_scene_default_params(stress_scene_params_t *params);
+/* consumes the --stress* option at argv[*i] (and its value), returns 0 when the option isn't one of them */
+int stress_scene_parse_arg(stress_scene_params_t *params, int argc, char *argv[], int *i);
+/* instances pick from mesh_ids and come out sorted by mesh, so consecutive copies share their vertex array */
+int stress_scene_generate(stress_scene_t *scene, const stress_scene_params_t *params, const int *mesh_ids, int mesh_id_count);
+/* free */
+void stress_scene_cleanup(stress_scene_t *scene);
+
+#endif // STRESS_SCENE_H_INCLUDED
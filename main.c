@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -15,8 +16,52 @@ int main(int argc, char *argv[])
 {
 
     rafgl_game_t game;
+    int i;
+    const char *record_path = NULL, *replay_path = NULL;
+    stress_scene_params_t stress;
+
+    stress_scene_default_params(&stress);
+
+    for(i = 1; i < argc; i++)
+    {
+        if(stress_scene_parse_arg(&stress, argc, argv, &i))
+            continue;
+
+        if(!strcmp(argv[i], "--pipelined"))
+            rafgl_game_set_pipelined(RAFGL_TRUE);
+        else if(!strcmp(argv[i], "--vsync") && i + 1 < argc)
+        {
+            i++;
+            if(!strcmp(argv[i], "off"))
+                rafgl_game_set_swap_interval(RAFGL_VSYNC_OFF);
+            else if(!strcmp(argv[i], "adaptive"))
+                rafgl_game_set_swap_interval(RAFGL_VSYNC_ADAPTIVE);
+            else
+                rafgl_game_set_swap_interval(RAFGL_VSYNC_ON);
+        }
+        else if(!strcmp(argv[i], "--fps-limit") && i + 1 < argc)
+            rafgl_game_set_frame_limit(atof(argv[++i]));
+        else if(!strcmp(argv[i], "--latency"))
+            rafgl_latency_tracking(RAFGL_TRUE);
+        else if(!strcmp(argv[i], "--profile"))
+            rafgl_profile_enable(RAFGL_TRUE);
+        else if(!strcmp(argv[i], "--on-demand"))
+            rafgl_game_set_render_on_demand(RAFGL_TRUE);
+        else if(!strcmp(argv[i], "--smooth-delta") && i + 1 < argc)
+            rafgl_game_set_delta_smoothing(atof(argv[++i]));
+        else if(!strcmp(argv[i], "--record") && i + 1 < argc)
+            record_path = argv[++i];
+        else if(!strcmp(argv[i], "--replay") && i + 1 < argc)
+            replay_path = argv[++i];
+    }
 
     rafgl_game_init(&game, "main", 1280, 720, 0);
+
+    /* after init, so failures can be logged */
+    if(record_path) rafgl_input_record(record_path);
+    if(replay_path) rafgl_input_replay(replay_path);
+
+    main_state_set_stress_scene(&stress);
     rafgl_game_add_named_game_state(&game, main_state);
     rafgl_game_start(&game, NULL);
 
@@ -0,0 +1,531 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#define RAFGL_IMPLEMENTATION
+#include <rafgl.h>
+
+#include <image_diff.h>
+
+#ifndef RAFGL_BENCH_COMMIT
+#define RAFGL_BENCH_COMMIT "unknown"
+#endif // RAFGL_BENCH_COMMIT
+
+#define MICROBENCH_MAX_RESULTS      64
+#define MICROBENCH_MAX_REPETITIONS  1000
+/* iterations per repetition are doubled until one repetition takes at least this long */
+#define MICROBENCH_MIN_REP_SECONDS  0.002
+#define MICROBENCH_WARMUP_SECONDS   0.05
+
+typedef struct _microbench_result_t
+{
+    char name[64];
+    long iterations;
+    int repetitions;
+    /* per iteration */
+    double min_ns, median_ns, mean_ns, stddev_ns, p90_ns;
+} microbench_result_t;
+
+typedef void (*microbench_fn)(void *ctx, long iterations);
+
+static microbench_result_t results[MICROBENCH_MAX_RESULTS];
+static int result_count = 0;
+
+static int repetitions = 30;
+static const char *filter = NULL;
+
+/* results are folded into this so the compiler can't drop the work */
+static volatile uint32_t sink;
+
+static int compare_doubles(const void *a, const void *b)
+{
+    double da = *(const double*)a, db = *(const double*)b;
+    return (da > db) - (da < db);
+}
+
+static double time_iterations(microbench_fn fn, void *ctx, long iterations)
+{
+    double start = rafgl_time();
+    fn(ctx, iterations);
+    return rafgl_time() - start;
+}
+
+static void run(const char *name, microbench_fn fn, void *ctx)
+{
+    double rep_ns[MICROBENCH_MAX_REPETITIONS];
+    double sum = 0.0, sq_sum = 0.0, start;
+    long iterations = 1;
+    int i;
+
+    if(filter != NULL && strstr(name, filter) == NULL) return;
+    if(result_count == MICROBENCH_MAX_RESULTS)
+    {
+        rafgl_log(RAFGL_WARNING, "Too many benchmarks, skipping [%s]!\n", name);
+        return;
+    }
+
+    while(time_iterations(fn, ctx, iterations) < MICROBENCH_MIN_REP_SECONDS && iterations < (1L << 30))
+    {
+        iterations *= 2;
+    }
+
+    /* caches, branch predictors and the CPU clock settle before anything is measured */
+    start = rafgl_time();
+    while(rafgl_time() - start < MICROBENCH_WARMUP_SECONDS)
+    {
+        fn(ctx, iterations);
+    }
+
+    for(i = 0; i < repetitions; i++)
+    {
+        rep_ns[i] = time_iterations(fn, ctx, iterations) * 1e9 / iterations;
+        sum += rep_ns[i];
+        sq_sum += rep_ns[i] * rep_ns[i];
+    }
+    qsort(rep_ns, repetitions, sizeof(double), compare_doubles);
+
+    microbench_result_t *r = &results[result_count++];
+    strncpy(r->name, name, sizeof(r->name) - 1);
+    r->iterations = iterations;
+    r->repetitions = repetitions;
+    r->min_ns = rep_ns[0];
+    r->median_ns = rep_ns[repetitions / 2];
+    r->mean_ns = sum / repetitions;
+    r->stddev_ns = sqrt(rafgl_max_m(sq_sum / repetitions - r->mean_ns * r->mean_ns, 0.0));
+    r->p90_ns = rep_ns[(int)(0.9 * (repetitions - 1) + 0.5)];
+
+    printf("%-36s %12.1f ns  (min %.1f, p90 %.1f, stddev %.1f%%, %ld x %d)\n", r->name, r->median_ns, r->min_ns, r->p90_ns,
+           r->mean_ns > 0.0 ? 100.0 * r->stddev_ns / r->mean_ns : 0.0, r->iterations, r->repetitions);
+}
+
+
+/* OBJ parsing, one benchmark per model */
+
+static void bench_obj_parse(void *ctx, long iterations)
+{
+    rafgl_meshPUN_t mesh;
+    rafgl_vertexPUN_t *vertices;
+    long i;
+
+    for(i = 0; i < iterations; i++)
+    {
+        rafgl_meshPUN_init(&mesh);
+        int count = rafgl_meshPUN_parse_OBJ(&mesh, ctx, vec3(0.0f, 0.0f, 0.0f), &vertices);
+        if(count > 0)
+        {
+            sink += count + (uint32_t)vertices[count - 1].position.x;
+            rafgl_free(vertices);
+        }
+    }
+}
+
+static void run_obj_parse(void)
+{
+    char names[MICROBENCH_MAX_RESULTS][48], path[64], bench_name[64];
+    int count = 0, i;
+    struct dirent *entry;
+
+    DIR *dir = opendir("res/models");
+    if(dir == NULL)
+    {
+        rafgl_log(RAFGL_ERROR, "Can't open res/models, run from the repository root!\n");
+        return;
+    }
+    while((entry = readdir(dir)) != NULL && count < MICROBENCH_MAX_RESULTS)
+    {
+        int len = strlen(entry->d_name);
+        if(len > 4 && len < (int)sizeof(names[0]) && !strcmp(entry->d_name + len - 4, ".obj"))
+        {
+            strcpy(names[count++], entry->d_name);
+        }
+    }
+    closedir(dir);
+
+    /* directory order isn't stable, result order should be */
+    qsort(names, count, sizeof(names[0]), (int (*)(const void*, const void*)) strcmp);
+
+    for(i = 0; i < count; i++)
+    {
+        snprintf(path, sizeof(path), "res/models/%.47s", names[i]);
+        snprintf(bench_name, sizeof(bench_name), "obj_parse/%.47s", names[i]);
+        run(bench_name, bench_obj_parse, path);
+    }
+}
+
+
+/* rafgl_list_t */
+
+#define LIST_ELEMENTS 1000
+
+static void bench_list_append(void *ctx, long iterations)
+{
+    rafgl_list_t list;
+    long i;
+    int j;
+
+    for(i = 0; i < iterations; i++)
+    {
+        rafgl_list_init(&list, sizeof(int));
+        for(j = 0; j < LIST_ELEMENTS; j++)
+        {
+            rafgl_list_append(&list, &j);
+        }
+        sink += list.count;
+        rafgl_list_free(&list);
+    }
+}
+
+static void bench_list_get(void *ctx, long iterations)
+{
+    rafgl_list_t *list = ctx;
+    long i;
+
+    for(i = 0; i < iterations; i++)
+    {
+        sink += *(int*)rafgl_list_get(list, (i * 7919) % LIST_ELEMENTS);
+    }
+}
+
+static void bench_list_remove_head(void *ctx, long iterations)
+{
+    rafgl_list_t list;
+    long i;
+    int j;
+
+    for(i = 0; i < iterations; i++)
+    {
+        rafgl_list_init(&list, sizeof(int));
+        for(j = 0; j < LIST_ELEMENTS; j++)
+        {
+            rafgl_list_append(&list, &j);
+        }
+        while(list.count)
+        {
+            sink += *(int*)rafgl_list_get(&list, 0);
+            rafgl_list_remove(&list, 0);
+        }
+    }
+}
+
+static void run_list(void)
+{
+    rafgl_list_t list;
+    int j;
+
+    rafgl_list_init(&list, sizeof(int));
+    for(j = 0; j < LIST_ELEMENTS; j++)
+    {
+        rafgl_list_append(&list, &j);
+    }
+
+    run("list_append/1000", bench_list_append, NULL);
+    run("list_get/random_of_1000", bench_list_get, &list);
+    run("list_fill_remove_head/1000", bench_list_remove_head, NULL);
+
+    rafgl_list_free(&list);
+}
+
+
+/* raster */
+
+typedef struct _raster_ctx_t
+{
+    rafgl_raster_t src, tmp, dst, upsampled;
+} raster_ctx_t;
+
+static void bench_box_blur(void *ctx, long iterations)
+{
+    raster_ctx_t *r = ctx;
+    long i;
+
+    for(i = 0; i < iterations; i++)
+    {
+        rafgl_raster_box_blur(&r->dst, &r->tmp, &r->src, 4);
+        sink += r->dst.data[i % (r->dst.width * r->dst.height)].rgba;
+    }
+}
+
+static void bench_bilinear_sample(void *ctx, long iterations)
+{
+    raster_ctx_t *r = ctx;
+    uint32_t state = 12345;
+    long i;
+
+    for(i = 0; i < iterations; i++)
+    {
+        state = state * 1664525u + 1013904223u;
+        float u = (state >> 8 & 0xffff) / 65536.0f;
+        float v = (state >> 16 & 0xffff) / 65536.0f;
+        sink += rafgl_bilinear_sample(&r->src, u, v).rgba;
+    }
+}
+
+static void bench_bilinear_upsample(void *ctx, long iterations)
+{
+    raster_ctx_t *r = ctx;
+    long i;
+
+    for(i = 0; i < iterations; i++)
+    {
+        rafgl_raster_bilinear_upsample(&r->upsampled, &r->src);
+        sink += r->upsampled.data[i % (r->upsampled.width * r->upsampled.height)].rgba;
+    }
+}
+
+static void bench_draw_string(void *ctx, long iterations)
+{
+    raster_ctx_t *r = ctx;
+    long i;
+
+    for(i = 0; i < iterations; i++)
+    {
+        rafgl_raster_draw_string(&r->dst, "The quick brown fox jumps over the lazy dog 0123456789", 4, 4 + i % 32, rafgl_RGB(255, 255, 255), RAFGL_FONT_MEDIUM);
+        sink += r->dst.data[0].rgba;
+    }
+}
+
+static void bench_image_diff(void *ctx, long iterations)
+{
+    raster_ctx_t *r = ctx;
+    image_diff_t diff;
+    long i;
+
+    for(i = 0; i < iterations; i++)
+    {
+        image_diff_compare(&r->src, &r->dst, &diff);
+        sink += diff.differing_pixels;
+    }
+}
+
+static void run_raster(void)
+{
+    raster_ctx_t r;
+    int x, y;
+
+    rafgl_raster_init(&r.src, 256, 256);
+    rafgl_raster_init(&r.tmp, 256, 256);
+    rafgl_raster_init(&r.dst, 256, 256);
+    rafgl_raster_init(&r.upsampled, 512, 512);
+
+    for(y = 0; y < r.src.height; y++)
+    {
+        for(x = 0; x < r.src.width; x++)
+        {
+            pixel_at_m(r.src, x, y).rgba = rafgl_RGB(x, y, (x ^ y) & 0xff);
+        }
+    }
+
+    rafgl_font_init();
+
+    run("raster_box_blur/256x256_r4", bench_box_blur, &r);
+    run("bilinear_sample/256x256", bench_bilinear_sample, &r);
+    run("raster_bilinear_upsample/256_to_512", bench_bilinear_upsample, &r);
+    run("raster_draw_string/54_chars", bench_draw_string, &r);
+    /* dst holds the blurred source with text on it by now */
+    run("image_diff_compare/256x256", bench_image_diff, &r);
+
+    rafgl_raster_cleanup(&r.src);
+    rafgl_raster_cleanup(&r.tmp);
+    rafgl_raster_cleanup(&r.dst);
+    rafgl_raster_cleanup(&r.upsampled);
+}
+
+
+/* math_3d */
+
+/* the inputs change every iteration so nothing is hoisted out of the loop */
+static void bench_m4_mul(void *ctx, long iterations)
+{
+    mat4_t a = m4_rotation_y(0.3f), b = m4_perspective(75.0f, 16.0f / 9.0f, 0.1f, 100.0f);
+    long i;
+
+    for(i = 0; i < iterations; i++)
+    {
+        a.m[3][0] = i;
+        a = m4_mul(b, a);
+    }
+    sink += (uint32_t)a.m[0][0];
+}
+
+static void bench_m4_invert_affine(void *ctx, long iterations)
+{
+    mat4_t a = m4_mul(m4_translation(vec3(1.0f, 2.0f, 3.0f)), m4_rotation_y(0.3f)), r;
+    long i;
+
+    for(i = 0; i < iterations; i++)
+    {
+        a.m[3][0] = i;
+        r = m4_invert_affine(a);
+        sink += (uint32_t)r.m[3][0];
+    }
+}
+
+static void bench_m4_look_at(void *ctx, long iterations)
+{
+    mat4_t r;
+    long i;
+
+    for(i = 0; i < iterations; i++)
+    {
+        r = m4_look_at(vec3(i & 7, 1.0f, 6.5f), vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f));
+        sink += (uint32_t)r.m[3][2];
+    }
+}
+
+static void bench_m4_perspective(void *ctx, long iterations)
+{
+    mat4_t r;
+    long i;
+
+    for(i = 0; i < iterations; i++)
+    {
+        r = m4_perspective(60.0f + (i & 15), 16.0f / 9.0f, 0.1f, 100.0f);
+        sink += (uint32_t)r.m[1][1];
+    }
+}
+
+static void bench_m4_rotation(void *ctx, long iterations)
+{
+    mat4_t r;
+    long i;
+
+    for(i = 0; i < iterations; i++)
+    {
+        r = m4_rotation(0.001f * i, vec3(0.3f, 0.9f, 0.1f));
+        sink += (uint32_t)r.m[0][0];
+    }
+}
+
+static void bench_m4_mul_pos(void *ctx, long iterations)
+{
+    mat4_t m = m4_mul(m4_perspective(75.0f, 16.0f / 9.0f, 0.1f, 100.0f), m4_look_at(vec3(0.0f, 1.0f, 6.5f), vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f)));
+    vec3_t p = vec3(0.5f, 0.5f, 0.5f);
+    long i;
+
+    for(i = 0; i < iterations; i++)
+    {
+        p.x = i & 31;
+        sink += (uint32_t)m4_mul_pos(m, p).z;
+    }
+}
+
+static void run_math(void)
+{
+    run("m4_mul", bench_m4_mul, NULL);
+    run("m4_invert_affine", bench_m4_invert_affine, NULL);
+    run("m4_look_at", bench_m4_look_at, NULL);
+    run("m4_perspective", bench_m4_perspective, NULL);
+    run("m4_rotation", bench_m4_rotation, NULL);
+    run("m4_mul_pos", bench_m4_mul_pos, NULL);
+}
+
+
+/* every benchmark sits on its own line, which is what compare_baseline relies on */
+static int write_results(const char *path)
+{
+    int i;
+
+    FILE *f = fopen(path, "w");
+    if(f == NULL)
+    {
+        rafgl_log(RAFGL_ERROR, "Failed to open [%s] for the microbenchmark results!\n", path);
+        return -1;
+    }
+
+    fprintf(f, "{\n  \"commit\": \"%s\",\n  \"benchmarks\": {\n", RAFGL_BENCH_COMMIT);
+    for(i = 0; i < result_count; i++)
+    {
+        microbench_result_t *r = &results[i];
+        fprintf(f, "    \"%s\": {\"median_ns\": %.3f, \"min_ns\": %.3f, \"mean_ns\": %.3f, \"stddev_ns\": %.3f, \"p90_ns\": %.3f, \"iterations\": %ld, \"repetitions\": %d}%s\n",
+                r->name, r->median_ns, r->min_ns, r->mean_ns, r->stddev_ns, r->p90_ns, r->iterations, r->repetitions, i + 1 < result_count ? "," : "");
+    }
+    fprintf(f, "  }\n}\n");
+    fclose(f);
+
+    rafgl_log(RAFGL_INFO, "Microbenchmark results written to [%s]\n", path);
+    return 0;
+}
+
+/* compares medians, returns the number of benchmarks that got slower by more than threshold percent */
+static int compare_baseline(const char *path, double threshold)
+{
+    char line[512], name[64];
+    double base_median;
+    int i, regressions = 0;
+
+    FILE *f = fopen(path, "r");
+    if(f == NULL)
+    {
+        rafgl_log(RAFGL_ERROR, "Failed to open the baseline [%s]!\n", path);
+        return 0;
+    }
+
+    printf("\n%-36s %12s %12s %9s\n", "benchmark", "baseline", "current", "change");
+    while(fgets(line, sizeof(line), f))
+    {
+        if(sscanf(line, " \"%63[^\"]\": {\"median_ns\": %lf", name, &base_median) != 2) continue;
+
+        for(i = 0; i < result_count && strcmp(results[i].name, name); i++);
+        if(i == result_count) continue;
+
+        double change = base_median > 0.0 ? 100.0 * (results[i].median_ns - base_median) / base_median : 0.0;
+        const char *verdict = "";
+        if(change > threshold)
+        {
+            verdict = "  slower";
+            regressions++;
+        }
+        else if(change < -threshold)
+        {
+            verdict = "  faster";
+        }
+        printf("%-36s %10.1f ns %10.1f ns %+8.1f%%%s\n", name, base_median, results[i].median_ns, change, verdict);
+    }
+    fclose(f);
+
+    return regressions;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *out = "logs/microbench.json", *baseline = NULL;
+    double threshold = 5.0;
+    int i, regressions = 0;
+
+    for(i = 1; i < argc; i++)
+    {
+        if(!strcmp(argv[i], "--reps") && i + 1 < argc)
+            repetitions = rafgl_clampi(atoi(argv[++i]), 1, MICROBENCH_MAX_REPETITIONS);
+        else if(!strcmp(argv[i], "--filter") && i + 1 < argc)
+            filter = argv[++i];
+        else if(!strcmp(argv[i], "--out") && i + 1 < argc)
+            out = argv[++i];
+        else if(!strcmp(argv[i], "--baseline") && i + 1 < argc)
+            baseline = argv[++i];
+        else if(!strcmp(argv[i], "--threshold") && i + 1 < argc)
+            threshold = atof(argv[++i]);
+    }
+
+    /* the OBJ loader warns about fake uvs on every parse */
+    rafgl_log_set_level(RAFGL_ERROR);
+
+    run_obj_parse();
+    run_list();
+    run_raster();
+    run_math();
+
+    rafgl_log_set_level(RAFGL_INFO);
+    write_results(out);
+
+    if(baseline != NULL)
+    {
+        regressions = compare_baseline(baseline, threshold);
+        printf("%d benchmark(s) more than %.1f%% slower than the baseline\n", regressions, threshold);
+    }
+
+    return regressions ? 2 : 0;
+}
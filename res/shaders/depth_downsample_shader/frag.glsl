@@ -0,0 +1,16 @@
+#version 330
+
+out float linear_depth;
+
+// the previous level, the only one the texture exposes while this one is written
+uniform sampler2D depth_pyramid;
+
+void main()
+{
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+
+	// one of the four texels on a rotated grid instead of their average, so every level holds depths that exist in
+	// the scene and the chosen ones don't line up into a regular pattern
+	ivec2 source = pixel * 2 + ivec2(pixel.y & 1, pixel.x & 1);
+	linear_depth = texelFetch(depth_pyramid, min(source, textureSize(depth_pyramid, 0) - 1), 0).r;
+}
\ No newline at end of file
@@ -0,0 +1,16 @@
+#version 330
+
+// level 0 of the depth pyramid, the distance along the view direction
+out float linear_depth;
+
+uniform sampler2D g_depth;
+
+uniform mat4 uni_P;
+
+void main()
+{
+	float depth = texelFetch(g_depth, ivec2(gl_FragCoord.xy), 0).r;
+
+	// -z solved from the third and fourth rows of the projection, the cleared background lands on the far plane
+	linear_depth = uni_P[3][2] / (depth * 2.0 - 1.0 + uni_P[2][2]);
+}
\ No newline at end of file
@@ -1,13 +1,25 @@
 #version 330
 
-layout (location = 0) out vec3 g_position;
-layout (location = 1) out vec3 g_normal;
+// the position comes back from the depth buffer, only the normal is stored
+layout (location = 0) out vec2 g_normal;
+// how far the surface moved on screen since the last frame in xy, in texture coordinates, and its distance then in z
+layout (location = 1) out vec4 g_velocity;
 
-in vec3 pass_world_position;
 in vec3 pass_normal;
+in vec4 pass_clip;
+in vec4 pass_previous_clip;
+
+// octahedral encoding, the unit sphere folded onto [-1, 1]^2
+vec2 oct_encode(vec3 n)
+{
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	if(n.z < 0.0)
+		n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	return n.xy;
+}
 
 void main()
 {
-	g_position = pass_world_position;
-	g_normal = normalize(pass_normal);
+	g_normal = oct_encode(normalize(pass_normal));
+	g_velocity = vec4((pass_clip.xy / pass_clip.w - pass_previous_clip.xy / pass_previous_clip.w) * 0.5, pass_previous_clip.w, 0.0);
 }
\ No newline at end of file
@@ -5,20 +5,24 @@ layout (location = 1) in vec2 uv;
 layout (location = 2) in vec3 normal;
 
 out vec3 pass_normal;
-out vec3 pass_world_position;
+out vec4 pass_clip;
+out vec4 pass_previous_clip;
 
 
 uniform mat4 uni_M;
 uniform mat4 uni_VP;
+// where the vertex was last frame, only used while the velocity is written
+uniform mat4 uni_previous_M;
+uniform mat4 uni_previous_VP;
 
 
 void main()
 {
 	vec4 world_position = uni_M * vec4(position, 1.0);	
 	
-	pass_world_position = world_position.xyz;
-	
 	gl_Position = uni_VP * world_position;
+	pass_clip = gl_Position;
+	pass_previous_clip = uni_previous_VP * (uni_previous_M * vec4(position, 1.0));
 	
 	pass_normal = (uni_M * vec4(normal, 0.0)).xyz;
 }
\ No newline at end of file
@@ -0,0 +1,179 @@
+#version 330
+
+// AO in red and the pixel's distance in green, the same as ssao_shader so everything after it is shared
+out vec4 final_colour;
+
+// distance along the view direction, level 0 at full resolution and depth_mips levels above it
+uniform sampler2D depth_pyramid;
+uniform int depth_mips;
+// the pixel's own distance at the resolution being rendered, level 0 of the pyramid or its min/max downsample
+uniform sampler2D centre_depth;
+uniform sampler2D g_normal;
+
+uniform mat4 uni_P;
+uniform mat4 uni_V;
+
+uniform int sc_width;
+uniform int sc_height;
+
+// view space, occluders farther than this from the pixel fade out over the last part of it
+uniform float radius;
+// directions are spread over half a turn and each one is marched both ways, steps is per way
+uniform int slices;
+uniform int steps;
+// turns the slices and shifts the steps every temporal frame
+uniform float noise_rotation;
+// the G-buffer has no normals, they come from the depth around the pixel; only set at full resolution,
+// below it the downsample has already rebuilt them into g_normal
+uniform int depth_normals;
+
+#define PI 3.14159265
+#define HALF_PI 1.57079633
+// samples closer than 2^this pixels read level 0, every doubling of the distance after that one level higher
+#define LOG_MAX_OFFSET 3
+// the fraction of the radius occluders fade out over
+#define FALLOFF_RANGE 0.6
+// past this many pixels the march gets no longer, close to the camera the radius would cover most of the screen
+#define MAX_RADIUS_PIXELS 128.0
+
+vec3 oct_decode(vec2 e)
+{
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = clamp(-n.z, 0.0, 1.0);
+	n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+	return normalize(n);
+}
+
+// view space position of a pixel from its distance, the perspective projection inverted by hand with w = -z undoing the divide
+vec3 view_position_at(vec2 tex_coords, float view_distance)
+{
+	vec2 ndc = tex_coords * 2.0 - 1.0;
+	return vec3(view_distance * (ndc + vec2(uni_P[2][0], uni_P[2][1])) / vec2(uni_P[0][0], uni_P[1][1]), -view_distance);
+}
+
+// on each axis the side whose two taps extrapolate closest to the centre distance is on the same surface,
+// so the tangents never reach across a silhouette and edges keep their own normal
+vec3 normal_from_depth(ivec2 pixel, vec3 centre)
+{
+	vec2 texel = 1.0 / vec2(sc_width, sc_height);
+	vec2 tex_coords = (vec2(pixel) + 0.5) * texel;
+	ivec2 size = ivec2(sc_width, sc_height) - 1;
+
+	float l1 = texelFetch(centre_depth, clamp(pixel - ivec2(1, 0), ivec2(0), size), 0).r;
+	float l2 = texelFetch(centre_depth, clamp(pixel - ivec2(2, 0), ivec2(0), size), 0).r;
+	float r1 = texelFetch(centre_depth, clamp(pixel + ivec2(1, 0), ivec2(0), size), 0).r;
+	float r2 = texelFetch(centre_depth, clamp(pixel + ivec2(2, 0), ivec2(0), size), 0).r;
+	float d1 = texelFetch(centre_depth, clamp(pixel - ivec2(0, 1), ivec2(0), size), 0).r;
+	float d2 = texelFetch(centre_depth, clamp(pixel - ivec2(0, 2), ivec2(0), size), 0).r;
+	float u1 = texelFetch(centre_depth, clamp(pixel + ivec2(0, 1), ivec2(0), size), 0).r;
+	float u2 = texelFetch(centre_depth, clamp(pixel + ivec2(0, 2), ivec2(0), size), 0).r;
+
+	vec3 dx, dy;
+	float c = -centre.z;
+
+	if(abs(2.0 * l1 - l2 - c) < abs(2.0 * r1 - r2 - c))
+		dx = centre - view_position_at(tex_coords - vec2(texel.x, 0.0), l1);
+	else
+		dx = view_position_at(tex_coords + vec2(texel.x, 0.0), r1) - centre;
+
+	if(abs(2.0 * d1 - d2 - c) < abs(2.0 * u1 - u2 - c))
+		dy = centre - view_position_at(tex_coords - vec2(0.0, texel.y), d1);
+	else
+		dy = view_position_at(tex_coords + vec2(0.0, texel.y), u1) - centre;
+
+	return normalize(cross(dx, dy));
+}
+
+// 4x4 ordered dither, every 4x4 block gets all sixteen offsets and the blur averages them
+float dither(ivec2 pixel)
+{
+	const int bayer[16] = int[16](0, 8, 2, 10, 12, 4, 14, 6, 3, 11, 1, 9, 15, 7, 13, 5);
+	return (float(bayer[(pixel.x & 3) + (pixel.y & 3) * 4]) + 0.5) / 16.0;
+}
+
+// cosine of the highest horizon along one way of a slice, low_cos where nothing rises above the tangent plane
+float horizon_cos(vec3 view_position, vec3 view_dir, vec2 tex_coords, vec2 step_uv, float step_jitter, float low_cos)
+{
+	float highest = low_cos;
+	vec2 full_size = vec2(textureSize(depth_pyramid, 0));
+
+	for(int j = 0; j < steps; j++)
+	{
+		vec2 sample_uv = tex_coords + step_uv * (float(j) + step_jitter);
+
+		// far steps read a coarser level, the same as the hemisphere kernel, in full resolution pixels
+		float screen_distance = length((sample_uv - tex_coords) * full_size);
+		int mip = clamp(int(floor(log2(max(screen_distance, 1.0)))) - LOG_MAX_OFFSET, 0, depth_mips);
+		vec3 delta = view_position_at(sample_uv, textureLod(depth_pyramid, sample_uv, float(mip)).r) - view_position;
+
+		float len = length(delta);
+		float falloff = clamp((radius - len) / (radius * FALLOFF_RANGE), 0.0, 1.0);
+		highest = max(highest, mix(low_cos, dot(delta, view_dir) / len, falloff));
+	}
+
+	return highest;
+}
+
+// ground truth AO after Jimenez et al.: every slice finds the horizon on both sides of the pixel and integrates the
+// cosine weighted visible arc between them around the normal projected into the slice
+void main()
+{
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	vec2 tex_coords = (vec2(pixel) + 0.5) / vec2(sc_width, sc_height);
+
+	// the G-buffer is cleared to the far plane, nothing there occludes
+	float centre_distance = texelFetch(centre_depth, pixel, 0).r;
+	if(centre_distance >= uni_P[3][2] / (1.0 + uni_P[2][2]))
+	{
+		final_colour = vec4(1.0, centre_distance, 0.0, 1.0);
+		return;
+	}
+
+	vec3 view_position = view_position_at(tex_coords, centre_distance);
+	vec3 view_dir = normalize(-view_position);
+
+	// g_normal is in world space and the view matrix is rigid
+	vec3 view_normal;
+	if(depth_normals == 1)
+		view_normal = normal_from_depth(pixel, view_position);
+	else
+		view_normal = normalize(mat3(uni_V) * oct_decode(texture(g_normal, tex_coords).rg));
+
+	// the radius in pixels at this distance, the first step starts a pixel out so the pixel never finds itself
+	float radius_pixels = min(radius * uni_P[1][1] * 0.5 * float(sc_height) / centre_distance, MAX_RADIUS_PIXELS);
+	float step_pixels = max(radius_pixels - 1.0, 0.0) / float(steps);
+	float slice_jitter = dither(pixel);
+	float step_jitter = fract(dither(pixel.yx) + noise_rotation * 0.15915494);
+
+	float visibility = 0.0;
+	for(int i = 0; i < slices; i++)
+	{
+		float phi = (float(i) + slice_jitter) * PI / float(slices) + noise_rotation;
+		vec2 omega = vec2(cos(phi), sin(phi));
+		vec2 step_uv = omega * step_pixels / vec2(sc_width, sc_height);
+		vec2 first_uv = omega / vec2(sc_width, sc_height);
+
+		// the slice is the plane through the view direction and omega, the normal is measured in it from the view direction
+		vec3 direction = vec3(omega, 0.0);
+		vec3 ortho_direction = direction - dot(direction, view_dir) * view_dir;
+		vec3 axis = normalize(cross(ortho_direction, view_dir));
+		vec3 projected_normal = view_normal - axis * dot(view_normal, axis);
+		float projected_length = length(projected_normal);
+
+		float cos_n = clamp(dot(projected_normal, view_dir) / max(projected_length, 1e-4), -1.0, 1.0);
+		float n = sign(dot(ortho_direction, projected_normal)) * acos(cos_n);
+
+		float h1 = acos(horizon_cos(view_position, view_dir, tex_coords + first_uv, step_uv, step_jitter, cos(n + HALF_PI)));
+		float h0 = -acos(horizon_cos(view_position, view_dir, tex_coords - first_uv, -step_uv, step_jitter, cos(n - HALF_PI)));
+
+		// nothing behind the tangent plane counts
+		h0 = n + max(h0 - n, -HALF_PI);
+		h1 = n + min(h1 - n, HALF_PI);
+
+		float arc0 = cos_n + 2.0 * h0 * sin(n) - cos(2.0 * h0 - n);
+		float arc1 = cos_n + 2.0 * h1 * sin(n) - cos(2.0 * h1 - n);
+		visibility += projected_length * 0.25 * (arc0 + arc1);
+	}
+
+	final_colour = vec4(clamp(visibility / float(slices), 0.0, 1.0), centre_distance, 0.0, 1.0);
+}
\ No newline at end of file
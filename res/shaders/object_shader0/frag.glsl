@@ -13,18 +13,73 @@ uniform vec3 uni_ambient;
 uniform vec3 uni_camera_position;
 
 uniform int off_ssao;
+// the G-buffer normal wasn't written, the interpolated vertex normal stands in
+uniform int depth_normals;
 uniform int sc_width;
 uniform int sc_height;
 
-uniform sampler2D g_position;
 uniform sampler2D g_normal;
+// AO in red and the distance it was computed for in green
 uniform sampler2D ssao_tex;
 
+// 1, 2 or 4, above 1 ssao_tex is that many times smaller on each axis and comes with the normal each of its texels
+// was computed for
+uniform int ssao_resolution;
+uniform sampler2D depth_pyramid;
+uniform sampler2D ssao_normal;
+
+vec3 oct_decode(vec2 e)
+{
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = clamp(-n.z, 0.0, 1.0);
+	n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+	return normalize(n);
+}
+
+// joint bilateral upsample, the four low resolution texels around the pixel keep their bilinear weight only as far
+// as their distance and normal match the pixel's, so AO of the background doesn't bleed onto the mesh and back
+float upsample_ssao(vec3 normal)
+{
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	float pixel_distance = texelFetch(depth_pyramid, pixel, 0).r;
+
+	vec2 low_position = (vec2(pixel) + 0.5) / float(ssao_resolution) - 0.5;
+	ivec2 low_pixel = ivec2(floor(low_position));
+	vec2 f = low_position - vec2(low_pixel);
+	ivec2 size = textureSize(ssao_tex, 0) - 1;
+
+	float occlusion = 0.0, total_weight = 0.0;
+	for(int i = 0; i < 4; i++)
+	{
+		ivec2 corner = ivec2(i & 1, i >> 1);
+		ivec2 texel = clamp(low_pixel + corner, ivec2(0), size);
+
+		vec2 bilinear = mix(1.0 - f, f, vec2(corner));
+		vec2 low = texelFetch(ssao_tex, texel, 0).rg;
+		float weight = bilinear.x * bilinear.y / (0.001 + abs(low.g - pixel_distance) / pixel_distance);
+
+		// without g_normal the downsample had no normals to keep
+		if(depth_normals == 0)
+			weight *= pow(max(dot(oct_decode(texelFetch(ssao_normal, texel, 0).rg), normal), 0.0), 8.0);
+
+		weight += 1e-5;
+		occlusion += low.r * weight;
+		total_weight += weight;
+	}
+
+	return occlusion / total_weight;
+}
+
 void main()
 {
-	vec3 world_position = texture(g_position, vec2(gl_FragCoord.x / sc_width, gl_FragCoord.y / sc_height)).rgb;
-	vec3 normal = texture(g_normal, vec2(gl_FragCoord.x / sc_width, gl_FragCoord.y / sc_height)).rgb;
-	vec3 ssao_val = texture(ssao_tex, vec2(gl_FragCoord.x / sc_width, gl_FragCoord.y / sc_height)).rgb * 0.3;
+	// the same surface the G-buffer kept at this pixel, so its position needs no lookup
+	vec3 world_position = pass_world_position;
+	vec3 normal = depth_normals == 1 ? pass_normal : oct_decode(texture(g_normal, vec2(gl_FragCoord.x / sc_width, gl_FragCoord.y / sc_height)).rg);
+	vec3 ssao_val;
+	if(ssao_resolution > 1)
+		ssao_val = vec3(upsample_ssao(normalize(normal))) * 0.3;
+	else
+		ssao_val = vec3(texture(ssao_tex, vec2(gl_FragCoord.x / sc_width, gl_FragCoord.y / sc_height)).r) * 0.3;
 
 	if(off_ssao == 1)
 		ssao_val = uni_ambient;
@@ -2,20 +2,49 @@
 
 out vec4 final_colour;
 
+// AO in red and the distance along the view direction in green, written back the same way
 uniform sampler2D tex;
 
-uniform int sc_width;
-uniform int sc_height;
+// taps on each side of the pixel
+uniform int blur_radius;
+// the first pass blurs along x, the second along y
+uniform int vertical;
+
+// how far off the pixel's plane a tap can be, relative to the pixel's distance, before its weight drops to 1/e
+#define DEPTH_TOLERANCE 0.02
 
 void main()
 {
-	vec2 tex_coords = vec2(gl_FragCoord.x / sc_width, gl_FragCoord.y / sc_height);
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	ivec2 size = textureSize(tex, 0) - 1;
+	ivec2 direction = vertical == 1 ? ivec2(0, 1) : ivec2(1, 0);
+
+	vec2 centre = texelFetch(tex, pixel, 0).rg;
+	vec2 before = texelFetch(tex, clamp(pixel - direction, ivec2(0), size), 0).rg;
+	vec2 after = texelFetch(tex, clamp(pixel + direction, ivec2(0), size), 0).rg;
+
+	// the slope of the surface along the blur, from whichever neighbour is closer so it never comes from across an edge,
+	// taps on a plane tilted away from the camera are then kept as well as ones facing it
+	float slope = abs(after.g - centre.g) < abs(centre.g - before.g) ? after.g - centre.g : centre.g - before.g;
+
+	float sigma = float(blur_radius) * 0.5 + 0.5;
+	float falloff = 1.0 / (2.0 * sigma * sigma);
+	float sharpness = 1.0 / (DEPTH_TOLERANCE * DEPTH_TOLERANCE * centre.g * centre.g);
+
+	float occlusion = centre.r, total_weight = 1.0;
+	for(int i = 1; i <= blur_radius; i++)
+	{
+		vec2 tap_before = i == 1 ? before : texelFetch(tex, clamp(pixel - direction * i, ivec2(0), size), 0).rg;
+		vec2 tap_after = i == 1 ? after : texelFetch(tex, clamp(pixel + direction * i, ivec2(0), size), 0).rg;
 
-    float result = 0.0;
+		float off_before = tap_before.g - (centre.g - slope * float(i));
+		float off_after = tap_after.g - (centre.g + slope * float(i));
+		float weight_before = exp(-float(i * i) * falloff - off_before * off_before * sharpness);
+		float weight_after = exp(-float(i * i) * falloff - off_after * off_after * sharpness);
 
-    for (int x = -2; x < 2; ++x) 
-        for (int y = -2; y < 2; ++y) 
-            result += texture(tex, vec2(tex_coords.x + float(x) / sc_width, tex_coords.y + float(y) / sc_height)).r;
+		occlusion += tap_before.r * weight_before + tap_after.r * weight_after;
+		total_weight += weight_before + weight_after;
+	}
 
-    final_colour = vec4(vec3(result / (4.0 * 4.0)), 1.0);
+	final_colour = vec4(occlusion / total_weight, centre.g, 0.0, 1.0);
 }
\ No newline at end of file
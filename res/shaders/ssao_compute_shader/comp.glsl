@@ -0,0 +1,257 @@
+#version 430
+
+// the kernel SSAO and both blur passes in one dispatch: every workgroup loads the distance around its tile into
+// shared memory once, computes AO for the tile and the pixels the blur reaches past it, and blurs it along x and
+// then along y without the AO leaving shared memory; the result is the same as ssao_shader followed by ssao_blur_shader
+layout(local_size_x = 16, local_size_y = 16) in;
+
+// AO in red and the distance in green, like the blur passes write it
+layout(rg16f, binding = 0) uniform writeonly image2D blur_image;
+
+// MAIN_STATE_MAX_KERNEL_SAMPLES, kernel_samples of them are used
+uniform vec3 samples[128];
+uniform int kernel_samples;
+
+// distance along the view direction, level 0 at full resolution and depth_mips levels above it
+uniform sampler2D depth_pyramid;
+uniform int depth_mips;
+// the pixel's own distance at the resolution being rendered, level 0 of the pyramid or its min/max downsample
+uniform sampler2D centre_depth;
+uniform sampler2D g_normal;
+uniform sampler2D noise_tex;
+// centre_depth is level 0 of the pyramid, so the near samples can read the shared tile too
+uniform int full_resolution;
+
+uniform mat4 uni_P;
+uniform mat4 uni_V;
+
+uniform int sc_width;
+uniform int sc_height;
+
+uniform float radius;
+uniform float bias;
+uniform int noise_size;
+// the G-buffer has no normals, they come from the depth around the pixel; only set at full resolution,
+// below it the downsample has already rebuilt them into g_normal
+uniform int depth_normals;
+
+// taps on each side of the pixel, at most BLUR_APRON
+uniform int blur_radius;
+
+// output pixels a workgroup writes on each axis, four per invocation
+#define TILE 32
+#define THREADS 256
+// MAIN_STATE_MAX_BLUR_RADIUS, AO is computed this far past the tile at most
+#define BLUR_APRON 8
+// the distance is loaded this far past the tile, the AO's reach plus the two pixels its normals read on each side;
+// samples at level 0 that land inside read it from there too
+#define DEPTH_APRON 10
+#define DEPTH_SIZE (TILE + 2 * DEPTH_APRON)
+#define AO_SIZE (TILE + 2 * BLUR_APRON)
+
+// samples closer than 2^this pixels read level 0, every doubling of the distance after that one level higher
+#define LOG_MAX_OFFSET 3
+// how far off the pixel's plane a tap can be, relative to the pixel's distance, before its weight drops to 1/e
+#define DEPTH_TOLERANCE 0.02
+
+shared float depth_tile[DEPTH_SIZE * DEPTH_SIZE];
+// AO and distance as two halves, the precision the fragment passes keep them at between passes
+shared uint ao_tile[AO_SIZE * AO_SIZE];
+// the horizontal blur of the tile's columns, for every row of the AO
+shared uint horizontal_tile[TILE * AO_SIZE];
+
+ivec2 depth_origin;
+
+vec3 oct_decode(vec2 e)
+{
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = clamp(-n.z, 0.0, 1.0);
+	n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+	return normalize(n);
+}
+
+// the distance at a pixel of centre_depth, clamped to the edge like the fragment passes read it
+float distance_at(ivec2 pixel)
+{
+	ivec2 local = pixel - depth_origin;
+
+	if(all(greaterThanEqual(local, ivec2(0))) && all(lessThan(local, ivec2(DEPTH_SIZE))))
+		return depth_tile[local.y * DEPTH_SIZE + local.x];
+
+	return texelFetch(centre_depth, clamp(pixel, ivec2(0), ivec2(sc_width, sc_height) - 1), 0).r;
+}
+
+// view space position of a pixel from its distance, the perspective projection inverted by hand with w = -z undoing the divide
+vec3 view_position_at(vec2 tex_coords, float view_distance)
+{
+	vec2 ndc = tex_coords * 2.0 - 1.0;
+	return vec3(view_distance * (ndc + vec2(uni_P[2][0], uni_P[2][1])) / vec2(uni_P[0][0], uni_P[1][1]), -view_distance);
+}
+
+// on each axis the side whose two taps extrapolate closest to the centre distance is on the same surface,
+// so the tangents never reach across a silhouette and edges keep their own normal
+vec3 normal_from_depth(ivec2 pixel, vec3 centre)
+{
+	vec2 texel = 1.0 / vec2(sc_width, sc_height);
+	vec2 tex_coords = (vec2(pixel) + 0.5) * texel;
+
+	float l1 = distance_at(pixel - ivec2(1, 0));
+	float l2 = distance_at(pixel - ivec2(2, 0));
+	float r1 = distance_at(pixel + ivec2(1, 0));
+	float r2 = distance_at(pixel + ivec2(2, 0));
+	float d1 = distance_at(pixel - ivec2(0, 1));
+	float d2 = distance_at(pixel - ivec2(0, 2));
+	float u1 = distance_at(pixel + ivec2(0, 1));
+	float u2 = distance_at(pixel + ivec2(0, 2));
+
+	vec3 dx, dy;
+	float c = -centre.z;
+
+	if(abs(2.0 * l1 - l2 - c) < abs(2.0 * r1 - r2 - c))
+		dx = centre - view_position_at(tex_coords - vec2(texel.x, 0.0), l1);
+	else
+		dx = view_position_at(tex_coords + vec2(texel.x, 0.0), r1) - centre;
+
+	if(abs(2.0 * d1 - d2 - c) < abs(2.0 * u1 - u2 - c))
+		dy = centre - view_position_at(tex_coords - vec2(0.0, texel.y), d1);
+	else
+		dy = view_position_at(tex_coords + vec2(0.0, texel.y), u1) - centre;
+
+	return normalize(cross(dx, dy));
+}
+
+// ssao_shader's AO and distance for one pixel, without the temporal rotation and layers
+vec2 ao_at(ivec2 pixel)
+{
+	vec2 noise_scale = vec2(sc_width, sc_height) / float(noise_size);
+	vec2 tex_coords = (vec2(pixel) + 0.5) / vec2(sc_width, sc_height);
+
+	// the G-buffer is cleared to the far plane, nothing there occludes
+	float centre_distance = distance_at(pixel);
+	if(centre_distance >= uni_P[3][2] / (1.0 + uni_P[2][2]))
+		return vec2(1.0, centre_distance);
+
+	vec3 view_position = view_position_at(tex_coords, centre_distance);
+
+	// g_normal is in world space and the view matrix is rigid
+	vec3 view_normal;
+	if(depth_normals == 1)
+		view_normal = normal_from_depth(pixel, view_position);
+	else
+		view_normal = normalize(mat3(uni_V) * oct_decode(textureLod(g_normal, tex_coords, 0.0).rg));
+
+	vec3 random_vec = normalize(textureLod(noise_tex, tex_coords * noise_scale, 0.0).xyz);
+
+	vec3 tangent   = normalize(random_vec - view_normal * dot(random_vec, view_normal));
+	vec3 bitangent = cross(view_normal, tangent);
+	mat3 TBN       = mat3(tangent, bitangent, view_normal);
+
+	vec2 pyramid_size = vec2(textureSize(depth_pyramid, 0));
+
+	float occlusion = 0.0;
+	for(int i = 0; i < kernel_samples; ++i)
+	{
+		vec3 sample_pos = view_position + TBN * samples[i] * radius;
+
+		vec4 offset = uni_P * vec4(sample_pos, 1.0);
+		offset.xyz /= offset.w;
+		offset.xyz  = offset.xyz * 0.5 + 0.5;
+
+		// far samples read a coarser level, in full resolution pixels like ssao_shader
+		float screen_distance = length((offset.xy - tex_coords) * pyramid_size);
+		int mip = clamp(int(floor(log2(max(screen_distance, 1.0)))) - LOG_MAX_OFFSET, 0, depth_mips);
+		// the texel nearest filtering picks, clamped to the edge
+		float sample_depth = -(full_resolution == 1 && mip == 0 ? distance_at(ivec2(floor(offset.xy * pyramid_size))) : textureLod(depth_pyramid, offset.xy, float(mip)).r);
+
+		float range_check = smoothstep(0.0, 1.0, radius / abs(view_position.z - sample_depth));
+		occlusion += (sample_depth >= sample_pos.z + bias ? 1.0 : 0.0) * range_check;
+	}
+
+	return vec2(1.0 - occlusion / kernel_samples, centre_distance);
+}
+
+// a tap of the AO blurring along x, or of the horizontal blur along y, at its place in the shared tile
+vec2 blur_tap(bool vertical, ivec2 local)
+{
+	return unpackHalf2x16(vertical ? horizontal_tile[local.y * TILE + local.x] : ao_tile[local.y * AO_SIZE + local.x]);
+}
+
+// ssao_blur_shader for one pixel, the tiles hold the clamped pixels past the edge, so the taps don't need clamping
+vec2 blur_at(bool vertical, ivec2 local)
+{
+	ivec2 direction = vertical ? ivec2(0, 1) : ivec2(1, 0);
+
+	vec2 centre = blur_tap(vertical, local);
+	vec2 before = blur_tap(vertical, local - direction);
+	vec2 after = blur_tap(vertical, local + direction);
+
+	float slope = abs(after.g - centre.g) < abs(centre.g - before.g) ? after.g - centre.g : centre.g - before.g;
+
+	float sigma = float(blur_radius) * 0.5 + 0.5;
+	float falloff = 1.0 / (2.0 * sigma * sigma);
+	float sharpness = 1.0 / (DEPTH_TOLERANCE * DEPTH_TOLERANCE * centre.g * centre.g);
+
+	float occlusion = centre.r, total_weight = 1.0;
+	for(int i = 1; i <= blur_radius; i++)
+	{
+		vec2 tap_before = i == 1 ? before : blur_tap(vertical, local - direction * i);
+		vec2 tap_after = i == 1 ? after : blur_tap(vertical, local + direction * i);
+
+		float off_before = tap_before.g - (centre.g - slope * float(i));
+		float off_after = tap_after.g - (centre.g + slope * float(i));
+		float weight_before = exp(-float(i * i) * falloff - off_before * off_before * sharpness);
+		float weight_after = exp(-float(i * i) * falloff - off_after * off_after * sharpness);
+
+		occlusion += tap_before.r * weight_before + tap_after.r * weight_after;
+		total_weight += weight_before + weight_after;
+	}
+
+	return vec2(occlusion / total_weight, centre.g);
+}
+
+void main()
+{
+	ivec2 size = ivec2(sc_width, sc_height) - 1;
+	ivec2 tile_origin = ivec2(gl_WorkGroupID.xy) * TILE;
+	int thread = int(gl_LocalInvocationIndex);
+
+	// the blur needs a neighbour on each side for its slope even without taps
+	int reach = clamp(blur_radius, 1, BLUR_APRON);
+	int region = TILE + 2 * reach;
+	ivec2 region_origin = tile_origin - reach;
+
+	depth_origin = tile_origin - DEPTH_APRON;
+	for(int i = thread; i < DEPTH_SIZE * DEPTH_SIZE; i += THREADS)
+	{
+		ivec2 pixel = depth_origin + ivec2(i % DEPTH_SIZE, i / DEPTH_SIZE);
+		depth_tile[i] = texelFetch(centre_depth, clamp(pixel, ivec2(0), size), 0).r;
+	}
+	memoryBarrierShared();
+	barrier();
+
+	// pixels past the edge repeat the one at the edge, the same as the clamped taps of the blur passes
+	for(int i = thread; i < region * region; i += THREADS)
+	{
+		ivec2 local = ivec2(i % region, i / region);
+		ao_tile[local.y * AO_SIZE + local.x] = packHalf2x16(ao_at(clamp(region_origin + local, ivec2(0), size)));
+	}
+	memoryBarrierShared();
+	barrier();
+
+	for(int i = thread; i < TILE * region; i += THREADS)
+	{
+		ivec2 local = ivec2(i % TILE, i / TILE);
+		horizontal_tile[local.y * TILE + local.x] = packHalf2x16(blur_at(false, local + ivec2(reach, 0)));
+	}
+	memoryBarrierShared();
+	barrier();
+
+	for(int i = thread; i < TILE * TILE; i += THREADS)
+	{
+		ivec2 local = ivec2(i % TILE, i / TILE);
+		ivec2 pixel = tile_origin + local;
+
+		if(all(lessThanEqual(pixel, size)))
+			imageStore(blur_image, pixel, vec4(blur_at(true, local + ivec2(0, reach)), 0.0, 1.0));
+	}
+}
\ No newline at end of file
@@ -0,0 +1,37 @@
+#version 330
+
+// eight of the sixteen layers a draw, no more than every implementation can render to at once
+layout(location = 0) out float layer_distance0;
+layout(location = 1) out float layer_distance1;
+layout(location = 2) out float layer_distance2;
+layout(location = 3) out float layer_distance3;
+layout(location = 4) out float layer_distance4;
+layout(location = 5) out float layer_distance5;
+layout(location = 6) out float layer_distance6;
+layout(location = 7) out float layer_distance7;
+
+// the distance at the resolution AO is rendered at, level 0 of the pyramid or its min/max downsample
+uniform sampler2D centre_depth;
+// 0 or 8, the first of the layers this draw writes
+uniform int first_layer;
+
+// layer l of a layer pixel holds the pixel at (l % 4, l / 4) of its 4x4 block, the edge repeats past the last block
+float block_distance(int layer)
+{
+	ivec2 size = textureSize(centre_depth, 0) - 1;
+	ivec2 pixel = ivec2(gl_FragCoord.xy) * 4 + ivec2(layer & 3, layer >> 2);
+
+	return texelFetch(centre_depth, min(pixel, size), 0).r;
+}
+
+void main()
+{
+	layer_distance0 = block_distance(first_layer + 0);
+	layer_distance1 = block_distance(first_layer + 1);
+	layer_distance2 = block_distance(first_layer + 2);
+	layer_distance3 = block_distance(first_layer + 3);
+	layer_distance4 = block_distance(first_layer + 4);
+	layer_distance5 = block_distance(first_layer + 5);
+	layer_distance6 = block_distance(first_layer + 6);
+	layer_distance7 = block_distance(first_layer + 7);
+}
\ No newline at end of file
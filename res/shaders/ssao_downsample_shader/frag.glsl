@@ -0,0 +1,100 @@
+#version 330
+
+layout(location = 0) out float low_distance;
+layout(location = 1) out vec2 low_normal;
+
+// distance along the view direction, only level 0 is read
+uniform sampler2D depth_pyramid;
+uniform sampler2D g_normal;
+// full resolution pixels per low resolution pixel on each axis
+uniform int factor;
+// the G-buffer has no normals, the picked pixel's normal comes from the full resolution depth around it instead,
+// the low resolution distances alternate between the near and the far side and would give a zig-zag
+uniform int depth_normals;
+
+uniform mat4 uni_P;
+uniform mat4 uni_V;
+
+// octahedral encoding, the unit sphere folded onto [-1, 1]^2
+vec2 oct_encode(vec3 n)
+{
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	if(n.z < 0.0)
+		n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	return n.xy;
+}
+
+// view space position of a pixel from its distance, the perspective projection inverted by hand with w = -z undoing the divide
+vec3 view_position_at(vec2 tex_coords, float view_distance)
+{
+	vec2 ndc = tex_coords * 2.0 - 1.0;
+	return vec3(view_distance * (ndc + vec2(uni_P[2][0], uni_P[2][1])) / vec2(uni_P[0][0], uni_P[1][1]), -view_distance);
+}
+
+// the same reconstruction the AO passes do at full resolution: on each axis the side whose two taps extrapolate
+// closest to the centre distance is on the same surface
+vec3 normal_from_depth(ivec2 pixel, float c)
+{
+	ivec2 size = textureSize(depth_pyramid, 0);
+	vec2 texel = 1.0 / vec2(size);
+	vec2 tex_coords = (vec2(pixel) + 0.5) * texel;
+	vec3 centre = view_position_at(tex_coords, c);
+	size -= 1;
+
+	float l1 = texelFetch(depth_pyramid, clamp(pixel - ivec2(1, 0), ivec2(0), size), 0).r;
+	float l2 = texelFetch(depth_pyramid, clamp(pixel - ivec2(2, 0), ivec2(0), size), 0).r;
+	float r1 = texelFetch(depth_pyramid, clamp(pixel + ivec2(1, 0), ivec2(0), size), 0).r;
+	float r2 = texelFetch(depth_pyramid, clamp(pixel + ivec2(2, 0), ivec2(0), size), 0).r;
+	float d1 = texelFetch(depth_pyramid, clamp(pixel - ivec2(0, 1), ivec2(0), size), 0).r;
+	float d2 = texelFetch(depth_pyramid, clamp(pixel - ivec2(0, 2), ivec2(0), size), 0).r;
+	float u1 = texelFetch(depth_pyramid, clamp(pixel + ivec2(0, 1), ivec2(0), size), 0).r;
+	float u2 = texelFetch(depth_pyramid, clamp(pixel + ivec2(0, 2), ivec2(0), size), 0).r;
+
+	vec3 dx, dy;
+
+	if(abs(2.0 * l1 - l2 - c) < abs(2.0 * r1 - r2 - c))
+		dx = centre - view_position_at(tex_coords - vec2(texel.x, 0.0), l1);
+	else
+		dx = view_position_at(tex_coords + vec2(texel.x, 0.0), r1) - centre;
+
+	if(abs(2.0 * d1 - d2 - c) < abs(2.0 * u1 - u2 - c))
+		dy = centre - view_position_at(tex_coords - vec2(0.0, texel.y), d1);
+	else
+		dy = view_position_at(tex_coords + vec2(0.0, texel.y), u1) - centre;
+
+	return normalize(cross(dx, dy));
+}
+
+// neighbouring pixels alternate between the nearest and the farthest distance of their footprint, so both sides
+// of a silhouette survive where an average would make up a surface in between, the normal is the picked pixel's
+void main()
+{
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	ivec2 size = textureSize(depth_pyramid, 0) - 1;
+	bool nearest = ((pixel.x + pixel.y) & 1) == 0;
+
+	ivec2 picked = min(pixel * factor, size);
+	float picked_distance = texelFetch(depth_pyramid, picked, 0).r;
+
+	for(int y = 0; y < factor; y++)
+	{
+		for(int x = 0; x < factor; x++)
+		{
+			ivec2 source = min(pixel * factor + ivec2(x, y), size);
+			float source_distance = texelFetch(depth_pyramid, source, 0).r;
+
+			if(nearest ? source_distance < picked_distance : source_distance > picked_distance)
+			{
+				picked = source;
+				picked_distance = source_distance;
+			}
+		}
+	}
+
+	low_distance = picked_distance;
+	// stored in world space like the G-buffer's, the view matrix is rigid so its transpose undoes it
+	if(depth_normals == 1)
+		low_normal = oct_encode(transpose(mat3(uni_V)) * normal_from_depth(picked, picked_distance));
+	else
+		low_normal = texelFetch(g_normal, picked, 0).rg;
+}
\ No newline at end of file
@@ -0,0 +1,15 @@
+#version 330
+
+out vec4 final_colour;
+
+// AO and distance of every layer, a quarter of the target on each axis
+uniform sampler2DArray layer_ao;
+
+// every pixel back from the layer its place in the 4x4 block went to
+void main()
+{
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	ivec2 phase = pixel & 3;
+
+	final_colour = vec4(texelFetch(layer_ao, ivec3(pixel >> 2, phase.x + phase.y * 4), 0).rg, 0.0, 1.0);
+}
\ No newline at end of file
@@ -1,47 +1,141 @@
 #version 330
 
+// AO in red and the pixel's distance in green, so the blur gets both from one fetch
 out vec4 final_colour;
 
-uniform vec3 samples[64];
-
-uniform sampler2D g_position;
+// MAIN_STATE_MAX_KERNEL_SAMPLES, kernel_samples of them are used
+uniform vec3 samples[128];
+uniform int kernel_samples;
+// this frame uses frame_samples of them from first_sample on, wrapping around, and turns the noise by noise_rotation,
+// so temporal accumulation sees a different set every frame
+uniform int first_sample;
+uniform int frame_samples;
+uniform float noise_rotation;
+
+// distance along the view direction, level 0 at full resolution and depth_mips levels above it
+uniform sampler2D depth_pyramid;
+uniform int depth_mips;
+// the pixel's own distance at the resolution being rendered, level 0 of the pyramid or its min/max downsample
+uniform sampler2D centre_depth;
 uniform sampler2D g_normal;
 uniform sampler2D noise_tex;
+// deinterleaved, this draw renders layer (0 to 15) of the target split by place in each 4x4 block, -1 renders it whole;
+// every pixel of a layer has the same rotation and neighbours a few texels apart read neighbouring layer texels
+uniform int layer;
+uniform sampler2DArray layer_depth;
+// the pyramid level as coarse as the layers, samples that would read a finer one read the layer instead
+uniform int layer_mip;
 
-uniform mat4 uni_M;
 uniform mat4 uni_P;
 uniform mat4 uni_V;
 
 uniform int sc_width;
 uniform int sc_height;
 
-const float radius = 0.5;
-const float bias = 0.025;
+uniform float radius;
+uniform float bias;
+uniform int noise_size;
+// the G-buffer has no normals, they come from the depth around the pixel; only set at full resolution,
+// below it the downsample has already rebuilt them into g_normal
+uniform int depth_normals;
 
-void main()
+vec3 oct_decode(vec2 e)
 {
-	vec2 noise_scale = vec2(sc_width/4.0, sc_height/4.0);
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = clamp(-n.z, 0.0, 1.0);
+	n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+	return normalize(n);
+}
 
-	vec2 tex_coords = vec2(gl_FragCoord.x / sc_width, gl_FragCoord.y / sc_height);
+// samples closer than 2^this pixels read level 0, every doubling of the distance after that one level higher
+#define LOG_MAX_OFFSET 3
 
-	vec3 world_position = texture(g_position, tex_coords).xyz;
-	vec3 view_position = (uni_V * vec4(world_position, 1.0)).xyz;
+// view space position of a pixel from its distance, the perspective projection inverted by hand with w = -z undoing the divide
+vec3 view_position_at(vec2 tex_coords, float view_distance)
+{
+	vec2 ndc = tex_coords * 2.0 - 1.0;
+	return vec3(view_distance * (ndc + vec2(uni_P[2][0], uni_P[2][1])) / vec2(uni_P[0][0], uni_P[1][1]), -view_distance);
+}
 
-	vec3 normal = normalize(texture(g_normal, tex_coords).rgb);
-	
-	mat3 normal_matrix = transpose(inverse(mat3(uni_V * uni_M)));
-    vec3 view_normal = normalize(normal_matrix * normal);
+// on each axis the side whose two taps extrapolate closest to the centre distance is on the same surface,
+// so the tangents never reach across a silhouette and edges keep their own normal
+vec3 normal_from_depth(ivec2 pixel, vec3 centre)
+{
+	vec2 texel = 1.0 / vec2(sc_width, sc_height);
+	vec2 tex_coords = (vec2(pixel) + 0.5) * texel;
+	ivec2 size = ivec2(sc_width, sc_height) - 1;
+
+	float l1 = texelFetch(centre_depth, clamp(pixel - ivec2(1, 0), ivec2(0), size), 0).r;
+	float l2 = texelFetch(centre_depth, clamp(pixel - ivec2(2, 0), ivec2(0), size), 0).r;
+	float r1 = texelFetch(centre_depth, clamp(pixel + ivec2(1, 0), ivec2(0), size), 0).r;
+	float r2 = texelFetch(centre_depth, clamp(pixel + ivec2(2, 0), ivec2(0), size), 0).r;
+	float d1 = texelFetch(centre_depth, clamp(pixel - ivec2(0, 1), ivec2(0), size), 0).r;
+	float d2 = texelFetch(centre_depth, clamp(pixel - ivec2(0, 2), ivec2(0), size), 0).r;
+	float u1 = texelFetch(centre_depth, clamp(pixel + ivec2(0, 1), ivec2(0), size), 0).r;
+	float u2 = texelFetch(centre_depth, clamp(pixel + ivec2(0, 2), ivec2(0), size), 0).r;
+
+	vec3 dx, dy;
+	float c = -centre.z;
+
+	if(abs(2.0 * l1 - l2 - c) < abs(2.0 * r1 - r2 - c))
+		dx = centre - view_position_at(tex_coords - vec2(texel.x, 0.0), l1);
+	else
+		dx = view_position_at(tex_coords + vec2(texel.x, 0.0), r1) - centre;
+
+	if(abs(2.0 * d1 - d2 - c) < abs(2.0 * u1 - u2 - c))
+		dy = centre - view_position_at(tex_coords - vec2(0.0, texel.y), d1);
+	else
+		dy = view_position_at(tex_coords + vec2(0.0, texel.y), u1) - centre;
+
+	return normalize(cross(dx, dy));
+}
+
+// the layer's pixel nearest to a sample, its centre is 4 * texel + phase + 0.5 at the target's resolution
+float layer_distance_at(vec2 tex_coords, ivec2 phase)
+{
+	ivec2 size = textureSize(layer_depth, 0).xy - 1;
+	ivec2 texel = ivec2(floor((tex_coords * vec2(sc_width, sc_height) - vec2(phase) + 1.5) * 0.25));
+
+	return texelFetch(layer_depth, ivec3(clamp(texel, ivec2(0), size), layer), 0).r;
+}
 
-	vec3 random_vec = normalize(texture(noise_tex, tex_coords * noise_scale).xyz);
+void main()
+{
+	vec2 noise_scale = vec2(sc_width, sc_height) / float(noise_size);
+
+	ivec2 phase = ivec2(layer & 3, layer >> 2);
+	ivec2 pixel = layer < 0 ? ivec2(gl_FragCoord.xy) : ivec2(gl_FragCoord.xy) * 4 + phase;
+	vec2 tex_coords = (vec2(pixel) + 0.5) / vec2(sc_width, sc_height);
+
+	// the G-buffer is cleared to the far plane, nothing there occludes
+	float centre_distance = layer < 0 ? texelFetch(centre_depth, pixel, 0).r : texelFetch(layer_depth, ivec3(gl_FragCoord.xy, layer), 0).r;
+	if(centre_distance >= uni_P[3][2] / (1.0 + uni_P[2][2]))
+	{
+		final_colour = vec4(1.0, centre_distance, 0.0, 1.0);
+		return;
+	}
+
+	vec3 view_position = view_position_at(tex_coords, centre_distance);
+
+	// g_normal is in world space and the view matrix is rigid
+	vec3 view_normal;
+	if(depth_normals == 1)
+		view_normal = normal_from_depth(pixel, view_position);
+	else
+		view_normal = normalize(mat3(uni_V) * oct_decode(texture(g_normal, tex_coords).rg));
+
+	// a layer's phase is its pixels' place in the noise too when the noise is 4x4, so the rotations are the same as without layers
+	vec3 random_vec = normalize(layer < 0 ? texture(noise_tex, tex_coords * noise_scale).xyz : texelFetch(noise_tex, phase % noise_size, 0).xyz);
+	random_vec.xy = mat2(cos(noise_rotation), sin(noise_rotation), -sin(noise_rotation), cos(noise_rotation)) * random_vec.xy;
 	
 	vec3 tangent   = normalize(random_vec - view_normal * dot(random_vec, view_normal));
 	vec3 bitangent = cross(view_normal, tangent);
 	mat3 TBN       = mat3(tangent, bitangent, view_normal);  
 
 	float occlusion = 0.0;
-	for(int i = 0; i < 64; ++i)
+	for(int i = 0; i < frame_samples; ++i)
 	{
-		vec3 sample_pos = TBN * samples[i]; // from tangent to view-space
+		vec3 sample_pos = TBN * samples[(first_sample + i) % kernel_samples]; // from tangent to view-space
 		sample_pos = view_position + sample_pos * radius; 
 		
 		vec4 offset = vec4(sample_pos, 1.0);
@@ -49,15 +143,16 @@ void main()
 		offset.xyz /= offset.w;               // perspective divide
 		offset.xyz  = offset.xyz * 0.5 + 0.5; // transform to range 0.0 - 1.0  
 
-		vec3 sample_world = texture(g_position, offset.xy).xyz;
-		vec3 sample_view = (uni_V * vec4(sample_world, 1.0)).xyz;
-
-		float sample_depth = sample_view.z; 
+		// far samples read a coarser level, neighbouring pixels then land on the same texels instead of all over the cache
+		// in full resolution pixels, so the level a sample reads doesn't depend on the resolution AO is rendered at
+		float screen_distance = length((offset.xy - tex_coords) * vec2(textureSize(depth_pyramid, 0)));
+		int mip = clamp(int(floor(log2(max(screen_distance, 1.0)))) - LOG_MAX_OFFSET, 0, depth_mips);
+		float sample_depth = -(layer >= 0 && mip <= layer_mip ? layer_distance_at(offset.xy, phase) : textureLod(depth_pyramid, offset.xy, float(mip)).r);
 
 		float range_check = smoothstep(0.0, 1.0, radius / abs(view_position.z - sample_depth));
 		occlusion += (sample_depth >= sample_pos.z + bias ? 1.0 : 0.0) * range_check;
 	}  
 
-	occlusion = 1.0 - (occlusion / 64);
-	final_colour = vec4(vec3(occlusion), 1.0);
+	occlusion = 1.0 - (occlusion / frame_samples);
+	final_colour = vec4(occlusion, centre_distance, 0.0, 1.0);
 }
\ No newline at end of file
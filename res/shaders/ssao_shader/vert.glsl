@@ -1,15 +0,0 @@
-#version 330
-
-layout (location = 0) in vec3 position;
-layout (location = 1) in vec2 uv;
-layout (location = 2) in vec3 normal;
-
-uniform mat4 uni_M;
-uniform mat4 uni_P;
-uniform mat4 uni_V;
-
-void main()
-{
-	vec4 world_position = uni_M * vec4(position, 1.0);	
-	gl_Position = uni_P * uni_V * world_position;
-}
\ No newline at end of file
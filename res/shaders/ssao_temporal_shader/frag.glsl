@@ -0,0 +1,62 @@
+#version 330
+
+// the blended AO and this frame's distance as the blur reads them, then the normal the next frame checks against
+out vec4 final_colour;
+
+// AO in red and the distance in green, from this frame's samples alone
+uniform sampler2D current;
+// what this pass wrote last frame, read at the nearest texel: filtering would blend the distance and the encoded
+// normal across a silhouette before the test that is there to catch it
+uniform sampler2D history;
+// full resolution, screen space motion since the last frame in xy and the distance the surface was at then in z
+uniform sampler2D g_velocity;
+// at the resolution AO is rendered at
+uniform sampler2D g_normal;
+uniform int depth_normals;
+// 0 when the geometry didn't change since the history was written, g_velocity is from an earlier frame then
+uniform int moved;
+// weight of this frame, 1 throws the history away
+uniform float blend;
+
+uniform int sc_width;
+uniform int sc_height;
+
+// how far the history's distance can be from where the surface was, relative to it, and how close its normal has to be
+#define DEPTH_TOLERANCE 0.02
+#define NORMAL_TOLERANCE 0.9
+
+vec3 oct_decode(vec2 e)
+{
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = clamp(-n.z, 0.0, 1.0);
+	n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+	return normalize(n);
+}
+
+void main()
+{
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	vec2 tex_coords = vec2(gl_FragCoord.x / sc_width, gl_FragCoord.y / sc_height);
+
+	vec2 now = texelFetch(current, pixel, 0).rg;
+	vec2 normal = texelFetch(g_normal, pixel, 0).rg;
+
+	vec3 motion = moved == 1 ? texelFetch(g_velocity, ivec2(tex_coords * vec2(textureSize(g_velocity, 0))), 0).xyz : vec3(0.0, 0.0, now.g);
+	vec2 previous_coords = tex_coords - motion.xy;
+
+	float occlusion = now.r;
+	if(blend < 1.0 && all(greaterThanEqual(previous_coords, vec2(0.0))) && all(lessThan(previous_coords, vec2(1.0))))
+	{
+		vec4 previous = texelFetch(history, ivec2(previous_coords * vec2(sc_width, sc_height)), 0);
+
+		// a disocclusion, the history there belongs to whatever covered this surface last frame
+		bool same_surface = abs(previous.g - motion.z) <= DEPTH_TOLERANCE * motion.z;
+		if(depth_normals == 0)
+			same_surface = same_surface && dot(oct_decode(previous.ba), oct_decode(normal)) >= NORMAL_TOLERANCE;
+
+		if(same_surface)
+			occlusion = mix(previous.r, now.r, blend);
+	}
+
+	final_colour = vec4(occlusion, now.g, normal);
+}
\ No newline at end of file
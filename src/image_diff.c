@@ -0,0 +1,208 @@
+#include <image_diff.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif // __SSE2__
+
+#define SSIM_WINDOW 8
+#define SSIM_STEP 4
+/* (0.01 * 255)^2 and (0.03 * 255)^2 from the SSIM paper */
+#define SSIM_C1 6.5025
+#define SSIM_C2 58.5225
+
+/* sum of squared r, g and b differences over count pixels */
+static uint64_t sum_squared_error(const rafgl_pixel_rgb_t *a, const rafgl_pixel_rgb_t *b, int count)
+{
+    uint64_t sum = 0;
+    int i = 0;
+
+#ifdef __SSE2__
+    const __m128i rgb_mask = _mm_set1_epi32(0x00ffffff);
+    const __m128i zero = _mm_setzero_si128();
+
+    while(i + 4 <= count)
+    {
+        /* a lane gains at most 4 * 255^2 per step, so 32 bits hold 4096 steps before they are widened */
+        __m128i acc = _mm_setzero_si128();
+        int end = rafgl_min_m(count & ~3, i + 4 * 4096);
+        uint32_t lanes[4];
+
+        for(; i < end; i += 4)
+        {
+            __m128i va = _mm_and_si128(_mm_loadu_si128((const __m128i*)(a + i)), rgb_mask);
+            __m128i vb = _mm_and_si128(_mm_loadu_si128((const __m128i*)(b + i)), rgb_mask);
+            __m128i dlo = _mm_sub_epi16(_mm_unpacklo_epi8(va, zero), _mm_unpacklo_epi8(vb, zero));
+            __m128i dhi = _mm_sub_epi16(_mm_unpackhi_epi8(va, zero), _mm_unpackhi_epi8(vb, zero));
+            acc = _mm_add_epi32(acc, _mm_add_epi32(_mm_madd_epi16(dlo, dlo), _mm_madd_epi16(dhi, dhi)));
+        }
+
+        _mm_storeu_si128((__m128i*)lanes, acc);
+        sum += (uint64_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+#endif // __SSE2__
+
+    for(; i < count; i++)
+    {
+        int dr = a[i].r - b[i].r, dg = a[i].g - b[i].g, db = a[i].b - b[i].b;
+        sum += dr * dr + dg * dg + db * db;
+    }
+
+    return sum;
+}
+
+/* Rec. 601 weights in 8 bit fixed point */
+static void luminance(uint8_t *luma, const rafgl_pixel_rgb_t *pixels, int count)
+{
+    int i;
+    for(i = 0; i < count; i++)
+    {
+        luma[i] = (77 * pixels[i].r + 150 * pixels[i].g + 29 * pixels[i].b) >> 8;
+    }
+}
+
+/* sums of x, y, x^2, y^2 and xy over the window whose top left corner is at x, y */
+static void window_sums(const uint8_t *la, const uint8_t *lb, int stride, int x, int y, int64_t sums[5])
+{
+    int row;
+
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_set1_epi16(1);
+    __m128i sx = zero, sy = zero, sxx = zero, syy = zero, sxy = zero;
+    int32_t lanes[4];
+    int k;
+
+    for(row = 0; row < SSIM_WINDOW; row++)
+    {
+        const uint8_t *pa = la + (y + row) * stride + x, *pb = lb + (y + row) * stride + x;
+        __m128i va = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)pa), zero);
+        __m128i vb = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)pb), zero);
+
+        sx = _mm_add_epi32(sx, _mm_madd_epi16(va, ones));
+        sy = _mm_add_epi32(sy, _mm_madd_epi16(vb, ones));
+        sxx = _mm_add_epi32(sxx, _mm_madd_epi16(va, va));
+        syy = _mm_add_epi32(syy, _mm_madd_epi16(vb, vb));
+        sxy = _mm_add_epi32(sxy, _mm_madd_epi16(va, vb));
+    }
+
+    __m128i all[5] = {sx, sy, sxx, syy, sxy};
+    for(k = 0; k < 5; k++)
+    {
+        _mm_storeu_si128((__m128i*)lanes, all[k]);
+        sums[k] = (int64_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+#else
+    int col;
+
+    sums[0] = sums[1] = sums[2] = sums[3] = sums[4] = 0;
+    for(row = 0; row < SSIM_WINDOW; row++)
+    {
+        for(col = 0; col < SSIM_WINDOW; col++)
+        {
+            int va = la[(y + row) * stride + x + col], vb = lb[(y + row) * stride + x + col];
+            sums[0] += va;
+            sums[1] += vb;
+            sums[2] += va * va;
+            sums[3] += vb * vb;
+            sums[4] += va * vb;
+        }
+    }
+#endif // __SSE2__
+}
+
+static double mean_ssim(const rafgl_raster_t *a, const rafgl_raster_t *b)
+{
+    int count = a->width * a->height;
+    uint8_t *la = malloc(count), *lb = malloc(count);
+    double total = 0.0;
+    int windows = 0, x, y;
+    const double n = SSIM_WINDOW * SSIM_WINDOW;
+
+    if(la == NULL || lb == NULL)
+    {
+        free(la);
+        free(lb);
+        return 0.0;
+    }
+
+    luminance(la, a->data, count);
+    luminance(lb, b->data, count);
+
+    for(y = 0; y + SSIM_WINDOW <= a->height; y += SSIM_STEP)
+    {
+        for(x = 0; x + SSIM_WINDOW <= a->width; x += SSIM_STEP)
+        {
+            int64_t s[5];
+            window_sums(la, lb, a->width, x, y, s);
+
+            double mx = s[0] / n, my = s[1] / n;
+            double vx = s[2] / n - mx * mx, vy = s[3] / n - my * my, cxy = s[4] / n - mx * my;
+
+            total += ((2.0 * mx * my + SSIM_C1) * (2.0 * cxy + SSIM_C2)) / ((mx * mx + my * my + SSIM_C1) * (vx + vy + SSIM_C2));
+            windows++;
+        }
+    }
+
+    free(la);
+    free(lb);
+
+    /* too small for a single window */
+    if(windows == 0) return 1.0;
+    return total / windows;
+}
+
+int image_diff_compare(const rafgl_raster_t *a, const rafgl_raster_t *b, image_diff_t *diff)
+{
+    int count = a->width * a->height, i;
+
+    if(a->width != b->width || a->height != b->height)
+        return -1;
+
+    double mse = count ? (double)sum_squared_error(a->data, b->data, count) / (3.0 * count) : 0.0;
+
+    diff->rmse = sqrt(mse);
+    diff->psnr = mse > 0.0 ? 10.0 * log10(255.0 * 255.0 / mse) : INFINITY;
+    diff->ssim = mean_ssim(a, b);
+
+    diff->differing_pixels = 0;
+    for(i = 0; i < count; i++)
+    {
+        diff->differing_pixels += (a->data[i].rgba ^ b->data[i].rgba) & 0x00ffffff ? 1 : 0;
+    }
+
+    return 0;
+}
+
+int image_diff_heatmap(rafgl_raster_t *heatmap, const rafgl_raster_t *a, const rafgl_raster_t *b, float gain)
+{
+    int count = a->width * a->height, i;
+
+    if(a->width != b->width || a->height != b->height)
+        return -1;
+
+    rafgl_raster_init(heatmap, a->width, a->height);
+
+    for(i = 0; i < count; i++)
+    {
+        int d = rafgl_max_m(rafgl_abs_m(a->data[i].r - b->data[i].r), rafgl_max_m(rafgl_abs_m(a->data[i].g - b->data[i].g), rafgl_abs_m(a->data[i].b - b->data[i].b)));
+
+        if(d == 0)
+        {
+            heatmap->data[i].rgba = rafgl_RGB(0, 0, 0);
+            continue;
+        }
+
+        /* off by one still shows up as dark blue */
+        float t = rafgl_clampf(d * gain / 255.0f, 0.1f, 1.0f) * 3.0f;
+        int r = 255 * rafgl_clampf(t - 1.0f, 0.0f, 1.0f);
+        int g = 255 * rafgl_clampf(t - 2.0f, 0.0f, 1.0f);
+        int bl = 255 * rafgl_clampf(t < 1.0f ? t : 2.0f - t, 0.0f, 1.0f);
+        heatmap->data[i].rgba = rafgl_RGB(r, g, bl);
+    }
+
+    return 0;
+}
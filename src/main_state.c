@@ -5,10 +5,9 @@
 #include <rafgl.h>
 
 #include <game_constants.h>
+#include <stress_scene.h>
 #include <sys/types.h>
 
-#define KERNEL_SAMPLES 64
-
 static rafgl_meshPUN_t meshes[6];
 
 static vec3_t object_colour = RAFGL_BLUE;
@@ -28,23 +27,161 @@ static int num_meshes;
 static rafgl_texture_t skybox_tex;
 
 static GLuint g_buffer_shader, skybox_shader, skybox_shader_cell, ssao_shader, ssao_blur_shader;
-static GLuint g_buffer_uni_M, g_buffer_uni_VP, skybox_uni_P, skybox_uni_V, ssao_buffer_uni_P, ssao_buffer_uni_M , ssao_buffer_uni_V, ssao_blur_buffer_uni_M, ssao_blur_buffer_uni_VP;
+static GLuint g_buffer_uni_M, g_buffer_uni_VP, g_buffer_uni_previous_M, g_buffer_uni_previous_VP, skybox_uni_P, skybox_uni_V, ssao_buffer_uni_P, ssao_buffer_uni_V;
 static GLuint skybox_cell_uni_P, skybox_cell_uni_V;
 
 static GLuint uni_visibility_factor;
 
 static rafgl_meshPUN_t skybox_mesh;
 
-static rafgl_framebuffer_simple_t fbo, ssao_buffer, ssao_blur_buffer;
+static rafgl_framebuffer_simple_t fbo;
 static rafgl_framebuffer_multitarget_t g_buffer;
+/* the G-buffer's second attachment, only there while temporal SSAO is on */
+static GLuint velocity_tex = 0;
 
-GLuint uni_pos_slot, uni_norm_slot, uni_ssao_slot;
-GLuint uni_pos_slot_ssao, uni_norm_slot_ssao, uni_noise_slot_ssao, uni_tex_slot_blur;
+/* AO at full, half and quarter resolution, the lower two from a min/max downsample of the depth with its normals;
+   AO is kept next to its distance from the SSAO pass on, through both blur passes */
+#define SSAO_LEVELS 3
+typedef struct _ssao_target_t
+{
+    int width, height;
+    rafgl_framebuffer_simple_t ssao, horizontal, blur;
+    rafgl_framebuffer_multitarget_t downsampled;
+    /* temporal SSAO writes one while reading the other, made when it is turned on and deleted when it is turned off */
+    rafgl_framebuffer_simple_t history[2];
+    /* deinterleaved SSAO splits the target by place in every 4x4 block into SSAO_LAYERS texture array layers
+       a quarter of its size, the distance into one and the AO into the other, each framebuffer gets the layers
+       it renders attached before every draw */
+    int layer_width, layer_height;
+    GLuint layer_depth, layer_ao;
+    GLuint deinterleave_fbo, layer_fbo;
+} ssao_target_t;
+static ssao_target_t ssao_targets[SSAO_LEVELS];
+static GLuint ssao_downsample_shader;
+static GLuint uni_pyramid_slot_ssao_downsample, uni_norm_slot_ssao_downsample, uni_factor_ssao_downsample;
+static GLuint depth_normals_loc_ssao_downsample, uni_P_ssao_downsample, uni_V_ssao_downsample;
+
+#define SSAO_LAYERS 16
+/* layers the deinterleave pass writes at once, the most draw buffers GL 3.3 guarantees */
+#define SSAO_DEINTERLEAVE_BATCH 8
+static GLuint ssao_deinterleave_shader, ssao_reinterleave_shader;
+static GLuint uni_centre_slot_deinterleave, uni_first_layer_deinterleave, uni_ao_slot_reinterleave;
+static GLuint uni_layer_ssao, uni_layer_depth_slot_ssao, uni_layer_mip_ssao;
+
+/* horizon-based AO instead of the hemisphere kernel, slices are directions marched both ways and steps are per way */
+typedef struct _horizon_preset_t
+{
+    int slices, steps;
+} horizon_preset_t;
+/* indexed by MAIN_STATE_AO_*, the kernel has none */
+static const horizon_preset_t horizon_presets[] = {{0, 0}, {2, 4}, {3, 6}, {4, 8}, {8, 12}};
+static GLuint horizon_ao_shader;
+static GLuint uni_pyramid_slot_horizon, uni_centre_slot_horizon, uni_norm_slot_horizon, uni_depth_mips_horizon;
+static GLuint uni_P_horizon, uni_V_horizon, scw_horizon, sch_horizon, uni_radius_horizon, uni_slices_horizon, uni_steps_horizon;
+static GLuint uni_noise_rotation_horizon, depth_normals_loc_horizon;
+
+/* the kernel SSAO and its blur in one compute dispatch, 0 without a GL 4.3 context; each workgroup writes a
+   SSAO_COMPUTE_TILE pixel square of the blurred AO */
+#define SSAO_COMPUTE_TILE 32
+static GLuint ssao_compute_shader;
+static GLuint uni_pyramid_slot_compute, uni_centre_slot_compute, uni_norm_slot_compute, uni_noise_slot_compute;
+static GLuint uni_depth_mips_compute, uni_full_resolution_compute, uni_P_compute, uni_V_compute, scw_compute, sch_compute;
+static GLuint uni_samples_compute, uni_kernel_samples_compute, uni_radius_compute, uni_bias_compute, uni_noise_size_compute;
+static GLuint depth_normals_loc_compute, uni_blur_radius_compute;
+
+/* once settled the history stands for about this many frames of samples, on demand rendering keeps going
+   for twice as many after the last change */
+#define SSAO_TEMPORAL_HISTORY 8
+static GLuint ssao_temporal_shader;
+static GLuint uni_current_slot_temporal, uni_history_slot_temporal, uni_velocity_slot_temporal, uni_norm_slot_temporal;
+static GLuint depth_normals_loc_temporal, uni_moved_temporal, uni_blend_temporal, scw_temporal, sch_temporal;
+static GLuint uni_first_sample_ssao, uni_frame_samples_ssao, uni_noise_rotation_ssao;
+/* the history last written, frames blended into it since it was thrown away and since the geometry last changed */
+static int history_index = 0, history_frames = 0, settle_frames = 0;
+/* turns the kernel slice and the noise every temporal frame */
+static int temporal_frame = 0;
+/* what the G-buffer was last rendered with, the velocity is measured from there */
+static mat4_t previous_model, previous_view_projection;
+
+/* linear depth with a few downsampled levels for the far SSAO samples, one framebuffer per level */
+#define DEPTH_PYRAMID_MAX_LEVELS 5
+static GLuint depth_pyramid_tex, depth_pyramid_fbos[DEPTH_PYRAMID_MAX_LEVELS];
+static int depth_pyramid_levels;
+static GLuint depth_linearize_shader, depth_downsample_shader;
+static GLuint depth_linearize_uni_P, uni_depth_slot_linearize, uni_pyramid_slot_downsample;
+
+GLuint uni_norm_slot, uni_ssao_slot;
+GLuint uni_pyramid_slot_ssao, uni_centre_slot_ssao, uni_depth_mips_ssao, uni_norm_slot_ssao, uni_noise_slot_ssao, uni_tex_slot_blur;
+GLuint uni_samples_ssao, uni_kernel_samples_ssao, uni_radius_ssao, uni_bias_ssao, uni_noise_size_ssao, uni_blur_radius, uni_vertical_blur;
+
+static main_state_ssao_params_t ssao_params;
+static int ssao_params_changed = 0;
+
+
+unsigned int noise_texture, off_ssao = 0, off_ssao_loc, depth_normals_loc, depth_normals_loc_ssao;
+unsigned int ssao_resolution_loc, uni_pyramid_slot, uni_ssao_normal_slot;
+unsigned int scw_obj0, sch_obj0, scw_ssao, sch_ssao;
+unsigned int screenW, screenH;
 
+/* everything render reads that update writes, so the two can run on different threads */
+typedef struct _main_state_frame_t
+{
+    /* changes here invalidate the G-buffer and the SSAO computed from it */
+    struct
+    {
+        mat4_t model, view, projection, view_projection;
+        int selected_mesh;
+        /* SSAO reconstructs normals from depth, so the G-buffer skips g_normal and lighting uses the vertex normals */
+        int depth_normals;
+        /* AO is rendered at 1 / 2^ssao_level of the window on each axis */
+        int ssao_level;
+        /* a few samples a frame blended into a reprojected history, the G-buffer writes velocity for it */
+        int temporal_ssao;
+        /* AO rendered one 4x4 block phase at a time from a deinterleaved copy of the depth */
+        int deinterleaved_ssao;
+        /* MAIN_STATE_AO_*, the hemisphere kernel or a horizon-based preset */
+        int ao_method;
+        /* the kernel and blur in one compute dispatch, when nothing it leaves out is on */
+        int compute_ssao;
+    } geometry;
+
+    /* changes here only invalidate the lighting pass */
+    struct
+    {
+        vec3_t camera_position;
+        vec3_t object_colour, light_colour, light_direction, ambient;
+        int selected_shader, off_ssao;
+    } lighting;
 
-unsigned int noise_texture, off_ssao = 0, off_ssao_loc;
-unsigned int scw_obj0, sch_obj0, scw_blur, sch_blur, scw_ssao, sch_ssao;
-unsigned int screenW, screenH;
+    /* what late latching needs to rebuild the view from a fresh cursor sample */
+    struct
+    {
+        int enabled, mouse_look;
+        float camera_angle, hoffset;
+        int raster_width, raster_height;
+    } latch;
+
+    int num_key_down;
+    int show_counters;
+} main_state_frame_t;
+
+static rafgl_snapshot_t frames;
+
+/* with a stress scene every pass draws all of its instances instead of the selected mesh */
+static stress_scene_params_t stress_params;
+static int stress_params_set = 0;
+static stress_scene_t stress_scene;
+
+/* the render counters overlay, redrawn into the raster every frame it is shown */
+#define COUNTERS_OVERLAY_WIDTH 560
+#define COUNTERS_OVERLAY_HEIGHT 232
+static rafgl_raster_t counters_raster;
+static rafgl_texture_t counters_tex;
+static int show_counters = 0;
+
+/* what fbo currently holds, so unchanged passes can be skipped */
+static main_state_frame_t last_rendered;
+static int last_rendered_valid = 0;
 
 
 void main_state_init(GLFWwindow *window, void *args, int width, int height)
@@ -53,36 +190,147 @@ void main_state_init(GLFWwindow *window, void *args, int width, int height)
     screenH = height;
 
     // G Buffer setup
-    g_buffer = rafgl_framebuffer_multitarget_create(width, height, 2);
+    rafgl_gpu_set_scope("g_buffer");
+    /* positions are reconstructed from the depth texture, so only the octahedral normal needs an attachment;
+       the velocity temporal SSAO reprojects with is attached next to it while temporal SSAO is on */
+    const GLenum g_buffer_formats[] = {GL_RG16F};
+    g_buffer = rafgl_framebuffer_multitarget_create_formats(width, height, 1, g_buffer_formats, RAFGL_TRUE);
     glBindFramebuffer(GL_FRAMEBUFFER, g_buffer.fbo_id);
 
-    unsigned int attachments[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
-    glDrawBuffers(2, attachments);
+    unsigned int attachments[1] = {GL_COLOR_ATTACHMENT0};
+    glDrawBuffers(1, attachments);
 
     g_buffer_shader = rafgl_program_create_from_name("g_buffer_shader");
     g_buffer_uni_M = glGetUniformLocation(g_buffer_shader, "uni_M");
     g_buffer_uni_VP = glGetUniformLocation(g_buffer_shader, "uni_VP");
+    g_buffer_uni_previous_M = glGetUniformLocation(g_buffer_shader, "uni_previous_M");
+    g_buffer_uni_previous_VP = glGetUniformLocation(g_buffer_shader, "uni_previous_VP");
+
+    // Depth pyramid setup
+    rafgl_gpu_set_scope("depth pyramid");
+    depth_pyramid_levels = 1;
+    while(depth_pyramid_levels < DEPTH_PYRAMID_MAX_LEVELS && (rafgl_max_m(width, height) >> depth_pyramid_levels) > 0)
+        depth_pyramid_levels++;
+
+    depth_pyramid_tex = rafgl_gpu_gen_texture("linear depth");
+    glBindTexture(GL_TEXTURE_2D, depth_pyramid_tex);
+    rafgl_gl_tex_image_2d(GL_TEXTURE_2D, 0, GL_R32F, width, height, GL_RED, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, depth_pyramid_levels - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    /* only allocates the levels, the pyramid pass fills them */
+    rafgl_gl_generate_mipmap(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, 0);
 
-    // SSAO buffer setup
-    ssao_buffer = rafgl_framebuffer_simple_create(width, height, GL_RGB);
-    glBindFramebuffer(GL_FRAMEBUFFER, ssao_buffer.fbo_id);
-    glDrawBuffer(GL_COLOR_ATTACHMENT0);
+    for(int i = 0; i < depth_pyramid_levels; i++)
+    {
+        depth_pyramid_fbos[i] = rafgl_gpu_gen_framebuffer("linear depth level");
+        glBindFramebuffer(GL_FRAMEBUFFER, depth_pyramid_fbos[i]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, depth_pyramid_tex, i);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-    // SSAO blur buffer setup
-    ssao_blur_buffer = rafgl_framebuffer_simple_create(width, height, GL_RGB);
-    ssao_blur_shader = rafgl_program_create_from_name("ssao_blur_shader");
-    uni_tex_slot_blur = glGetUniformLocation(ssao_blur_shader, "tex");
+    depth_linearize_shader = rafgl_program_create_fullscreen_from_name("depth_linearize_shader");
+    depth_linearize_uni_P = glGetUniformLocation(depth_linearize_shader, "uni_P");
+    uni_depth_slot_linearize = glGetUniformLocation(depth_linearize_shader, "g_depth");
+    depth_downsample_shader = rafgl_program_create_fullscreen_from_name("depth_downsample_shader");
+    uni_pyramid_slot_downsample = glGetUniformLocation(depth_downsample_shader, "depth_pyramid");
 
-    ssao_blur_buffer_uni_M = glGetUniformLocation(ssao_blur_shader, "uni_M");
-    ssao_blur_buffer_uni_VP = glGetUniformLocation(ssao_blur_shader, "uni_VP");
+    // SSAO and blur buffer setup, a set for every resolution, rounded up so every window pixel is covered
+    const GLenum downsampled_formats[] = {GL_R32F, GL_RG16F};
+    const GLenum downsampled_attachments[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+    GLenum deinterleave_attachments[SSAO_DEINTERLEAVE_BATCH];
+
+    for(int i = 0; i < SSAO_DEINTERLEAVE_BATCH; i++)
+        deinterleave_attachments[i] = GL_COLOR_ATTACHMENT0 + i;
+
+    for(int i = 0; i < SSAO_LEVELS; i++)
+    {
+        ssao_target_t *target = &ssao_targets[i];
+
+        target->width = (width + (1 << i) - 1) >> i;
+        target->height = (height + (1 << i) - 1) >> i;
+
+        rafgl_gpu_set_scope("ssao");
+        target->ssao = rafgl_framebuffer_simple_create(target->width, target->height, GL_RG16F);
+        glBindFramebuffer(GL_FRAMEBUFFER, target->ssao.fbo_id);
+        glDrawBuffer(GL_COLOR_ATTACHMENT0);
+
+        rafgl_gpu_set_scope("ssao_blur");
+        target->horizontal = rafgl_framebuffer_simple_create(target->width, target->height, GL_RG16F);
+        target->blur = rafgl_framebuffer_simple_create(target->width, target->height, GL_RG16F);
+
+        rafgl_gpu_set_scope("ssao layers");
+        target->layer_width = (target->width + 3) / 4;
+        target->layer_height = (target->height + 3) / 4;
+
+        target->layer_depth = rafgl_gpu_gen_texture("ssao layer depth");
+        glBindTexture(GL_TEXTURE_2D_ARRAY, target->layer_depth);
+        rafgl_gl_tex_image_3d(GL_TEXTURE_2D_ARRAY, 0, GL_R32F, target->layer_width, target->layer_height, SSAO_LAYERS, GL_RED, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+        target->layer_ao = rafgl_gpu_gen_texture("ssao layer ao");
+        glBindTexture(GL_TEXTURE_2D_ARRAY, target->layer_ao);
+        rafgl_gl_tex_image_3d(GL_TEXTURE_2D_ARRAY, 0, GL_RG16F, target->layer_width, target->layer_height, SSAO_LAYERS, GL_RG, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+        target->deinterleave_fbo = rafgl_gpu_gen_framebuffer("ssao deinterleave");
+        glBindFramebuffer(GL_FRAMEBUFFER, target->deinterleave_fbo);
+        glDrawBuffers(SSAO_DEINTERLEAVE_BATCH, deinterleave_attachments);
+        target->layer_fbo = rafgl_gpu_gen_framebuffer("ssao layer");
+
+        if(i > 0)
+        {
+            rafgl_gpu_set_scope("ssao downsample");
+            target->downsampled = rafgl_framebuffer_multitarget_create_formats(target->width, target->height, 2, downsampled_formats, RAFGL_FALSE);
+            glBindFramebuffer(GL_FRAMEBUFFER, target->downsampled.fbo_id);
+            glDrawBuffers(2, downsampled_attachments);
+        }
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    ssao_downsample_shader = rafgl_program_create_fullscreen_from_name("ssao_downsample_shader");
+    uni_pyramid_slot_ssao_downsample = glGetUniformLocation(ssao_downsample_shader, "depth_pyramid");
+    uni_norm_slot_ssao_downsample = glGetUniformLocation(ssao_downsample_shader, "g_normal");
+    uni_factor_ssao_downsample = glGetUniformLocation(ssao_downsample_shader, "factor");
+    depth_normals_loc_ssao_downsample = glGetUniformLocation(ssao_downsample_shader, "depth_normals");
+    uni_P_ssao_downsample = glGetUniformLocation(ssao_downsample_shader, "uni_P");
+    uni_V_ssao_downsample = glGetUniformLocation(ssao_downsample_shader, "uni_V");
+
+    ssao_deinterleave_shader = rafgl_program_create_fullscreen_from_name("ssao_deinterleave_shader");
+    uni_centre_slot_deinterleave = glGetUniformLocation(ssao_deinterleave_shader, "centre_depth");
+    uni_first_layer_deinterleave = glGetUniformLocation(ssao_deinterleave_shader, "first_layer");
+    ssao_reinterleave_shader = rafgl_program_create_fullscreen_from_name("ssao_reinterleave_shader");
+    uni_ao_slot_reinterleave = glGetUniformLocation(ssao_reinterleave_shader, "layer_ao");
+
+    ssao_temporal_shader = rafgl_program_create_fullscreen_from_name("ssao_temporal_shader");
+    uni_current_slot_temporal = glGetUniformLocation(ssao_temporal_shader, "current");
+    uni_history_slot_temporal = glGetUniformLocation(ssao_temporal_shader, "history");
+    uni_velocity_slot_temporal = glGetUniformLocation(ssao_temporal_shader, "g_velocity");
+    uni_norm_slot_temporal = glGetUniformLocation(ssao_temporal_shader, "g_normal");
+    depth_normals_loc_temporal = glGetUniformLocation(ssao_temporal_shader, "depth_normals");
+    uni_moved_temporal = glGetUniformLocation(ssao_temporal_shader, "moved");
+    uni_blend_temporal = glGetUniformLocation(ssao_temporal_shader, "blend");
+    scw_temporal = glGetUniformLocation(ssao_temporal_shader, "sc_width");
+    sch_temporal = glGetUniformLocation(ssao_temporal_shader, "sc_height");
+
+    rafgl_gpu_set_scope("ssao_blur");
+    ssao_blur_shader = rafgl_program_create_fullscreen_from_name("ssao_blur_shader");
+    uni_tex_slot_blur = glGetUniformLocation(ssao_blur_shader, "tex");
 
-    scw_blur = glGetUniformLocation(ssao_blur_shader, "sc_width");
-    sch_blur = glGetUniformLocation(ssao_blur_shader, "sc_height");
 
     
     // Main buffer and skybox setup
+    rafgl_gpu_set_scope("fbo");
     fbo = rafgl_framebuffer_simple_create(width, height, GL_RGB);
 
+    rafgl_gpu_set_scope("skybox");
+    rafgl_texture_init(&skybox_tex);
     rafgl_texture_load_cubemap_named(&skybox_tex, "above_the_sea", "jpg");
     skybox_shader = rafgl_program_create_from_name("skybox_shader");
     skybox_shader_cell = rafgl_program_create_from_name("skybox_shader_cell");
@@ -94,75 +342,81 @@ void main_state_init(GLFWwindow *window, void *args, int width, int height)
     skybox_cell_uni_V = glGetUniformLocation(skybox_shader_cell, "uni_V");
 
     // Set up ssao shader
-    ssao_shader = rafgl_program_create_from_name("ssao_shader");
+    ssao_shader = rafgl_program_create_fullscreen_from_name("ssao_shader");
+
+    horizon_ao_shader = rafgl_program_create_fullscreen_from_name("horizon_ao_shader");
+    uni_pyramid_slot_horizon = glGetUniformLocation(horizon_ao_shader, "depth_pyramid");
+    uni_centre_slot_horizon = glGetUniformLocation(horizon_ao_shader, "centre_depth");
+    uni_norm_slot_horizon = glGetUniformLocation(horizon_ao_shader, "g_normal");
+    uni_depth_mips_horizon = glGetUniformLocation(horizon_ao_shader, "depth_mips");
+    uni_P_horizon = glGetUniformLocation(horizon_ao_shader, "uni_P");
+    uni_V_horizon = glGetUniformLocation(horizon_ao_shader, "uni_V");
+    scw_horizon = glGetUniformLocation(horizon_ao_shader, "sc_width");
+    sch_horizon = glGetUniformLocation(horizon_ao_shader, "sc_height");
+    uni_radius_horizon = glGetUniformLocation(horizon_ao_shader, "radius");
+    uni_slices_horizon = glGetUniformLocation(horizon_ao_shader, "slices");
+    uni_steps_horizon = glGetUniformLocation(horizon_ao_shader, "steps");
+    uni_noise_rotation_horizon = glGetUniformLocation(horizon_ao_shader, "noise_rotation");
+    depth_normals_loc_horizon = glGetUniformLocation(horizon_ao_shader, "depth_normals");
+
+    ssao_compute_shader = rafgl_program_create_compute_from_name("ssao_compute_shader");
+    if(ssao_compute_shader)
+    {
+        uni_pyramid_slot_compute = glGetUniformLocation(ssao_compute_shader, "depth_pyramid");
+        uni_centre_slot_compute = glGetUniformLocation(ssao_compute_shader, "centre_depth");
+        uni_norm_slot_compute = glGetUniformLocation(ssao_compute_shader, "g_normal");
+        uni_noise_slot_compute = glGetUniformLocation(ssao_compute_shader, "noise_tex");
+        uni_depth_mips_compute = glGetUniformLocation(ssao_compute_shader, "depth_mips");
+        uni_full_resolution_compute = glGetUniformLocation(ssao_compute_shader, "full_resolution");
+        uni_P_compute = glGetUniformLocation(ssao_compute_shader, "uni_P");
+        uni_V_compute = glGetUniformLocation(ssao_compute_shader, "uni_V");
+        scw_compute = glGetUniformLocation(ssao_compute_shader, "sc_width");
+        sch_compute = glGetUniformLocation(ssao_compute_shader, "sc_height");
+        uni_samples_compute = glGetUniformLocation(ssao_compute_shader, "samples");
+        uni_kernel_samples_compute = glGetUniformLocation(ssao_compute_shader, "kernel_samples");
+        uni_radius_compute = glGetUniformLocation(ssao_compute_shader, "radius");
+        uni_bias_compute = glGetUniformLocation(ssao_compute_shader, "bias");
+        uni_noise_size_compute = glGetUniformLocation(ssao_compute_shader, "noise_size");
+        depth_normals_loc_compute = glGetUniformLocation(ssao_compute_shader, "depth_normals");
+        uni_blur_radius_compute = glGetUniformLocation(ssao_compute_shader, "blur_radius");
+    }
 
-    ssao_buffer_uni_M = glGetUniformLocation(ssao_shader, "uni_M");
     ssao_buffer_uni_P = glGetUniformLocation(ssao_shader, "uni_P");
     ssao_buffer_uni_V = glGetUniformLocation(ssao_shader, "uni_V");
 
-    uni_pos_slot_ssao = glGetUniformLocation(ssao_shader, "g_position");
+    uni_pyramid_slot_ssao = glGetUniformLocation(ssao_shader, "depth_pyramid");
+    uni_centre_slot_ssao = glGetUniformLocation(ssao_shader, "centre_depth");
+    uni_depth_mips_ssao = glGetUniformLocation(ssao_shader, "depth_mips");
     uni_norm_slot_ssao = glGetUniformLocation(ssao_shader, "g_normal");
     uni_noise_slot_ssao = glGetUniformLocation(ssao_shader, "noise_tex");
+    uni_layer_ssao = glGetUniformLocation(ssao_shader, "layer");
+    uni_layer_depth_slot_ssao = glGetUniformLocation(ssao_shader, "layer_depth");
+    uni_layer_mip_ssao = glGetUniformLocation(ssao_shader, "layer_mip");
+    depth_normals_loc_ssao = glGetUniformLocation(ssao_shader, "depth_normals");
 
     scw_ssao = glGetUniformLocation(ssao_shader, "sc_width");
     sch_ssao = glGetUniformLocation(ssao_shader, "sc_height");
 
-    // Generating sample kernels
-    GLfloat sample[KERNEL_SAMPLES * 3];
+    uni_samples_ssao = glGetUniformLocation(ssao_shader, "samples");
+    uni_kernel_samples_ssao = glGetUniformLocation(ssao_shader, "kernel_samples");
+    uni_first_sample_ssao = glGetUniformLocation(ssao_shader, "first_sample");
+    uni_frame_samples_ssao = glGetUniformLocation(ssao_shader, "frame_samples");
+    uni_noise_rotation_ssao = glGetUniformLocation(ssao_shader, "noise_rotation");
+    uni_radius_ssao = glGetUniformLocation(ssao_shader, "radius");
+    uni_bias_ssao = glGetUniformLocation(ssao_shader, "bias");
+    uni_noise_size_ssao = glGetUniformLocation(ssao_shader, "noise_size");
+    uni_blur_radius = glGetUniformLocation(ssao_blur_shader, "blur_radius");
+    uni_vertical_blur = glGetUniformLocation(ssao_blur_shader, "vertical");
 
-    for(unsigned int i = 0; i < KERNEL_SAMPLES; i++) {
-        sample[i * 3 + 0] = randf() * 2 - 1.0;
-        sample[i * 3 + 1] = randf() * 2 - 1.0;
-        sample[i * 3 + 2] = randf();
+    rafgl_gpu_set_scope("ssao");
+    noise_texture = rafgl_gpu_gen_texture("ssao noise");
 
-        // normalize
-        float vec_len = sqrt(sample[i * 3 + 0] * sample[i * 3 + 0] +
-                             sample[i * 3 + 1] * sample[i * 3 + 1] +
-                             sample[i * 3 + 2] * sample[i * 3 + 2]);
-
-        sample[i * 3 + 0] /= vec_len;
-        sample[i * 3 + 1] /= vec_len;
-        sample[i * 3 + 2] /= vec_len;
-
-        float rand_float = randf();
-        sample[i * 3 + 0] *= rand_float;
-        sample[i * 3 + 1] *= rand_float;
-        sample[i * 3 + 2] *= rand_float;
-
-        float scale = (float)i / (float)KERNEL_SAMPLES;
-        float lf = rafgl_lerpf(0.1, 1.0f, scale * scale);
-        
-        sample[i * 3 + 0] *= lf;
-        sample[i * 3 + 1] *= lf;
-        sample[i * 3 + 2] *= lf;
-    }
-
-    GLuint vec_loc = glGetUniformLocation(ssao_shader, "samples");
-    glUseProgram(ssao_shader);
-    glUniform3fv(vec_loc, KERNEL_SAMPLES, sample);
-
-    // Generate random rotation texture
-    GLfloat ssao_noise[4][4][3];
-
-    for (unsigned int i = 0; i < 4; i++)
-    {
-        for (unsigned int j = 0; j < 4; j++)
-        {
-            ssao_noise[i][j][0] = randf() * 2 + 1;
-            ssao_noise[i][j][1] = randf() * 2 + 1;
-            ssao_noise[i][j][2] = 0.0;
-        }
-    }
-
-    glGenTextures(1, &noise_texture);
-    glBindTexture(GL_TEXTURE_2D, noise_texture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, 4, 4, 0, GL_RGB, GL_FLOAT, ssao_noise);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    main_state_ssao_params_t defaults;
+    main_state_default_ssao_params(&defaults);
+    main_state_set_ssao_params(&defaults);
 
 
+    rafgl_gpu_set_scope("skybox");
     rafgl_meshPUN_init(&skybox_mesh);
     rafgl_meshPUN_load_cube(&skybox_mesh, 1.0f);
 
@@ -171,6 +425,7 @@ void main_state_init(GLFWwindow *window, void *args, int width, int height)
 
     rafgl_log_fps(RAFGL_TRUE);
 
+    rafgl_gpu_set_scope("meshes");
     for(int i = 0; i < num_meshes; i++)
     {
         rafgl_log(RAFGL_INFO, "Loading mesh %d!\n", i + 1);
@@ -178,6 +433,19 @@ void main_state_init(GLFWwindow *window, void *args, int width, int height)
         rafgl_meshPUN_load_from_OBJ(meshes + i, mesh_names[i]);
     }
 
+    if(stress_params_set && stress_params.instance_count > 0)
+    {
+        int loaded_ids[6], loaded_count = 0;
+        for(int i = 0; i < num_meshes; i++)
+        {
+            if(meshes[i].loaded) loaded_ids[loaded_count++] = i;
+        }
+
+        stress_params.aspect = (float)width / height;
+        if(stress_scene_generate(&stress_scene, &stress_params, loaded_ids, loaded_count) == 0)
+            rafgl_log(RAFGL_INFO, "Stress scene: %d instances over %d meshes, seed %u\n", stress_scene.count, loaded_count, stress_params.seed);
+    }
+
 
     char shader_name[128];
 
@@ -193,10 +461,13 @@ void main_state_init(GLFWwindow *window, void *args, int width, int height)
         object_uni_ambient[i] = glGetUniformLocation(object_shader[i], "uni_ambient");
         object_uni_camera_position[i] = glGetUniformLocation(object_shader[i], "uni_camera_position");
         off_ssao_loc = glGetUniformLocation(object_shader[i], "off_ssao");
+        depth_normals_loc = glGetUniformLocation(object_shader[i], "depth_normals");
 
-        uni_pos_slot = glGetUniformLocation(object_shader[i], "g_position");
         uni_norm_slot = glGetUniformLocation(object_shader[i], "g_normal");
         uni_ssao_slot = glGetUniformLocation(object_shader[i], "ssao_tex");
+        ssao_resolution_loc = glGetUniformLocation(object_shader[i], "ssao_resolution");
+        uni_pyramid_slot = glGetUniformLocation(object_shader[i], "depth_pyramid");
+        uni_ssao_normal_slot = glGetUniformLocation(object_shader[i], "ssao_normal");
 
         scw_obj0 = glGetUniformLocation(object_shader[i], "sc_width");
         sch_obj0 = glGetUniformLocation(object_shader[i], "sc_height");
@@ -208,6 +479,14 @@ void main_state_init(GLFWwindow *window, void *args, int width, int height)
 
     light_direction = v3_norm(light_direction);
 
+    rafgl_snapshot_init(&frames, sizeof(main_state_frame_t));
+    rafgl_game_set_snapshot(&frames);
+
+    rafgl_gpu_set_scope("counters overlay");
+    rafgl_raster_init(&counters_raster, COUNTERS_OVERLAY_WIDTH, COUNTERS_OVERLAY_HEIGHT);
+    rafgl_texture_init(&counters_tex);
+    rafgl_gpu_set_scope(NULL);
+
     //glEnable(GL_CULL_FACE);
     //glCullFace(GL_BACK);
 }
@@ -245,6 +524,8 @@ int last_lmb = 0;
 int selected_mesh = 3;
 float sensitivity = 1.0f;
 
+int late_latch = 0;
+
 int selected_shader = 0;
 
 float visibility_factor = -2.0f;
@@ -252,6 +533,196 @@ float turn = 1.0f;
 
 int num_key_down = 0;
 
+int scripted_path = 0;
+
+int depth_normals = 0;
+
+int ssao_level = 0;
+
+int temporal_ssao = 0;
+
+int deinterleaved_ssao = 0;
+
+int ao_method = MAIN_STATE_AO_KERNEL;
+
+int compute_ssao = 0;
+
+void main_state_set_scripted_path(int b)
+{
+    scripted_path = b;
+}
+
+void main_state_set_depth_normals(int b)
+{
+    depth_normals = b;
+}
+
+void main_state_set_ssao_resolution(int divisor)
+{
+    ssao_level = divisor >= 4 ? 2 : divisor >= 2 ? 1 : 0;
+}
+
+void main_state_set_temporal_ssao(int b)
+{
+    temporal_ssao = b;
+}
+
+void main_state_set_deinterleaved_ssao(int b)
+{
+    deinterleaved_ssao = b;
+}
+
+void main_state_set_ao_method(int method)
+{
+    ao_method = rafgl_clampi(method, MAIN_STATE_AO_KERNEL, MAIN_STATE_AO_HORIZON_ULTRA);
+}
+
+void main_state_set_compute_ssao(int b)
+{
+    compute_ssao = b;
+}
+
+void main_state_set_stress_scene(const stress_scene_params_t *params)
+{
+    stress_params = *params;
+    stress_params_set = 1;
+}
+
+void main_state_default_ssao_params(main_state_ssao_params_t *params)
+{
+    params->kernel_samples = 64;
+    params->radius = 0.5f;
+    params->bias = 0.025f;
+    params->noise_size = 4;
+    params->blur_radius = 2;
+    params->temporal_samples = 8;
+}
+
+void main_state_set_ssao_params(const main_state_ssao_params_t *params)
+{
+    ssao_params = *params;
+    ssao_params.kernel_samples = rafgl_clampi(ssao_params.kernel_samples, 1, MAIN_STATE_MAX_KERNEL_SAMPLES);
+    ssao_params.noise_size = rafgl_clampi(ssao_params.noise_size, 1, MAIN_STATE_MAX_NOISE_SIZE);
+    ssao_params.temporal_samples = rafgl_clampi(ssao_params.temporal_samples, 1, ssao_params.kernel_samples);
+    ssao_params.blur_radius = rafgl_clampi(ssao_params.blur_radius, 0, MAIN_STATE_MAX_BLUR_RADIUS);
+
+    int samples = ssao_params.kernel_samples, noise_size = ssao_params.noise_size;
+
+    // Generating sample kernels
+    GLfloat sample[MAIN_STATE_MAX_KERNEL_SAMPLES * 3];
+
+    for(int i = 0; i < samples; i++) {
+        sample[i * 3 + 0] = randf() * 2 - 1.0;
+        sample[i * 3 + 1] = randf() * 2 - 1.0;
+        sample[i * 3 + 2] = randf();
+
+        // normalize
+        float vec_len = sqrt(sample[i * 3 + 0] * sample[i * 3 + 0] +
+                             sample[i * 3 + 1] * sample[i * 3 + 1] +
+                             sample[i * 3 + 2] * sample[i * 3 + 2]);
+
+        sample[i * 3 + 0] /= vec_len;
+        sample[i * 3 + 1] /= vec_len;
+        sample[i * 3 + 2] /= vec_len;
+
+        float rand_float = randf();
+        sample[i * 3 + 0] *= rand_float;
+        sample[i * 3 + 1] *= rand_float;
+        sample[i * 3 + 2] *= rand_float;
+
+        float scale = (float)i / (float)samples;
+        float lf = rafgl_lerpf(0.1, 1.0f, scale * scale);
+        
+        sample[i * 3 + 0] *= lf;
+        sample[i * 3 + 1] *= lf;
+        sample[i * 3 + 2] *= lf;
+    }
+
+    rafgl_gl_use_program(ssao_shader);
+    rafgl_gl_uniform3fv(uni_samples_ssao, samples, sample);
+    rafgl_gl_uniform1i(uni_kernel_samples_ssao, samples);
+    rafgl_gl_uniform1f(uni_radius_ssao, ssao_params.radius);
+    rafgl_gl_uniform1f(uni_bias_ssao, ssao_params.bias);
+    rafgl_gl_uniform1i(uni_noise_size_ssao, noise_size);
+
+    rafgl_gl_use_program(horizon_ao_shader);
+    rafgl_gl_uniform1f(uni_radius_horizon, ssao_params.radius);
+
+    rafgl_gl_use_program(ssao_blur_shader);
+    rafgl_gl_uniform1i(uni_blur_radius, ssao_params.blur_radius);
+
+    if(ssao_compute_shader)
+    {
+        rafgl_gl_use_program(ssao_compute_shader);
+        rafgl_gl_uniform3fv(uni_samples_compute, samples, sample);
+        rafgl_gl_uniform1i(uni_kernel_samples_compute, samples);
+        rafgl_gl_uniform1f(uni_radius_compute, ssao_params.radius);
+        rafgl_gl_uniform1f(uni_bias_compute, ssao_params.bias);
+        rafgl_gl_uniform1i(uni_noise_size_compute, noise_size);
+        rafgl_gl_uniform1i(uni_blur_radius_compute, ssao_params.blur_radius);
+    }
+    rafgl_gl_use_program(0);
+
+    // Generate random rotation texture
+    GLfloat ssao_noise[MAIN_STATE_MAX_NOISE_SIZE][MAIN_STATE_MAX_NOISE_SIZE][3];
+
+    for (int i = 0; i < noise_size; i++)
+    {
+        for (int j = 0; j < noise_size; j++)
+        {
+            ssao_noise[i][j][0] = randf() * 2 + 1;
+            ssao_noise[i][j][1] = randf() * 2 + 1;
+            ssao_noise[i][j][2] = 0.0;
+        }
+    }
+
+    rafgl_gl_bind_texture(GL_TEXTURE_2D, noise_texture);
+    /* rows of the array are MAIN_STATE_MAX_NOISE_SIZE long, only the first noise_size of each are used */
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, MAIN_STATE_MAX_NOISE_SIZE);
+    rafgl_gl_tex_image_2d(GL_TEXTURE_2D, 0, GL_RGBA16F, noise_size, noise_size, GL_RGB, GL_FLOAT, ssao_noise);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    rafgl_gl_bind_texture(GL_TEXTURE_2D, 0);
+
+    /* the SSAO and blur passes have to run again even if the geometry didn't change */
+    ssao_params_changed = 1;
+}
+
+void main_state_get_ssao_params(main_state_ssao_params_t *params)
+{
+    *params = ssao_params;
+}
+
+/* next mesh in the given direction that actually loaded, models missing from res/models are skipped */
+static int step_mesh(int from, int step)
+{
+    for(int i = 1; i <= num_meshes; i++)
+    {
+        int candidate = ((from + step * i) % num_meshes + num_meshes) % num_meshes;
+        if(meshes[candidate].loaded) return candidate;
+    }
+    return from;
+}
+
+/* compute SSAO turned on while it can't apply changes nothing on screen, so G says what is holding it back */
+static void log_compute_ssao_blocked(void)
+{
+    if(!compute_ssao)
+        return;
+
+    if(!ssao_compute_shader)
+        rafgl_log(RAFGL_WARNING, "Compute SSAO needs a GL 4.3 context, the fragment passes stay in use\n");
+    if(temporal_ssao)
+        rafgl_log(RAFGL_INFO, "Compute SSAO waits until temporal SSAO is off (J)\n");
+    if(deinterleaved_ssao)
+        rafgl_log(RAFGL_INFO, "Compute SSAO waits until deinterleaving is off (K)\n");
+    if(ao_method != MAIN_STATE_AO_KERNEL)
+        rafgl_log(RAFGL_INFO, "Compute SSAO waits until the kernel AO is selected again (O)\n");
+}
+
 void main_state_update(GLFWwindow *window, float delta_time, rafgl_game_data_t *game_data, void *args)
 {
     visibility_factor += delta_time * turn;
@@ -277,6 +748,9 @@ void main_state_update(GLFWwindow *window, float delta_time, rafgl_game_data_t *
     else
         off_ssao = 0;
 
+    if(game_data->keys_pressed[RAFGL_KEY_O])
+        ao_method = (ao_method + 1) % (MAIN_STATE_AO_HORIZON_ULTRA + 1);
+
 
 
     if(!game_data->keys_down[RAFGL_KEY_LEFT_SHIFT])
@@ -296,7 +770,7 @@ void main_state_update(GLFWwindow *window, float delta_time, rafgl_game_data_t *
 
         if(reshow_cursor_flag == 0)
         {
-            glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_HIDDEN);
+            rafgl_cursor_set_mode(GLFW_CURSOR_HIDDEN);
         }
 
         float ydelta = game_data->mouse_pos_y - game_data->raster_height / 2;
@@ -311,13 +785,13 @@ void main_state_update(GLFWwindow *window, float delta_time, rafgl_game_data_t *
         hoffset -= sensitivity * ydelta / game_data->raster_height;
         camera_angle += sensitivity * xdelta / game_data->raster_width;
 
-        glfwSetCursorPos(window, game_data->raster_width / 2, game_data->raster_height / 2);
+        rafgl_cursor_set_pos(game_data->raster_width / 2, game_data->raster_height / 2);
         reshow_cursor_flag = 1;
     }
     else if(reshow_cursor_flag)
     {
         reshow_cursor_flag = 0;
-        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
+        rafgl_cursor_set_mode(GLFW_CURSOR_NORMAL);
     }
     last_lmb = game_data->is_lmb_down;
 
@@ -331,11 +805,32 @@ void main_state_update(GLFWwindow *window, float delta_time, rafgl_game_data_t *
     if(game_data->keys_down['A']) camera_position = v3_add(camera_position, v3_muls(right, -move_speed * delta_time));
 
     if(game_data->keys_pressed['R']) rotate = !rotate;
+    if(game_data->keys_pressed[RAFGL_KEY_L]) late_latch = !late_latch;
+    if(game_data->keys_pressed[RAFGL_KEY_T]) rafgl_profile_request_export("logs/profile");
+    if(game_data->keys_pressed[RAFGL_KEY_C]) show_counters = !show_counters;
+    if(game_data->keys_pressed[RAFGL_KEY_V]) rafgl_counters_request_export("logs/counters.csv");
+    if(game_data->keys_pressed[RAFGL_KEY_N]) depth_normals = !depth_normals;
+    if(game_data->keys_pressed[RAFGL_KEY_H]) ssao_level = (ssao_level + 1) % SSAO_LEVELS;
+    if(game_data->keys_pressed[RAFGL_KEY_J]) temporal_ssao = !temporal_ssao;
+    if(game_data->keys_pressed[RAFGL_KEY_K]) deinterleaved_ssao = !deinterleaved_ssao;
+    /* only takes effect without temporal SSAO, deinterleaving and horizon-based AO, and logs which of them is in the way */
+    if(game_data->keys_pressed[RAFGL_KEY_G])
+    {
+        compute_ssao = !compute_ssao;
+        log_compute_ssao_blocked();
+    }
+
+    if(game_data->keys_down[RAFGL_KEY_LEFT] || game_data->keys_down[RAFGL_KEY_RIGHT])
+    {
+        float light_angle = (game_data->keys_down[RAFGL_KEY_LEFT] ? 1.0f : -1.0f) * angle_speed * delta_time;
+        light_direction = m4_mul_dir(m4_rotation_y(light_angle), light_direction);
+    }
 
-    if(game_data->keys_pressed[RAFGL_KEY_KP_ADD]) selected_mesh = (selected_mesh + 1) % num_meshes;
-    if(game_data->keys_pressed[RAFGL_KEY_KP_SUBTRACT]) selected_mesh = (selected_mesh + num_meshes - 1) % num_meshes;
+    if(game_data->keys_pressed[RAFGL_KEY_KP_ADD]) selected_mesh = step_mesh(selected_mesh, 1);
+    if(game_data->keys_pressed[RAFGL_KEY_KP_SUBTRACT]) selected_mesh = step_mesh(selected_mesh, -1);
+    if(!meshes[selected_mesh].loaded) selected_mesh = step_mesh(selected_mesh, 1);
 
-    if(game_data->keys_down[RAFGL_KEY_ESCAPE]) glfwSetWindowShouldClose(window, GLFW_TRUE);
+    if(game_data->keys_down[RAFGL_KEY_ESCAPE]) rafgl_window_request_close();
 
     if(game_data->keys_down[RAFGL_KEY_SPACE]) camera_position.y += 1.0f * delta_time * move_speed;
     if(game_data->keys_down[RAFGL_KEY_LEFT_CONTROL]) camera_position.y -= 1.0f * delta_time * move_speed;
@@ -349,6 +844,21 @@ void main_state_update(GLFWwindow *window, float delta_time, rafgl_game_data_t *
         }
     }
 
+    if(scripted_path)
+    {
+        /* a function of time alone, so with a fixed delta every run sees the same frames:
+           one orbit every 8 s while moving in and out, the next loaded mesh every 2 s */
+        camera_angle = -M_PIf * 0.5f + time * 0.25f * M_PIf;
+        float distance = 5.0f + 1.5f * sinf(time * 0.5f);
+        camera_position = vec3(-cosf(camera_angle) * distance, 1.0f + 0.8f * sinf(time * 0.7f), -sinf(camera_angle) * distance);
+        aim_dir = v3_norm(v3_sub(camera_target, camera_position));
+        model_angle = time;
+
+        selected_mesh = step_mesh(num_meshes - 1, 1);
+        for(int i = (int)(time / 2.0f) % num_meshes; i > 0; i--)
+            selected_mesh = step_mesh(selected_mesh, 1);
+    }
+
     float aspect = ((float)(game_data->raster_width)) / game_data->raster_height;
     projection = m4_perspective(fov, aspect, 0.1f, 100.0f);
 
@@ -359,192 +869,725 @@ void main_state_update(GLFWwindow *window, float delta_time, rafgl_game_data_t *
     model = m4_mul(model, m4_translation(vec3(0.0f, sinf(model_angle) * 0.45, 0.0f)));
 
     view_projection = m4_mul(projection, view);
+
+    main_state_frame_t *frame = rafgl_snapshot_back(&frames);
+    frame->geometry.model = model;
+    frame->geometry.view = view;
+    frame->geometry.projection = projection;
+    frame->geometry.view_projection = view_projection;
+    frame->geometry.selected_mesh = selected_mesh;
+    frame->geometry.depth_normals = depth_normals;
+    frame->geometry.ssao_level = ssao_level;
+    frame->geometry.temporal_ssao = temporal_ssao;
+    frame->geometry.deinterleaved_ssao = deinterleaved_ssao;
+    frame->geometry.ao_method = ao_method;
+    /* temporal SSAO, deinterleaving and horizon-based AO only have fragment passes */
+    frame->geometry.compute_ssao = compute_ssao && ssao_compute_shader && !temporal_ssao && !deinterleaved_ssao && ao_method == MAIN_STATE_AO_KERNEL;
+    frame->lighting.camera_position = camera_position;
+    frame->lighting.object_colour = object_colour;
+    frame->lighting.light_colour = light_colour;
+    frame->lighting.light_direction = light_direction;
+    frame->lighting.ambient = ambient;
+    frame->lighting.selected_shader = selected_shader;
+    frame->lighting.off_ssao = off_ssao;
+    frame->latch.enabled = late_latch;
+    frame->latch.mouse_look = game_data->is_lmb_down;
+    frame->latch.camera_angle = camera_angle;
+    frame->latch.hoffset = hoffset;
+    frame->latch.raster_width = game_data->raster_width;
+    frame->latch.raster_height = game_data->raster_height;
+    frame->num_key_down = num_key_down;
+    frame->show_counters = show_counters;
+
+    /* the front copy is the last published frame, which render on demand only skips when it matched the one before */
+    if(memcmp(frame, rafgl_snapshot_front(&frames), sizeof(main_state_frame_t)))
+        rafgl_game_request_redraw();
 }
 
 
-void main_state_render(GLFWwindow *window, void *args)
+/* the selected mesh, or every stress scene instance with the vertex array only rebound when the mesh changes;
+   uni_previous_M gets the model of the last frame unless it is -1, the stress scene doesn't move */
+static void draw_meshes(const main_state_frame_t *frame, GLuint uni_M, GLint uni_previous_M)
 {
-    // Geometry pass
-    glBindFramebuffer(GL_FRAMEBUFFER, g_buffer.fbo_id);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    if(stress_scene.count == 0)
+    {
+        const rafgl_meshPUN_t *mesh = &meshes[frame->geometry.selected_mesh];
+
+        rafgl_gl_bind_vertex_array(mesh->vao_id);
+        rafgl_gl_uniform_matrix4fv(uni_M, 1, GL_FALSE, (void*) frame->geometry.model.m);
+        if(uni_previous_M >= 0)
+            rafgl_gl_uniform_matrix4fv(uni_previous_M, 1, GL_FALSE, (void*) previous_model.m);
+        rafgl_gl_draw_arrays(GL_TRIANGLES, 0, mesh->vertex_count);
+        return;
+    }
 
-    glUseProgram(g_buffer_shader);
+    int bound = -1;
+    for(int i = 0; i < stress_scene.count; i++)
+    {
+        const stress_instance_t *instance = &stress_scene.instances[i];
+
+        if(instance->mesh != bound)
+        {
+            bound = instance->mesh;
+            rafgl_gl_bind_vertex_array(meshes[bound].vao_id);
+        }
+        rafgl_gl_uniform_matrix4fv(uni_M, 1, GL_FALSE, (void*) instance->model.m);
+        if(uni_previous_M >= 0)
+            rafgl_gl_uniform_matrix4fv(uni_previous_M, 1, GL_FALSE, (void*) instance->model.m);
+        rafgl_gl_draw_arrays(GL_TRIANGLES, 0, meshes[bound].vertex_count);
+    }
+}
+
+// Geometry pass
+static void geometry_pass(const main_state_frame_t *frame)
+{
+    GLenum targets[2] =
+    {
+        frame->geometry.depth_normals ? GL_NONE : GL_COLOR_ATTACHMENT0,
+        frame->geometry.temporal_ssao ? GL_COLOR_ATTACHMENT1 : GL_NONE
+    };
+
+    rafgl_gl_bind_framebuffer(GL_FRAMEBUFFER, g_buffer.fbo_id);
+    /* with depth normals the normal the shader outputs goes nowhere, and so does the velocity without temporal SSAO */
+    glDrawBuffers(2, targets);
+    rafgl_gl_clear(targets[0] == GL_NONE && targets[1] == GL_NONE ? GL_DEPTH_BUFFER_BIT : GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    rafgl_gl_use_program(g_buffer_shader);
 
     glEnableVertexAttribArray(0);
     glEnableVertexAttribArray(1);
     glEnableVertexAttribArray(2);
 
-    glBindVertexArray(meshes[selected_mesh].vao_id);
-
-    glUniformMatrix4fv(g_buffer_uni_M, 1, GL_FALSE, (void*) model.m);
-    glUniformMatrix4fv(g_buffer_uni_VP, 1, GL_FALSE, (void*) view_projection.m);
+    rafgl_gl_uniform_matrix4fv(g_buffer_uni_VP, 1, GL_FALSE, (void*) frame->geometry.view_projection.m);
+    if(frame->geometry.temporal_ssao)
+        rafgl_gl_uniform_matrix4fv(g_buffer_uni_previous_VP, 1, GL_FALSE, (void*) previous_view_projection.m);
+    rafgl_latency_mark_upload();
 
-    glDrawArrays(GL_TRIANGLES, 0, meshes[selected_mesh].vertex_count);
+    draw_meshes(frame, g_buffer_uni_M, frame->geometry.temporal_ssao ? (GLint)g_buffer_uni_previous_M : -1);
 
-    glBindVertexArray(0);
+    rafgl_gl_bind_vertex_array(0);
     glDisableVertexAttribArray(2);
     glDisableVertexAttribArray(1);
     glDisableVertexAttribArray(0);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    rafgl_gl_bind_framebuffer(GL_FRAMEBUFFER, 0);
+}
 
+// Linear depth pyramid, level 0 from the G-buffer depth and each level after it from the one before
+static void depth_pyramid_pass(const main_state_frame_t *frame)
+{
+    const rafgl_pass_input_t depth_input[] = {{uni_depth_slot_linearize, g_buffer.depth_tex_id}};
+    const rafgl_pass_input_t pyramid_input[] = {{uni_pyramid_slot_downsample, depth_pyramid_tex}};
 
-    // Calculate SSAO texture
-    glBindFramebuffer(GL_FRAMEBUFFER, ssao_buffer.fbo_id);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    rafgl_gl_use_program(depth_linearize_shader);
+    rafgl_gl_uniform_matrix4fv(depth_linearize_uni_P, 1, GL_FALSE, (void*) frame->geometry.projection.m);
+    rafgl_pass_fullscreen(depth_linearize_shader, depth_pyramid_fbos[0], depth_input, 1);
 
-    glUseProgram(ssao_shader);
+    rafgl_gl_use_program(depth_downsample_shader);
+    for(int i = 1; i < depth_pyramid_levels; i++)
+    {
+        /* the level read is the only one exposed, so the one being written can't feed back into it */
+        rafgl_gl_bind_texture(GL_TEXTURE_2D, depth_pyramid_tex);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, i - 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, i - 1);
 
-    glUniform1i(uni_pos_slot_ssao, 0);
-    glUniform1i(uni_norm_slot_ssao, 1);
-    glUniform1i(uni_noise_slot_ssao, 2);
+        glViewport(0, 0, rafgl_max_m(screenW >> i, 1), rafgl_max_m(screenH >> i, 1));
+        rafgl_pass_fullscreen(depth_downsample_shader, depth_pyramid_fbos[i], pyramid_input, 1);
+    }
+    glViewport(0, 0, screenW, screenH);
 
-    glUniform1i(scw_ssao, screenW);
-    glUniform1i(sch_ssao, screenH);
+    rafgl_gl_bind_texture(GL_TEXTURE_2D, depth_pyramid_tex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, depth_pyramid_levels - 1);
+    rafgl_gl_bind_texture(GL_TEXTURE_2D, 0);
+}
 
-    // Position texture
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, g_buffer.tex_ids[0]);
-    glGenerateMipmap(GL_TEXTURE_2D);
-    // Normal texture
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, g_buffer.tex_ids[1]);
-    glGenerateMipmap(GL_TEXTURE_2D);
-    // Noise texture
-    glActiveTexture(GL_TEXTURE2);
-    glBindTexture(GL_TEXTURE_2D, noise_texture);
-    glGenerateMipmap(GL_TEXTURE_2D);
+// Depth and normals for SSAO below full resolution, the nearest or farthest pixel of each footprint;
+// with depth normals the normal is reconstructed here at full resolution, so the AO passes only do it at full resolution
+static void ssao_downsample_pass(const main_state_frame_t *frame)
+{
+    const ssao_target_t *target = &ssao_targets[frame->geometry.ssao_level];
+    const rafgl_pass_input_t inputs[] =
+    {
+        {uni_pyramid_slot_ssao_downsample, depth_pyramid_tex},
+        {uni_norm_slot_ssao_downsample, g_buffer.tex_ids[0]}
+    };
+
+    if(frame->geometry.ssao_level == 0)
+        return;
+
+    rafgl_gl_use_program(ssao_downsample_shader);
+    rafgl_gl_uniform1i(uni_factor_ssao_downsample, 1 << frame->geometry.ssao_level);
+    rafgl_gl_uniform1i(depth_normals_loc_ssao_downsample, frame->geometry.depth_normals);
+    rafgl_gl_uniform_matrix4fv(uni_P_ssao_downsample, 1, GL_FALSE, (void*) frame->geometry.projection.m);
+    rafgl_gl_uniform_matrix4fv(uni_V_ssao_downsample, 1, GL_FALSE, (void*) frame->geometry.view.m);
+
+    glViewport(0, 0, target->width, target->height);
+    rafgl_pass_fullscreen(ssao_downsample_shader, target->downsampled.fbo_id, inputs, 2);
+    glViewport(0, 0, screenW, screenH);
+}
 
-    glBindVertexArray(meshes[selected_mesh].vao_id);
+// Split the distance SSAO is rendered from into layers, one for every place in a 4x4 block
+static void ssao_deinterleave_pass(const main_state_frame_t *frame)
+{
+    const ssao_target_t *target = &ssao_targets[frame->geometry.ssao_level];
+    const rafgl_pass_input_t inputs[] =
+    {
+        {uni_centre_slot_deinterleave, frame->geometry.ssao_level > 0 ? target->downsampled.tex_ids[0] : depth_pyramid_tex}
+    };
 
-    glUniformMatrix4fv(ssao_buffer_uni_M, 1, GL_FALSE, (void*) model.m);
-    glUniformMatrix4fv(ssao_buffer_uni_P, 1, GL_FALSE, (void*) projection.m);
-    glUniformMatrix4fv(ssao_buffer_uni_V, 1, GL_FALSE, (void*) view.m);
+    if(!frame->geometry.deinterleaved_ssao || frame->geometry.ao_method != MAIN_STATE_AO_KERNEL)
+        return;
 
+    rafgl_gl_use_program(ssao_deinterleave_shader);
 
-    glDrawArrays(GL_TRIANGLES, 0, meshes[selected_mesh].vertex_count);
+    glViewport(0, 0, target->layer_width, target->layer_height);
+    for(int first = 0; first < SSAO_LAYERS; first += SSAO_DEINTERLEAVE_BATCH)
+    {
+        rafgl_gl_bind_framebuffer(GL_FRAMEBUFFER, target->deinterleave_fbo);
+        for(int i = 0; i < SSAO_DEINTERLEAVE_BATCH; i++)
+            glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, target->layer_depth, 0, first + i);
 
-    glBindVertexArray(0);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        rafgl_gl_uniform1i(uni_first_layer_deinterleave, first);
+        rafgl_pass_fullscreen(ssao_deinterleave_shader, target->deinterleave_fbo, inputs, 1);
+    }
+    glViewport(0, 0, screenW, screenH);
+}
 
+// Horizon-based AO into the same buffer as the kernel's, temporal SSAO turns the slices every frame
+static void horizon_ao_pass(const main_state_frame_t *frame)
+{
+    const ssao_target_t *target = &ssao_targets[frame->geometry.ssao_level];
+    const horizon_preset_t *preset = &horizon_presets[frame->geometry.ao_method];
+    int downsampled = frame->geometry.ssao_level > 0;
+    const rafgl_pass_input_t inputs[] =
+    {
+        {uni_pyramid_slot_horizon, depth_pyramid_tex},
+        {uni_centre_slot_horizon, downsampled ? target->downsampled.tex_ids[0] : depth_pyramid_tex},
+        {uni_norm_slot_horizon, downsampled ? target->downsampled.tex_ids[1] : g_buffer.tex_ids[0]}
+    };
+
+    rafgl_gl_use_program(horizon_ao_shader);
+
+    rafgl_gl_uniform1i(scw_horizon, target->width);
+    rafgl_gl_uniform1i(sch_horizon, target->height);
+    rafgl_gl_uniform1i(depth_normals_loc_horizon, frame->geometry.depth_normals && !downsampled);
+    rafgl_gl_uniform1i(uni_depth_mips_horizon, depth_pyramid_levels - 1);
+    rafgl_gl_uniform1i(uni_slices_horizon, preset->slices);
+    rafgl_gl_uniform1i(uni_steps_horizon, preset->steps);
+    rafgl_gl_uniform1f(uni_noise_rotation_horizon, frame->geometry.temporal_ssao ? fmodf(temporal_frame * 2.39996f, 2.0f * M_PIf) : 0.0f);
+
+    rafgl_gl_uniform_matrix4fv(uni_P_horizon, 1, GL_FALSE, (void*) frame->geometry.projection.m);
+    rafgl_gl_uniform_matrix4fv(uni_V_horizon, 1, GL_FALSE, (void*) frame->geometry.view.m);
+
+    glViewport(0, 0, target->width, target->height);
+    rafgl_pass_fullscreen(horizon_ao_shader, target->ssao.fbo_id, inputs, 3);
+    glViewport(0, 0, screenW, screenH);
+}
 
-    // Blur SSAO texture
-    glBindFramebuffer(GL_FRAMEBUFFER, ssao_blur_buffer.fbo_id);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+// Calculate SSAO texture
+static void ssao_pass(const main_state_frame_t *frame)
+{
+    const ssao_target_t *target = &ssao_targets[frame->geometry.ssao_level];
+    /* at full resolution the centre is level 0 of the pyramid and the normals are the G-buffer's own or rebuilt from
+       the depth here, below it both come from the downsample */
+    int downsampled = frame->geometry.ssao_level > 0;
+    const rafgl_pass_input_t inputs[] =
+    {
+        {uni_pyramid_slot_ssao, depth_pyramid_tex},
+        {uni_centre_slot_ssao, downsampled ? target->downsampled.tex_ids[0] : depth_pyramid_tex},
+        {uni_norm_slot_ssao, downsampled ? target->downsampled.tex_ids[1] : g_buffer.tex_ids[0]},
+        {uni_noise_slot_ssao, noise_texture},
+        {uni_layer_depth_slot_ssao, target->layer_depth, GL_TEXTURE_2D_ARRAY}
+    };
+    const rafgl_pass_input_t reinterleave_inputs[] = {{uni_ao_slot_reinterleave, target->layer_ao, GL_TEXTURE_2D_ARRAY}};
+
+    if(frame->geometry.ao_method != MAIN_STATE_AO_KERNEL)
+    {
+        horizon_ao_pass(frame);
+        return;
+    }
 
-    glUseProgram(ssao_blur_shader);
+    rafgl_gl_use_program(ssao_shader);
 
-    glUniform1i(uni_tex_slot_blur, 0);
+    rafgl_gl_uniform1i(scw_ssao, target->width);
+    rafgl_gl_uniform1i(sch_ssao, target->height);
+    rafgl_gl_uniform1i(depth_normals_loc_ssao, frame->geometry.depth_normals && !downsampled);
+    rafgl_gl_uniform1i(uni_depth_mips_ssao, depth_pyramid_levels - 1);
 
-    glUniform1i(scw_blur, screenW);
-    glUniform1i(sch_blur, screenH);
+    if(frame->geometry.temporal_ssao)
+    {
+        rafgl_gl_uniform1i(uni_first_sample_ssao, (temporal_frame * ssao_params.temporal_samples) % ssao_params.kernel_samples);
+        rafgl_gl_uniform1i(uni_frame_samples_ssao, ssao_params.temporal_samples);
+        /* steps of the golden angle never line the noise up with an earlier frame's */
+        rafgl_gl_uniform1f(uni_noise_rotation_ssao, fmodf(temporal_frame * 2.39996f, 2.0f * M_PIf));
+    }
+    else
+    {
+        rafgl_gl_uniform1i(uni_first_sample_ssao, 0);
+        rafgl_gl_uniform1i(uni_frame_samples_ssao, ssao_params.kernel_samples);
+        rafgl_gl_uniform1f(uni_noise_rotation_ssao, 0.0f);
+    }
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, ssao_buffer.tex_id);
-    glGenerateMipmap(GL_TEXTURE_2D);
+    rafgl_gl_uniform_matrix4fv(ssao_buffer_uni_P, 1, GL_FALSE, (void*) frame->geometry.projection.m);
+    rafgl_gl_uniform_matrix4fv(ssao_buffer_uni_V, 1, GL_FALSE, (void*) frame->geometry.view.m);
 
-    glBindVertexArray(meshes[selected_mesh].vao_id);
+    if(!frame->geometry.deinterleaved_ssao)
+    {
+        rafgl_gl_uniform1i(uni_layer_ssao, -1);
 
-    glUniformMatrix4fv(ssao_blur_buffer_uni_M, 1, GL_FALSE, (void*) model.m);
-    glUniformMatrix4fv(ssao_blur_buffer_uni_VP, 1, GL_FALSE, (void*) view_projection.m);
+        glViewport(0, 0, target->width, target->height);
+        rafgl_pass_fullscreen(ssao_shader, target->ssao.fbo_id, inputs, 5);
+        glViewport(0, 0, screenW, screenH);
+        return;
+    }
 
-    glDrawArrays(GL_TRIANGLES, 0, meshes[selected_mesh].vertex_count);
+    /* a layer's texels are a quarter of the target's size on each axis, 2^ssao_level times that of the window's */
+    rafgl_gl_uniform1i(uni_layer_mip_ssao, frame->geometry.ssao_level + 2);
 
-    glBindVertexArray(0);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, target->layer_width, target->layer_height);
+    for(int i = 0; i < SSAO_LAYERS; i++)
+    {
+        rafgl_gl_bind_framebuffer(GL_FRAMEBUFFER, target->layer_fbo);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, target->layer_ao, 0, i);
 
+        rafgl_gl_uniform1i(uni_layer_ssao, i);
+        rafgl_pass_fullscreen(ssao_shader, target->layer_fbo, inputs, 5);
+    }
 
-    // Skybox
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo.fbo_id);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glViewport(0, 0, target->width, target->height);
+    rafgl_pass_fullscreen(ssao_reinterleave_shader, target->ssao.fbo_id, reinterleave_inputs, 1);
+    glViewport(0, 0, screenW, screenH);
+}
 
-    glDepthMask(GL_FALSE);
+// SSAO and both blur passes in one compute dispatch, straight into the blur buffer
+static void ssao_compute_pass(const main_state_frame_t *frame)
+{
+    const ssao_target_t *target = &ssao_targets[frame->geometry.ssao_level];
+    int downsampled = frame->geometry.ssao_level > 0;
+    const rafgl_pass_input_t inputs[] =
+    {
+        {uni_pyramid_slot_compute, depth_pyramid_tex},
+        {uni_centre_slot_compute, downsampled ? target->downsampled.tex_ids[0] : depth_pyramid_tex},
+        {uni_norm_slot_compute, downsampled ? target->downsampled.tex_ids[1] : g_buffer.tex_ids[0]},
+        {uni_noise_slot_compute, noise_texture}
+    };
+
+    rafgl_gl_use_program(ssao_compute_shader);
+
+    rafgl_gl_uniform1i(scw_compute, target->width);
+    rafgl_gl_uniform1i(sch_compute, target->height);
+    rafgl_gl_uniform1i(depth_normals_loc_compute, frame->geometry.depth_normals && !downsampled);
+    rafgl_gl_uniform1i(uni_depth_mips_compute, depth_pyramid_levels - 1);
+    rafgl_gl_uniform1i(uni_full_resolution_compute, !downsampled);
+
+    rafgl_gl_uniform_matrix4fv(uni_P_compute, 1, GL_FALSE, (void*) frame->geometry.projection.m);
+    rafgl_gl_uniform_matrix4fv(uni_V_compute, 1, GL_FALSE, (void*) frame->geometry.view.m);
+
+    rafgl_gl_bind_image_texture(0, target->blur.tex_id, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RG16F);
+    rafgl_pass_compute(ssao_compute_shader, inputs, 4, (target->width + SSAO_COMPUTE_TILE - 1) / SSAO_COMPUTE_TILE,
+                       (target->height + SSAO_COMPUTE_TILE - 1) / SSAO_COMPUTE_TILE);
+    /* lighting and present sample the result, readbacks get it with glGetTexImage and the fragment blur may draw over it next */
+    rafgl_gl_memory_barrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT);
+    rafgl_gl_bind_image_texture(0, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RG16F);
+}
 
-    glUseProgram(skybox_shader);
-    glUniformMatrix4fv(skybox_uni_V, 1, GL_FALSE, (void*) view.m);
-    glUniformMatrix4fv(skybox_uni_P, 1, GL_FALSE, (void*) projection.m);
+// Makes or deletes the velocity attachment and the histories when temporal SSAO is turned on or off
+static void temporal_targets_update(int enabled)
+{
+    if(enabled == (velocity_tex != 0))
+        return;
 
-    glBindVertexArray(skybox_mesh.vao_id);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, skybox_tex.tex_id);
+    if(enabled)
+    {
+        rafgl_gpu_set_scope("g_buffer");
+        velocity_tex = rafgl_gpu_gen_texture("velocity");
+        rafgl_gl_bind_texture(GL_TEXTURE_2D, velocity_tex);
+        rafgl_gl_tex_image_2d(GL_TEXTURE_2D, 0, GL_RGBA16F, screenW, screenH, GL_RGBA, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        rafgl_gl_bind_texture(GL_TEXTURE_2D, 0);
+
+        rafgl_gpu_set_scope("ssao history");
+        for(int i = 0; i < SSAO_LEVELS; i++)
+        {
+            ssao_targets[i].history[0] = rafgl_framebuffer_simple_create(ssao_targets[i].width, ssao_targets[i].height, GL_RGBA16F);
+            ssao_targets[i].history[1] = rafgl_framebuffer_simple_create(ssao_targets[i].width, ssao_targets[i].height, GL_RGBA16F);
+        }
+        rafgl_gpu_set_scope(NULL);
+    }
 
-    glDrawArrays(GL_TRIANGLES, 0, skybox_mesh.vertex_count);
-    glDepthMask(GL_TRUE);
+    rafgl_gl_bind_framebuffer(GL_FRAMEBUFFER, g_buffer.fbo_id);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, enabled ? velocity_tex : 0, 0);
+    rafgl_gl_bind_framebuffer(GL_FRAMEBUFFER, 0);
 
-    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    if(!enabled)
+    {
+        for(int i = 0; i < SSAO_LEVELS; i++)
+        {
+            rafgl_framebuffer_simple_cleanup(&ssao_targets[i].history[0]);
+            rafgl_framebuffer_simple_cleanup(&ssao_targets[i].history[1]);
+        }
+        rafgl_gpu_delete_texture(velocity_tex);
+        velocity_tex = 0;
+    }
+}
 
+// Blend this frame's AO into the history reprojected from the last one, moved says if the velocity is this frame's
+static void ssao_temporal_pass(const main_state_frame_t *frame, int moved)
+{
+    const ssao_target_t *target = &ssao_targets[frame->geometry.ssao_level];
+    int downsampled = frame->geometry.ssao_level > 0;
+    const rafgl_pass_input_t inputs[] =
+    {
+        {uni_current_slot_temporal, target->ssao.tex_id},
+        {uni_history_slot_temporal, target->history[history_index].tex_id},
+        {uni_velocity_slot_temporal, velocity_tex},
+        {uni_norm_slot_temporal, downsampled ? target->downsampled.tex_ids[1] : g_buffer.tex_ids[0]}
+    };
+
+    if(!frame->geometry.temporal_ssao)
+        return;
+
+    rafgl_gl_use_program(ssao_temporal_shader);
+
+    rafgl_gl_uniform1i(scw_temporal, target->width);
+    rafgl_gl_uniform1i(sch_temporal, target->height);
+    rafgl_gl_uniform1i(depth_normals_loc_temporal, frame->geometry.depth_normals);
+    rafgl_gl_uniform1i(uni_moved_temporal, moved);
+    /* a plain average until the history is as long as it gets, an exponential one after that */
+    rafgl_gl_uniform1f(uni_blend_temporal, rafgl_max_m(1.0f / (history_frames + 1), 1.0f / SSAO_TEMPORAL_HISTORY));
+
+    glViewport(0, 0, target->width, target->height);
+    rafgl_pass_fullscreen(ssao_temporal_shader, target->history[1 - history_index].fbo_id, inputs, 4);
+    glViewport(0, 0, screenW, screenH);
+
+    history_index = 1 - history_index;
+    history_frames++;
+    temporal_frame++;
+}
+
+// Blur SSAO texture, along x and then along y, taps off the pixel's surface count for little
+static void ssao_blur_pass(const main_state_frame_t *frame)
+{
+    const ssao_target_t *target = &ssao_targets[frame->geometry.ssao_level];
+    GLuint ao_tex = frame->geometry.temporal_ssao ? target->history[history_index].tex_id : target->ssao.tex_id;
+    const rafgl_pass_input_t horizontal_inputs[] = {{uni_tex_slot_blur, ao_tex}};
+    const rafgl_pass_input_t vertical_inputs[] = {{uni_tex_slot_blur, target->horizontal.tex_id}};
 
-    // Lightning pass
-    glUseProgram(object_shader[selected_shader]);
+    rafgl_gl_use_program(ssao_blur_shader);
 
-    glBindTexture(GL_TEXTURE_CUBE_MAP, skybox_tex.tex_id);
+    glViewport(0, 0, target->width, target->height);
 
-    glUniform1i(uni_pos_slot, 0);
-    glUniform1i(uni_norm_slot, 1);
-    glUniform1i(uni_ssao_slot, 2);
+    rafgl_gl_uniform1i(uni_vertical_blur, 0);
+    rafgl_pass_fullscreen(ssao_blur_shader, target->horizontal.fbo_id, horizontal_inputs, 1);
 
-    glUniform1i(scw_obj0, screenW);
-    glUniform1i(sch_obj0, screenH);
+    rafgl_gl_uniform1i(uni_vertical_blur, 1);
+    rafgl_pass_fullscreen(ssao_blur_shader, target->blur.fbo_id, vertical_inputs, 1);
+
+    glViewport(0, 0, screenW, screenH);
+}
+
+// Skybox
+static void skybox_pass(const main_state_frame_t *frame)
+{
+    rafgl_gl_bind_framebuffer(GL_FRAMEBUFFER, fbo.fbo_id);
+    rafgl_gl_clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    rafgl_gl_depth_mask(GL_FALSE);
+
+    rafgl_gl_use_program(skybox_shader);
+    rafgl_gl_uniform_matrix4fv(skybox_uni_V, 1, GL_FALSE, (void*) frame->geometry.view.m);
+    rafgl_gl_uniform_matrix4fv(skybox_uni_P, 1, GL_FALSE, (void*) frame->geometry.projection.m);
+
+    rafgl_gl_bind_vertex_array(skybox_mesh.vao_id);
+    rafgl_gl_bind_texture(GL_TEXTURE_CUBE_MAP, skybox_tex.tex_id);
+
+    rafgl_gl_draw_arrays(GL_TRIANGLES, 0, skybox_mesh.vertex_count);
+    rafgl_gl_depth_mask(GL_TRUE);
+
+    rafgl_gl_bind_texture(GL_TEXTURE_CUBE_MAP, 0);
+}
+
+// Lightning pass
+static void lighting_pass(const main_state_frame_t *frame)
+{
+    int shader = frame->lighting.selected_shader;
+    const ssao_target_t *target = &ssao_targets[frame->geometry.ssao_level];
+
+    rafgl_gl_use_program(object_shader[shader]);
+
+    rafgl_gl_bind_texture(GL_TEXTURE_CUBE_MAP, skybox_tex.tex_id);
+
+    rafgl_gl_uniform1i(uni_norm_slot, 1);
+    rafgl_gl_uniform1i(uni_ssao_slot, 2);
+    rafgl_gl_uniform1i(uni_pyramid_slot, 3);
+    rafgl_gl_uniform1i(uni_ssao_normal_slot, 4);
+
+    rafgl_gl_uniform1i(scw_obj0, screenW);
+    rafgl_gl_uniform1i(sch_obj0, screenH);
 
-    // Position texture
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, g_buffer.tex_ids[0]);
-    glGenerateMipmap(GL_TEXTURE_2D);
     // Normal texture
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, g_buffer.tex_ids[1]);
-    glGenerateMipmap(GL_TEXTURE_2D);
+    rafgl_gl_active_texture(GL_TEXTURE1);
+    rafgl_gl_bind_texture(GL_TEXTURE_2D, g_buffer.tex_ids[0]);
     // SSAO texture
-    glActiveTexture(GL_TEXTURE2);
-    glBindTexture(GL_TEXTURE_2D, ssao_blur_buffer.tex_id);
-    glGenerateMipmap(GL_TEXTURE_2D);
+    rafgl_gl_active_texture(GL_TEXTURE2);
+    rafgl_gl_bind_texture(GL_TEXTURE_2D, target->blur.tex_id);
+    // What the upsample below full resolution is guided by
+    rafgl_gl_active_texture(GL_TEXTURE3);
+    rafgl_gl_bind_texture(GL_TEXTURE_2D, depth_pyramid_tex);
+    rafgl_gl_active_texture(GL_TEXTURE4);
+    rafgl_gl_bind_texture(GL_TEXTURE_2D, target->downsampled.tex_ids[1]);
 
-    glBindVertexArray(meshes[selected_mesh].vao_id);
+    rafgl_gl_uniform_matrix4fv(object_uni_VP[shader], 1, GL_FALSE, (void*) frame->geometry.view_projection.m);
 
-    glUniformMatrix4fv(object_uni_M[selected_shader], 1, GL_FALSE, (void*) model.m);
-    glUniformMatrix4fv(object_uni_VP[selected_shader], 1, GL_FALSE, (void*) view_projection.m);
+    rafgl_gl_uniform3f(object_uni_object_colour[shader], frame->lighting.object_colour.x, frame->lighting.object_colour.y, frame->lighting.object_colour.z);
+    rafgl_gl_uniform3f(object_uni_light_colour[shader], frame->lighting.light_colour.x, frame->lighting.light_colour.y, frame->lighting.light_colour.z);
+    rafgl_gl_uniform3f(object_uni_light_direction[shader], frame->lighting.light_direction.x, frame->lighting.light_direction.y, frame->lighting.light_direction.z);
+    rafgl_gl_uniform3f(object_uni_ambient[shader], frame->lighting.ambient.x, frame->lighting.ambient.y, frame->lighting.ambient.z);
+    rafgl_gl_uniform3f(object_uni_camera_position[shader], frame->lighting.camera_position.x, frame->lighting.camera_position.y, frame->lighting.camera_position.z);
+    rafgl_gl_uniform1i(off_ssao_loc, frame->lighting.off_ssao);
+    rafgl_gl_uniform1i(depth_normals_loc, frame->geometry.depth_normals);
+    rafgl_gl_uniform1i(ssao_resolution_loc, 1 << frame->geometry.ssao_level);
 
-    glUniform3f(object_uni_object_colour[selected_shader], object_colour.x, object_colour.y, object_colour.z);
-    glUniform3f(object_uni_light_colour[selected_shader], light_colour.x, light_colour.y, light_colour.z);
-    glUniform3f(object_uni_light_direction[selected_shader], light_direction.x, light_direction.y, light_direction.z);
-    glUniform3f(object_uni_ambient[selected_shader], ambient.x, ambient.y, ambient.z);
-    glUniform3f(object_uni_camera_position[selected_shader], camera_position.x, camera_position.y, camera_position.z);
-    glUniform1i(off_ssao_loc, off_ssao);
+    draw_meshes(frame, object_uni_M[shader], -1);
 
-    glDrawArrays(GL_TRIANGLES, 0, meshes[selected_mesh].vertex_count);
+    rafgl_gl_bind_vertex_array(0);
 
-    glBindVertexArray(0);
+    rafgl_gl_bind_texture(GL_TEXTURE_CUBE_MAP, 0);
 
-    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    rafgl_gl_bind_framebuffer(GL_FRAMEBUFFER, 0);
+}
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+GLuint main_state_buffer_texture(int index)
+{
+    if(index == MAIN_STATE_BUFFER_DEPTH)
+        return g_buffer.depth_tex_id;
+    else if(index == MAIN_STATE_BUFFER_NORMAL)
+        return g_buffer.tex_ids[0];
+    else if(index == MAIN_STATE_BUFFER_SSAO)
+        /* the compute path never writes the AO before its blur */
+        return last_rendered.geometry.compute_ssao ? ssao_targets[last_rendered.geometry.ssao_level].blur.tex_id :
+                                                     ssao_targets[last_rendered.geometry.ssao_level].ssao.tex_id;
+    else if(index == MAIN_STATE_BUFFER_SSAO_BLUR)
+        return ssao_targets[last_rendered.geometry.ssao_level].blur.tex_id;
+    else
+        return fbo.tex_id;
+}
 
-    glDisable(GL_DEPTH_TEST);
+/* the counters of the previous frame in the top left corner, blended over whatever present showed */
+static void counters_overlay(void)
+{
+    GLint viewport[4];
+    int i;
+
+    for(i = 0; i < counters_raster.width * counters_raster.height; i++)
+    {
+        counters_raster.data[i].rgba = rafgl_RGBA(0, 0, 0, 160);
+    }
+    rafgl_counters_draw(&counters_raster, 4, 4, rafgl_RGB(255, 255, 255), 1);
+    rafgl_texture_load_from_raster(&counters_tex, &counters_raster);
+
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glViewport(viewport[0] + 8, viewport[1] + viewport[3] - COUNTERS_OVERLAY_HEIGHT - 8, COUNTERS_OVERLAY_WIDTH, COUNTERS_OVERLAY_HEIGHT);
+
+    rafgl_gl_enable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    rafgl_texture_show(&counters_tex, 0);
+    rafgl_gl_disable(GL_BLEND);
+
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
+// Shows fbo or one of the intermediate buffers
+static void present(const main_state_frame_t *frame)
+{
+    rafgl_gl_disable(GL_DEPTH_TEST);
 
     rafgl_texture_t tmptex;
+    /* the SSAO buffers keep the distance in green, only their AO is shown */
+    int ao_only = frame->num_key_down == MAIN_STATE_BUFFER_SSAO || frame->num_key_down == MAIN_STATE_BUFFER_SSAO_BLUR;
 
-    if(num_key_down == 1)
-        tmptex.tex_id = g_buffer.tex_ids[0];
-    else if(num_key_down == 2)
-        tmptex.tex_id = g_buffer.tex_ids[1];
-    else if(num_key_down == 3)
-        tmptex.tex_id = ssao_buffer.tex_id;
-    else if(num_key_down == 4)
-        tmptex.tex_id = ssao_blur_buffer.tex_id;
-    else
-        tmptex.tex_id = fbo.tex_id;
+    tmptex.tex_id = main_state_buffer_texture(frame->num_key_down);
+
+    if(ao_only)
+    {
+        rafgl_gl_bind_texture(GL_TEXTURE_2D, tmptex.tex_id);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, GL_RED);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_RED);
+    }
 
     rafgl_texture_show(&tmptex, 1);
+
+    if(ao_only)
+    {
+        rafgl_gl_bind_texture(GL_TEXTURE_2D, tmptex.tex_id);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, GL_GREEN);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_BLUE);
+        rafgl_gl_bind_texture(GL_TEXTURE_2D, 0);
+    }
+
+    if(frame->show_counters)
+        counters_overlay();
     
-    glEnable(GL_DEPTH_TEST);
+    rafgl_gl_enable(GL_DEPTH_TEST);
+}
+
 
+/* update recentres the cursor after every mouse look step, so whatever it moved since then is input update hasn't seen yet */
+static void late_latch_camera(main_state_frame_t *frame)
+{
+    double x, y;
+    float ydelta, xdelta;
+
+    rafgl_input_latch_cursor(&x, &y);
+
+    ydelta = y - frame->latch.raster_height / 2;
+    xdelta = x - frame->latch.raster_width / 2;
+
+    float latched_hoffset = frame->latch.hoffset - sensitivity * ydelta / frame->latch.raster_height;
+    float latched_angle = frame->latch.camera_angle + sensitivity * xdelta / frame->latch.raster_width;
+
+    vec3_t latched_aim_dir = v3_norm(vec3(cosf(latched_angle), latched_hoffset, sinf(latched_angle)));
+    vec3_t position = frame->lighting.camera_position;
+
+    frame->geometry.view = m4_look_at(position, v3_add(position, latched_aim_dir), camera_up);
+    frame->geometry.view_projection = m4_mul(frame->geometry.projection, frame->geometry.view);
+}
+
+void main_state_render(GLFWwindow *window, void *args)
+{
+    main_state_frame_t latched;
+    const main_state_frame_t *frame = rafgl_snapshot_front(&frames);
+
+    if(frame->latch.enabled && frame->latch.mouse_look)
+    {
+        latched = *frame;
+        late_latch_camera(&latched);
+        frame = &latched;
+    }
+
+    /* SSAO only depends on geometry, so when just the lighting changed the G-buffer, SSAO and blur are reused */
+    int geometry_changed = !last_rendered_valid || memcmp(&frame->geometry, &last_rendered.geometry, sizeof(frame->geometry));
+    /* the history carries over only while temporal SSAO stays on at the same resolution, normals, method and parameters */
+    if(!last_rendered_valid || !last_rendered.geometry.temporal_ssao || ssao_params_changed ||
+       last_rendered.geometry.ssao_level != frame->geometry.ssao_level || last_rendered.geometry.depth_normals != frame->geometry.depth_normals ||
+       last_rendered.geometry.ao_method != frame->geometry.ao_method)
+        history_frames = 0;
+    if(geometry_changed)
+        settle_frames = 0;
+    temporal_targets_update(frame->geometry.temporal_ssao);
+    /* temporal SSAO keeps accumulating for a while after the last change, even when nothing else is redrawn */
+    int temporal_settling = frame->geometry.temporal_ssao && settle_frames < 2 * SSAO_TEMPORAL_HISTORY;
+    int ssao_changed = geometry_changed || ssao_params_changed || temporal_settling;
+    int lighting_changed = ssao_changed || memcmp(&frame->lighting, &last_rendered.lighting, sizeof(frame->lighting));
+
+    previous_model = last_rendered_valid ? last_rendered.geometry.model : frame->geometry.model;
+    previous_view_projection = last_rendered_valid ? last_rendered.geometry.view_projection : frame->geometry.view_projection;
+
+    last_rendered = *frame;
+    last_rendered_valid = 1;
+    ssao_params_changed = 0;
+
+    if(geometry_changed)
+    {
+        RAFGL_PROFILE_SCOPE("geometry") geometry_pass(frame);
+        RAFGL_PROFILE_SCOPE("pyramid") depth_pyramid_pass(frame);
+        RAFGL_PROFILE_SCOPE("ssao downsample") ssao_downsample_pass(frame);
+        RAFGL_PROFILE_SCOPE("ssao deinterleave") ssao_deinterleave_pass(frame);
+    }
+
+    if(ssao_changed && frame->geometry.compute_ssao)
+    {
+        RAFGL_PROFILE_SCOPE("ssao compute") ssao_compute_pass(frame);
+    }
+    else if(ssao_changed)
+    {
+        RAFGL_PROFILE_SCOPE("ssao") ssao_pass(frame);
+        RAFGL_PROFILE_SCOPE("temporal") ssao_temporal_pass(frame, geometry_changed);
+        RAFGL_PROFILE_SCOPE("blur") ssao_blur_pass(frame);
+
+        if(frame->geometry.temporal_ssao && ++settle_frames < 2 * SSAO_TEMPORAL_HISTORY)
+            rafgl_game_request_redraw();
+    }
+
+    if(lighting_changed)
+    {
+        RAFGL_PROFILE_SCOPE("skybox") skybox_pass(frame);
+        RAFGL_PROFILE_SCOPE("lighting") lighting_pass(frame);
+    }
+
+    RAFGL_PROFILE_SCOPE("present") present(frame);
 }
 
 
+void main_state_render_ssao(void)
+{
+    if(!last_rendered_valid) return;
+
+    if(last_rendered.geometry.compute_ssao)
+    {
+        ssao_compute_pass(&last_rendered);
+        return;
+    }
+
+    ssao_pass(&last_rendered);
+    ssao_temporal_pass(&last_rendered, 0);
+    ssao_blur_pass(&last_rendered);
+}
+
 void main_state_cleanup(GLFWwindow *window, void *args)
 {
-    glDeleteShader(ssao_shader);
-    glDeleteShader(ssao_blur_shader);
-    glDeleteShader(g_buffer_shader);
-    glDeleteShader(skybox_shader);
-    glDeleteShader(skybox_shader_cell);
-    glDeleteShader(object_shader[0]);
+    glDeleteProgram(ssao_shader);
+    glDeleteProgram(horizon_ao_shader);
+    if(ssao_compute_shader)
+        glDeleteProgram(ssao_compute_shader);
+    glDeleteProgram(ssao_blur_shader);
+    glDeleteProgram(g_buffer_shader);
+    glDeleteProgram(depth_linearize_shader);
+    glDeleteProgram(depth_downsample_shader);
+    glDeleteProgram(ssao_downsample_shader);
+    glDeleteProgram(ssao_temporal_shader);
+    glDeleteProgram(ssao_deinterleave_shader);
+    glDeleteProgram(ssao_reinterleave_shader);
+    glDeleteProgram(skybox_shader);
+    glDeleteProgram(skybox_shader_cell);
+    for(int i = 0; i < NUM_SHADERS; i++)
+        glDeleteProgram(object_shader[i]);
+
+    temporal_targets_update(0);
+    rafgl_framebuffer_multitarget_cleanup(&g_buffer);
+    for(int i = 0; i < depth_pyramid_levels; i++)
+        rafgl_gpu_delete_framebuffer(depth_pyramid_fbos[i]);
+    rafgl_gpu_delete_texture(depth_pyramid_tex);
+    depth_pyramid_tex = 0;
+    for(int i = 0; i < SSAO_LEVELS; i++)
+    {
+        rafgl_framebuffer_simple_cleanup(&ssao_targets[i].ssao);
+        rafgl_framebuffer_simple_cleanup(&ssao_targets[i].horizontal);
+        rafgl_framebuffer_simple_cleanup(&ssao_targets[i].blur);
+        rafgl_gpu_delete_framebuffer(ssao_targets[i].deinterleave_fbo);
+        rafgl_gpu_delete_framebuffer(ssao_targets[i].layer_fbo);
+        rafgl_gpu_delete_texture(ssao_targets[i].layer_depth);
+        rafgl_gpu_delete_texture(ssao_targets[i].layer_ao);
+        if(i > 0)
+            rafgl_framebuffer_multitarget_cleanup(&ssao_targets[i].downsampled);
+    }
+    rafgl_framebuffer_simple_cleanup(&fbo);
+
+    rafgl_texture_cleanup(&skybox_tex);
+    rafgl_gpu_delete_texture(noise_texture);
+    noise_texture = 0;
+
+    rafgl_meshPUN_cleanup(&skybox_mesh);
+    for(int i = 0; i < num_meshes; i++)
+        rafgl_meshPUN_cleanup(meshes + i);
+
+    rafgl_game_set_snapshot(NULL);
+    rafgl_snapshot_cleanup(&frames);
+    last_rendered_valid = 0;
+
+    stress_scene_cleanup(&stress_scene);
+
+    rafgl_raster_cleanup(&counters_raster);
+    rafgl_texture_cleanup(&counters_tex);
 }
\ No newline at end of file
@@ -0,0 +1,162 @@
+#include <stress_scene.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/* xorshift32, rand() differs between C libraries and the scene has to be the same everywhere */
+static uint32_t next_random(uint32_t *state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+/* [0, 1) */
+static float random_float(uint32_t *state)
+{
+    return (next_random(state) >> 8) / 16777216.0f;
+}
+
+static float random_range(uint32_t *state, float lower, float upper)
+{
+    return lower + (upper - lower) * random_float(state);
+}
+
+void stress_scene_default_params(stress_scene_params_t *params)
+{
+    params->seed = 1;
+    params->instance_count = 0;
+    params->depth_layers = 4;
+    params->layer_spacing = 2.0f;
+    params->coverage = 0.8f;
+    params->eye = vec3(0.0f, 1.0f, 6.5f);
+    params->fov = 75.0f;
+    params->aspect = 16.0f / 9.0f;
+    params->scale_min = 0.15f;
+    params->scale_max = 0.45f;
+    params->crevice_fraction = 0.1f;
+    params->thin_fraction = 0.1f;
+}
+
+int stress_scene_parse_arg(stress_scene_params_t *params, int argc, char *argv[], int *i)
+{
+    if(*i + 1 >= argc) return 0;
+
+    if(!strcmp(argv[*i], "--stress"))
+        params->instance_count = atoi(argv[*i + 1]);
+    else if(!strcmp(argv[*i], "--stress-seed"))
+        params->seed = strtoul(argv[*i + 1], NULL, 10);
+    else if(!strcmp(argv[*i], "--stress-layers"))
+        params->depth_layers = atoi(argv[*i + 1]);
+    else if(!strcmp(argv[*i], "--stress-coverage"))
+        params->coverage = atof(argv[*i + 1]);
+    else if(!strcmp(argv[*i], "--stress-crevices"))
+        params->crevice_fraction = atof(argv[*i + 1]);
+    else if(!strcmp(argv[*i], "--stress-thin"))
+        params->thin_fraction = atof(argv[*i + 1]);
+    else
+        return 0;
+
+    (*i)++;
+    return 1;
+}
+
+static int compare_instances(const void *a, const void *b)
+{
+    const stress_instance_t *ia = a, *ib = b;
+    return ia->mesh - ib->mesh;
+}
+
+static mat4_t instance_transform(vec3_t position, float yaw, float pitch, vec3_t scale)
+{
+    mat4_t model = m4_translation(position);
+    model = m4_mul(model, m4_rotation_y(yaw));
+    model = m4_mul(model, m4_rotation_x(pitch));
+    return m4_mul(model, m4_scaling(scale));
+}
+
+int stress_scene_generate(stress_scene_t *scene, const stress_scene_params_t *params, const int *mesh_ids, int mesh_id_count)
+{
+    uint32_t state = params->seed ? params->seed : 0x9e3779b9u;
+    int layers = rafgl_max_m(params->depth_layers, 1);
+    float tan_half_fov = tanf(params->fov * 0.5f * M_PIf / 180.0f);
+    int i = 0;
+
+    scene->count = 0;
+    scene->instances = NULL;
+    if(params->instance_count <= 0 || mesh_id_count <= 0) return -1;
+
+    scene->instances = malloc(params->instance_count * sizeof(stress_instance_t));
+    if(scene->instances == NULL)
+    {
+        rafgl_log(RAFGL_ERROR, "Failed to allocate %d stress scene instances!\n", params->instance_count);
+        return -1;
+    }
+
+    while(i < params->instance_count)
+    {
+        /* copies are dealt out to the slabs in turn, so every slab gets the same share */
+        int layer = i % layers;
+        float z = -layer * params->layer_spacing;
+        float half_height = params->coverage * (params->eye.z - z) * tan_half_fov;
+        float half_width = half_height * params->aspect;
+
+        vec3_t position = vec3(params->eye.x + random_range(&state, -half_width, half_width),
+                               params->eye.y + random_range(&state, -half_height, half_height),
+                               z + random_range(&state, -0.25f, 0.25f) * params->layer_spacing);
+        float s = random_range(&state, params->scale_min, params->scale_max);
+        vec3_t scale = vec3(s, s, s);
+        float yaw = random_range(&state, 0.0f, 2.0f * M_PIf);
+        float pitch = random_range(&state, -0.5f, 0.5f);
+        int mesh = mesh_ids[next_random(&state) % mesh_id_count];
+        float kind = random_float(&state);
+
+        if(kind < params->thin_fraction)
+        {
+            /* slivers a few pixels wide: plates when one axis is squashed, needles when two are */
+            float *axes[3] = {&scale.x, &scale.y, &scale.z};
+            int axis = next_random(&state) % 3;
+            *axes[axis] *= 0.03f;
+            if(next_random(&state) & 1) *axes[(axis + 1) % 3] *= 0.03f;
+        }
+
+        scene->instances[i].model = instance_transform(position, yaw, pitch, scale);
+        scene->instances[i].mesh = mesh;
+        i++;
+
+        if(kind >= params->thin_fraction && kind < params->thin_fraction + params->crevice_fraction && i < params->instance_count)
+        {
+            /* a second copy turned around and pushed into the first, the seam between them is a narrow deep crevice */
+            float gap_angle = random_range(&state, 0.0f, 2.0f * M_PIf);
+            vec3_t offset = vec3(cosf(gap_angle) * s * 0.7f, random_range(&state, -0.1f, 0.1f) * s, sinf(gap_angle) * s * 0.7f);
+
+            scene->instances[i].model = instance_transform(v3_add(position, offset), yaw + M_PIf, -pitch, scale);
+            scene->instances[i].mesh = mesh;
+            i++;
+        }
+    }
+
+    /* the sort has to be stable across C libraries too, so ties are broken by the original order */
+    for(i = 0; i < params->instance_count; i++)
+    {
+        scene->instances[i].mesh = scene->instances[i].mesh * params->instance_count + i;
+    }
+    qsort(scene->instances, params->instance_count, sizeof(stress_instance_t), compare_instances);
+    for(i = 0; i < params->instance_count; i++)
+    {
+        scene->instances[i].mesh /= params->instance_count;
+    }
+
+    scene->count = params->instance_count;
+    return 0;
+}
+
+void stress_scene_cleanup(stress_scene_t *scene)
+{
+    free(scene->instances);
+    scene->instances = NULL;
+    scene->count = 0;
+}
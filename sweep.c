@@ -0,0 +1,436 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#define RAFGL_IMPLEMENTATION
+#include <rafgl.h>
+
+#include <game_constants.h>
+#include <main_state.h>
+#include <image_diff.h>
+
+#ifndef RAFGL_BENCH_COMMIT
+#define RAFGL_BENCH_COMMIT "unknown"
+#endif // RAFGL_BENCH_COMMIT
+
+#define SWEEP_FIXED_DELTA (1.0f / 60.0f)
+/* same spacing as the golden views, half a second into each mesh of the scripted path */
+#define SWEEP_FIRST_FRAME 30
+#define SWEEP_FRAME_STEP 120
+#define SWEEP_MAX_VALUES 16
+#define SWEEP_MAX_REPS 64
+/* the reference kernel is re-seeded for every pass, so it averages this many different kernels */
+#define SWEEP_REFERENCE_SEED 1000
+
+typedef struct _sweep_axis_t
+{
+    float values[SWEEP_MAX_VALUES];
+    int count;
+} sweep_axis_t;
+
+typedef struct _sweep_point_t
+{
+    main_state_ssao_params_t params;
+    /* SSAO and blur together, median over the repetitions, averaged over the views */
+    double gpu_ms;
+    /* of the blurred AO against the reference, over the views */
+    double mse, ssim;
+    int pareto;
+} sweep_point_t;
+
+static int sweep_width = 640, sweep_height = 360;
+static int sweep_views = 3, sweep_reps = 5, reference_passes = 4;
+static const char *sweep_out = "logs/sweep";
+static double max_rmse = -1.0;
+
+static sweep_axis_t samples_axis = {{8, 16, 32, 64}, 4};
+static sweep_axis_t radius_axis = {{0.25f, 0.5f, 1.0f}, 3};
+static sweep_axis_t bias_axis = {{0.025f}, 1};
+static sweep_axis_t noise_axis = {{2, 4, 8}, 3};
+static sweep_axis_t blur_axis = {{0, 2, 4}, 3};
+
+static sweep_point_t *points = NULL;
+static int point_count = 0;
+
+static int frame = 0, view = 0;
+static GLuint query;
+
+static int parse_axis(sweep_axis_t *axis, const char *list)
+{
+    char *end;
+
+    axis->count = 0;
+    while(*list && axis->count < SWEEP_MAX_VALUES)
+    {
+        axis->values[axis->count] = strtof(list, &end);
+        if(end == list) break;
+        axis->count++;
+        list = *end == ',' ? end + 1 : end;
+    }
+    return axis->count;
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+    double da = *(const double*)a, db = *(const double*)b;
+    return (da > db) - (da < db);
+}
+
+/* GPU time of one SSAO and blur pass, the median of sweep_reps runs */
+static double time_ssao(void)
+{
+    double ms[SWEEP_MAX_REPS];
+    GLuint64 ns;
+    int i;
+
+    /* the first run after a parameter change pays for the uploads */
+    main_state_render_ssao();
+
+    for(i = 0; i < sweep_reps; i++)
+    {
+        glBeginQuery(GL_TIME_ELAPSED, query);
+        main_state_render_ssao();
+        glEndQuery(GL_TIME_ELAPSED);
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &ns);
+        ms[i] = ns / 1e6;
+    }
+
+    qsort(ms, sweep_reps, sizeof(double), compare_doubles);
+    return ms[sweep_reps / 2];
+}
+
+/* the unblurred AO of reference_passes different high-sample kernels, averaged */
+static void render_reference(rafgl_raster_t *reference, float radius, float bias)
+{
+    main_state_ssao_params_t params;
+    rafgl_raster_t pass;
+    int *sum = NULL;
+    int i, p, count = 0;
+
+    main_state_default_ssao_params(&params);
+    params.kernel_samples = MAIN_STATE_MAX_KERNEL_SAMPLES;
+    params.radius = radius;
+    params.bias = bias;
+    params.noise_size = 4;
+    params.blur_radius = 0;
+
+    for(p = 0; p < reference_passes; p++)
+    {
+        srand(SWEEP_REFERENCE_SEED + p);
+        main_state_set_ssao_params(&params);
+        main_state_render_ssao();
+
+        rafgl_raster_load_from_texture(&pass, main_state_buffer_texture(MAIN_STATE_BUFFER_SSAO));
+        if(sum == NULL)
+        {
+            count = pass.width * pass.height;
+            sum = calloc(count, sizeof(int));
+        }
+        for(i = 0; i < count; i++)
+        {
+            sum[i] += pass.data[i].r;
+        }
+        rafgl_raster_cleanup(&pass);
+    }
+
+    rafgl_raster_init(reference, sweep_width, sweep_height);
+    for(i = 0; i < count; i++)
+    {
+        int ao = (sum[i] + reference_passes / 2) / reference_passes;
+        reference->data[i].rgba = rafgl_RGB(ao, ao, ao);
+    }
+    free(sum);
+}
+
+static void measure_view(void)
+{
+    rafgl_raster_t *references = malloc(radius_axis.count * bias_axis.count * sizeof(rafgl_raster_t));
+    rafgl_raster_t actual;
+    image_diff_t diff;
+    int i, r, b;
+
+    for(r = 0; r < radius_axis.count; r++)
+    {
+        for(b = 0; b < bias_axis.count; b++)
+        {
+            render_reference(&references[r * bias_axis.count + b], radius_axis.values[r], bias_axis.values[b]);
+        }
+    }
+
+    for(i = 0; i < point_count; i++)
+    {
+        sweep_point_t *point = &points[i];
+
+        /* every point gets the same kernel and noise for its size */
+        srand(1);
+        main_state_set_ssao_params(&point->params);
+        point->gpu_ms += time_ssao() / sweep_views;
+
+        rafgl_raster_load_from_texture(&actual, main_state_buffer_texture(MAIN_STATE_BUFFER_SSAO_BLUR));
+        /* the distance is kept in green next to the AO, the reference is grey */
+        for(r = 0; r < actual.width * actual.height; r++)
+        {
+            actual.data[r].g = actual.data[r].b = actual.data[r].r;
+        }
+        for(r = 0; r < radius_axis.count && radius_axis.values[r] != point->params.radius; r++);
+        for(b = 0; b < bias_axis.count && bias_axis.values[b] != point->params.bias; b++);
+
+        image_diff_compare(&actual, &references[r * bias_axis.count + b], &diff);
+        point->mse += diff.rmse * diff.rmse / sweep_views;
+        point->ssim += diff.ssim / sweep_views;
+        rafgl_raster_cleanup(&actual);
+    }
+
+    for(i = 0; i < radius_axis.count * bias_axis.count; i++)
+    {
+        rafgl_raster_cleanup(&references[i]);
+    }
+    free(references);
+}
+
+static int compare_points_by_time(const void *a, const void *b)
+{
+    const sweep_point_t *pa = a, *pb = b;
+    if(pa->gpu_ms != pb->gpu_ms) return (pa->gpu_ms > pb->gpu_ms) - (pa->gpu_ms < pb->gpu_ms);
+    return (pa->mse > pb->mse) - (pa->mse < pb->mse);
+}
+
+/* sorted by time, a point is on the front when nothing cheaper has a lower error */
+static void mark_pareto_front(void)
+{
+    double best_mse = INFINITY;
+    int i;
+
+    qsort(points, point_count, sizeof(sweep_point_t), compare_points_by_time);
+    for(i = 0; i < point_count; i++)
+    {
+        points[i].pareto = points[i].mse < best_mse;
+        if(points[i].pareto) best_mse = points[i].mse;
+    }
+}
+
+static double psnr_of(double mse)
+{
+    return mse > 0.0 ? 10.0 * log10(255.0 * 255.0 / mse) : INFINITY;
+}
+
+static void write_point_json(FILE *f, const sweep_point_t *p)
+{
+    double psnr = psnr_of(p->mse);
+
+    fprintf(f, "{\"kernel_samples\": %d, \"radius\": %g, \"bias\": %g, \"noise_size\": %d, \"blur_radius\": %d, "
+               "\"gpu_ms\": %.4f, \"rmse\": %.4f, \"psnr\": %.3f, \"ssim\": %.5f, \"pareto\": %s}",
+            p->params.kernel_samples, p->params.radius, p->params.bias, p->params.noise_size, p->params.blur_radius,
+            p->gpu_ms, sqrt(p->mse), isinf(psnr) ? 999.0 : psnr, p->ssim, p->pareto ? "true" : "false");
+}
+
+static int write_results(const char *base)
+{
+    char path[256];
+    FILE *f;
+    int i, first;
+
+    snprintf(path, sizeof(path), "%s.csv", base);
+    f = fopen(path, "w");
+    if(f == NULL)
+    {
+        rafgl_log(RAFGL_ERROR, "Failed to open [%s] for the sweep results!\n", path);
+        return -1;
+    }
+
+    fprintf(f, "kernel_samples,radius,bias,noise_size,blur_radius,gpu_ms,rmse,psnr,ssim,pareto\n");
+    for(i = 0; i < point_count; i++)
+    {
+        const sweep_point_t *p = &points[i];
+        fprintf(f, "%d,%g,%g,%d,%d,%.4f,%.4f,%.3f,%.5f,%d\n", p->params.kernel_samples, p->params.radius, p->params.bias,
+                p->params.noise_size, p->params.blur_radius, p->gpu_ms, sqrt(p->mse), psnr_of(p->mse), p->ssim, p->pareto);
+    }
+    fclose(f);
+
+    snprintf(path, sizeof(path), "%s.json", base);
+    f = fopen(path, "w");
+    if(f == NULL)
+    {
+        rafgl_log(RAFGL_ERROR, "Failed to open [%s] for the sweep results!\n", path);
+        return -1;
+    }
+
+    fprintf(f, "{\n");
+    fprintf(f, "  \"commit\": \"%s\",\n", RAFGL_BENCH_COMMIT);
+    fprintf(f, "  \"renderer\": \"%s\",\n", glGetString(GL_RENDERER));
+    fprintf(f, "  \"width\": %d,\n  \"height\": %d,\n", sweep_width, sweep_height);
+    fprintf(f, "  \"views\": %d,\n  \"reps\": %d,\n", sweep_views, sweep_reps);
+    fprintf(f, "  \"reference\": {\"kernel_samples\": %d, \"passes\": %d, \"noise_size\": 4, \"blur_radius\": 0},\n",
+            MAIN_STATE_MAX_KERNEL_SAMPLES, reference_passes);
+
+    fprintf(f, "  \"pareto_front\": [\n");
+    for(i = 0, first = 1; i < point_count; i++)
+    {
+        if(!points[i].pareto) continue;
+        fprintf(f, "%s    ", first ? "" : ",\n");
+        write_point_json(f, &points[i]);
+        first = 0;
+    }
+
+    fprintf(f, "\n  ],\n  \"points\": [\n");
+    for(i = 0; i < point_count; i++)
+    {
+        fprintf(f, "    ");
+        write_point_json(f, &points[i]);
+        fprintf(f, "%s\n", i + 1 < point_count ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+    fclose(f);
+
+    rafgl_log(RAFGL_INFO, "Sweep of %d points written to [%s.csv] and [%s.json]\n", point_count, base, base);
+    return 0;
+}
+
+static void build_grid(void)
+{
+    int s, r, b, n, bl;
+
+    points = calloc(samples_axis.count * radius_axis.count * bias_axis.count * noise_axis.count * blur_axis.count, sizeof(sweep_point_t));
+
+    for(s = 0; s < samples_axis.count; s++)
+    for(r = 0; r < radius_axis.count; r++)
+    for(b = 0; b < bias_axis.count; b++)
+    for(n = 0; n < noise_axis.count; n++)
+    for(bl = 0; bl < blur_axis.count; bl++)
+    {
+        main_state_ssao_params_t *params = &points[point_count++].params;
+        main_state_default_ssao_params(params);
+        params->kernel_samples = rafgl_clampi(samples_axis.values[s], 1, MAIN_STATE_MAX_KERNEL_SAMPLES);
+        params->radius = radius_axis.values[r];
+        params->bias = bias_axis.values[b];
+        params->noise_size = rafgl_clampi(noise_axis.values[n], 1, MAIN_STATE_MAX_NOISE_SIZE);
+        params->blur_radius = rafgl_clampi(blur_axis.values[bl], 0, MAIN_STATE_MAX_BLUR_RADIUS);
+    }
+}
+
+void sweep_init(GLFWwindow *window, void *args, int width, int height)
+{
+    GLuint64 ns;
+
+    srand(1);
+    main_state_init(window, args, width, height);
+    main_state_set_scripted_path(RAFGL_TRUE);
+    /* references and error maps are read back from render */
+    rafgl_alloc_check_render(RAFGL_FALSE);
+
+    glGenQueries(1, &query);
+    /* some drivers return garbage for the first time query of a context */
+    glBeginQuery(GL_TIME_ELAPSED, query);
+    glEndQuery(GL_TIME_ELAPSED);
+    glGetQueryObjectui64v(query, GL_QUERY_RESULT, &ns);
+}
+
+void sweep_update(GLFWwindow *window, float delta_time, rafgl_game_data_t *game_data, void *args)
+{
+    main_state_update(window, delta_time, game_data, args);
+}
+
+void sweep_render(GLFWwindow *window, void *args)
+{
+    main_state_ssao_params_t defaults;
+
+    if(frame++ != SWEEP_FIRST_FRAME + view * SWEEP_FRAME_STEP)
+        return;
+
+    main_state_render(window, args);
+    rafgl_log(RAFGL_INFO, "Sweeping view %d of %d\n", view + 1, sweep_views);
+    measure_view();
+
+    if(++view < sweep_views)
+    {
+        /* the next view's frame renders with the defaults again */
+        srand(1);
+        main_state_default_ssao_params(&defaults);
+        main_state_set_ssao_params(&defaults);
+        return;
+    }
+
+    mark_pareto_front();
+    write_results(sweep_out);
+
+    if(max_rmse >= 0.0)
+    {
+        int i;
+        for(i = 0; i < point_count && sqrt(points[i].mse) > max_rmse; i++);
+        if(i < point_count)
+            rafgl_log(RAFGL_INFO, "Cheapest point within rmse %.2f: %d samples, radius %g, bias %g, noise %d, blur %d at %.3f ms\n", max_rmse,
+                      points[i].params.kernel_samples, points[i].params.radius, points[i].params.bias, points[i].params.noise_size,
+                      points[i].params.blur_radius, points[i].gpu_ms);
+        else
+            rafgl_log(RAFGL_WARNING, "No point is within rmse %.2f\n", max_rmse);
+    }
+
+    rafgl_window_request_close();
+}
+
+void sweep_cleanup(GLFWwindow *window, void *args)
+{
+    glDeleteQueries(1, &query);
+    main_state_cleanup(window, args);
+    free(points);
+}
+
+int main(int argc, char *argv[])
+{
+
+    rafgl_game_t game;
+    int i;
+
+    for(i = 1; i < argc; i++)
+    {
+        if(!strcmp(argv[i], "--size") && i + 1 < argc)
+            sscanf(argv[++i], "%dx%d", &sweep_width, &sweep_height);
+        else if(!strcmp(argv[i], "--views") && i + 1 < argc)
+            sweep_views = atoi(argv[++i]);
+        else if(!strcmp(argv[i], "--reps") && i + 1 < argc)
+            sweep_reps = atoi(argv[++i]);
+        else if(!strcmp(argv[i], "--reference-passes") && i + 1 < argc)
+            reference_passes = atoi(argv[++i]);
+        else if(!strcmp(argv[i], "--samples") && i + 1 < argc)
+            parse_axis(&samples_axis, argv[++i]);
+        else if(!strcmp(argv[i], "--radius") && i + 1 < argc)
+            parse_axis(&radius_axis, argv[++i]);
+        else if(!strcmp(argv[i], "--bias") && i + 1 < argc)
+            parse_axis(&bias_axis, argv[++i]);
+        else if(!strcmp(argv[i], "--noise") && i + 1 < argc)
+            parse_axis(&noise_axis, argv[++i]);
+        else if(!strcmp(argv[i], "--blur") && i + 1 < argc)
+            parse_axis(&blur_axis, argv[++i]);
+        else if(!strcmp(argv[i], "--max-rmse") && i + 1 < argc)
+            max_rmse = atof(argv[++i]);
+        else if(!strcmp(argv[i], "--out") && i + 1 < argc)
+            sweep_out = argv[++i];
+    }
+
+    sweep_views = rafgl_clampi(sweep_views, 1, 6);
+    sweep_reps = rafgl_clampi(sweep_reps, 1, SWEEP_MAX_REPS);
+    reference_passes = rafgl_max_m(reference_passes, 1);
+
+    if(!samples_axis.count || !radius_axis.count || !bias_axis.count || !noise_axis.count || !blur_axis.count)
+    {
+        fprintf(stderr, "every axis needs at least one value\n");
+        return 1;
+    }
+    build_grid();
+
+    rafgl_game_set_swap_interval(RAFGL_VSYNC_OFF);
+    rafgl_game_set_fixed_delta(SWEEP_FIXED_DELTA);
+
+    if(rafgl_game_init(&game, "sweep", sweep_width, sweep_height, 0))
+    {
+        return 1;
+    }
+    rafgl_game_add_named_game_state(&game, sweep);
+    rafgl_game_start(&game, NULL);
+
+    return 0;
+}